@@ -153,17 +153,35 @@ int main(int argc, char *argv[])
     {
         std::cerr << "用法: " << argv[0] << " <命令> <参数...>\n";
         std::cerr << "  命令列表:\n";
-        std::cerr << "    1. compress <输入路径> <输出文件> <算法> [-W <密码>]      压缩文件或目录（目录会先打包）\n";
+        std::cerr << "    1. compress <输入路径> <输出文件> <算法> [threads=<N>] [-W <密码>]      压缩文件或目录（目录会先打包）\n";
         std::cerr << "      算法: huffman | lz77\n";
+        std::cerr << "      threads=<N>: 按块并行压缩的线程数，默认 1\n";
         std::cerr << "      -W <密码>: 启用AES加密并设置密码\n";
-        std::cerr << "    2. decompress <输入文件> <输出路径> <算法> [-W <密码>]    解压文件；若包含目录包则解包到输出路径\n";
+        std::cerr << "    2. decompress <输入文件> <输出路径> <算法> [threads=<N>] [-W <密码>]    解压文件；若包含目录包则解包到输出路径\n";
         std::cerr << "      算法: huffman | lz77\n";
+        std::cerr << "      threads=<N>: 按块并行解压的线程数，默认 1\n";
         std::cerr << "      -W <密码>: 启用AES解密并设置密码\n";
-        std::cerr << "    3. backup <源目录> <备份目录> [mirror] [compress=<算法>] [-W <密码>]         备份目录树\n";
+        std::cerr << "    3. backup <源目录> <备份目录> [mirror] [compress=<算法>] [scan-threads=<N>] [jobs=<N>] [compress-threads=<N>] [scanner=<方式>] [io=<方式>] [storage=<方式>] [pack-threshold=<字节>] [delta] [snapshot] [scan-cache] [rescan] [detect-renames] [stream] [exclude=<模式>] [include=<模式>] [-W <密码>]         备份目录树\n";
         std::cerr << "      mirror: 镜像模式，删除目标目录中不存在的文件\n";
         std::cerr << "      compress=<算法>: 设置压缩算法 (huffman | lz77 | none)\n";
+        std::cerr << "      scan-threads=<N>: 目录扫描线程数，默认 1\n";
+        std::cerr << "      jobs=<N>: 并行压缩/加密/复制文件的线程数，默认 1\n";
+        std::cerr << "      compress-threads=<N>: 单个文件内按块并行压缩的线程数，默认 1\n";
+        std::cerr << "      scanner=<方式>: 目录读取方式 (portable | raw)，raw 仅 Linux 有效\n";
+        std::cerr << "      io=<方式>: 不压缩不加密时的文件复制方式 (blocking | uring)，uring 仅 Linux 有效\n";
+        std::cerr << "      storage=<方式>: 存储方式 (files | chunks | packs)，chunks 按内容切块去重保存，packs 把小文件合并写入包文件，还原时自动识别\n";
+        std::cerr << "      pack-threshold=<字节>: storage=packs 时小于该大小的文件写入包文件，默认 65536\n";
+        std::cerr << "      delta: 不压缩不加密时按块签名原地修补已更新的大文件，只写入变化的块\n";
+        std::cerr << "      snapshot: 快照模式，每次备份生成 snapshots/<时间戳>/，未变化的文件硬链接到上一个快照\n";
+        std::cerr << "      scan-cache: 使用扫描缓存，未变化的目录不再 readdir\n";
+        std::cerr << "      rescan: 忽略 .backupmeta，重新扫描备份目录作为对比基准\n";
+        std::cerr << "      detect-renames: 识别重命名/移动，在备份目录内直接改名\n";
+        std::cerr << "      stream: 流式扫描与对比，不在内存中构建目录树（适合超大目录）\n";
+        std::cerr << "      exclude=<模式>: 排除匹配的文件或目录（glob，可重复），如 exclude=node_modules exclude=*.tmp\n";
+        std::cerr << "      include=<模式>: 只备份匹配的文件（glob，可重复），如 include=*.cpp\n";
         std::cerr << "      -W <密码>: 启用AES加密并设置密码\n";
-        std::cerr << "    4. restore <备份目录> <还原目录> [-W <密码>]             从备份还原目录树\n";
+        std::cerr << "    4. restore <备份目录> <还原目录> [jobs=<N>] [compress-threads=<N>] [io=<方式>] [snapshot=<ID>] [-W <密码>]         从备份还原目录树\n";
+        std::cerr << "      snapshot=<ID>: 还原指定的快照，默认为最新的快照\n";
         std::cerr << "      -W <密码>: 设置AES解密密码\n";
         return 1;
     }
@@ -176,7 +194,7 @@ int main(int argc, char *argv[])
         {
             if (argc < 5)
             {
-                std::cerr << "用法: " << argv[0] << " " << command << " <输入文件> <输出文件> <算法> [-W <密码>]\n";
+                std::cerr << "用法: " << argv[0] << " " << command << " <输入文件> <输出文件> <算法> [threads=<N>] [-W <密码>]\n";
                 std::cerr << "  算法: huffman | lz77\n";
                 return 1;
             }
@@ -187,6 +205,7 @@ int main(int argc, char *argv[])
             std::string algorithm = argv[4];
             std::string password;
             bool enableEncryption = false;
+            unsigned threads = 1;
             const bool inputIsDir = fs::exists(inputPath) && fs::is_directory(inputPath);
 
             // 解析可选的-W参数
@@ -198,9 +217,13 @@ int main(int argc, char *argv[])
                     password = argv[++i];
                     enableEncryption = true;
                 }
+                else if (arg.find("threads=") == 0 && std::stoi(arg.substr(8)) > 0)
+                {
+                    threads = static_cast<unsigned>(std::stoi(arg.substr(8)));
+                }
                 else
                 {
-                    std::cerr << "用法: " << argv[0] << " " << command << " <输入文件> <输出文件> <算法> [-W <密码>]\n";
+                    std::cerr << "用法: " << argv[0] << " " << command << " <输入文件> <输出文件> <算法> [threads=<N>] [-W <密码>]\n";
                     std::cerr << "  算法: huffman | lz77\n";
                     return 1;
                 }
@@ -239,11 +262,13 @@ int main(int argc, char *argv[])
                 if (algorithm == "huffman")
                 {
                     auto compressor = createCompressor(backup::core::compression::CompressionType::Huffman);
+                    compressor->setThreads(threads);
                     compressor->compress(packedInput, tempPath);
                 }
                 else if (algorithm == "lz77")
                 {
                     auto compressor = createCompressor(backup::core::compression::CompressionType::Lz77);
+                    compressor->setThreads(threads);
                     compressor->compress(packedInput, tempPath);
                 }
                 else
@@ -299,11 +324,13 @@ int main(int argc, char *argv[])
                 if (algorithm == "huffman")
                 {
                     auto compressor = createCompressor(backup::core::compression::CompressionType::Huffman);
+                    compressor->setThreads(threads);
                     compressor->decompress(tempPath, tempDecompressed);
                 }
                 else if (algorithm == "lz77")
                 {
                     auto compressor = createCompressor(backup::core::compression::CompressionType::Lz77);
+                    compressor->setThreads(threads);
                     compressor->decompress(tempPath, tempDecompressed);
                 }
                 else
@@ -360,6 +387,22 @@ int main(int argc, char *argv[])
             BackupManager::CompressionType compressionType = BackupManager::CompressionType::None;
             bool enableEncryption = false;
             std::string encryptionKey;
+            unsigned scanThreads = 1;
+            unsigned executeThreads = 1;
+            unsigned compressionThreads = 1;
+            bool useIoUring = false;
+            bool chunkedStorage = false;
+            bool packSmallFiles = false;
+            uint64_t packThreshold = 64 << 10;
+            bool deltaUpdates = false;
+            bool snapshots = false;
+            auto scanBackend = backup::filesystem::ScanBackend::Portable;
+            bool useScanCache = false;
+            bool diffAgainstMetadata = true;
+            bool detectRenames = false;
+            bool streamingPlan = false;
+            std::vector<std::string> includePatterns;
+            std::vector<std::string> excludePatterns;
 
             // 解析可选参数
             for (int i = 4; i < argc; ++i)
@@ -369,6 +412,38 @@ int main(int argc, char *argv[])
                 {
                     mirrorMode = true;
                 }
+                else if (arg == "scan-cache")
+                {
+                    useScanCache = true;
+                }
+                else if (arg == "rescan")
+                {
+                    diffAgainstMetadata = false;
+                }
+                else if (arg == "detect-renames")
+                {
+                    detectRenames = true;
+                }
+                else if (arg == "stream")
+                {
+                    streamingPlan = true;
+                }
+                else if (arg == "delta")
+                {
+                    deltaUpdates = true;
+                }
+                else if (arg == "snapshot")
+                {
+                    snapshots = true;
+                }
+                else if (arg.find("exclude=") == 0)
+                {
+                    excludePatterns.push_back(arg.substr(8));
+                }
+                else if (arg.find("include=") == 0)
+                {
+                    includePatterns.push_back(arg.substr(8));
+                }
                 else if (arg.find("compress=") == 0)
                 {
                     std::string algo = arg.substr(9);
@@ -393,6 +468,72 @@ int main(int argc, char *argv[])
                         return 1;
                     }
                 }
+                else if (arg.find("scan-threads=") == 0)
+                {
+                    const int n = std::stoi(arg.substr(13));
+                    if (n < 1)
+                    {
+                        std::cerr << "扫描线程数必须大于 0: " << arg << std::endl;
+                        return 1;
+                    }
+                    scanThreads = static_cast<unsigned>(n);
+                }
+                else if (arg.find("jobs=") == 0)
+                {
+                    const int n = std::stoi(arg.substr(5));
+                    if (n < 1)
+                    {
+                        std::cerr << "线程数必须大于 0: " << arg << std::endl;
+                        return 1;
+                    }
+                    executeThreads = static_cast<unsigned>(n);
+                }
+                else if (arg.find("compress-threads=") == 0)
+                {
+                    const int n = std::stoi(arg.substr(17));
+                    if (n < 1)
+                    {
+                        std::cerr << "线程数必须大于 0: " << arg << std::endl;
+                        return 1;
+                    }
+                    compressionThreads = static_cast<unsigned>(n);
+                }
+                else if (arg.find("scanner=") == 0)
+                {
+                    std::string backend = arg.substr(8);
+                    if (backend == "raw")
+                    {
+                        scanBackend = backup::filesystem::ScanBackend::LinuxRaw;
+                    }
+                    else if (backend == "portable")
+                    {
+                        scanBackend = backup::filesystem::ScanBackend::Portable;
+                    }
+                    else
+                    {
+                        std::cerr << "不支持的扫描方式: " << backend << std::endl;
+                        return 1;
+                    }
+                }
+                else if (arg == "io=uring" || arg == "io=blocking")
+                {
+                    useIoUring = arg == "io=uring";
+                }
+                else if (arg == "storage=chunks" || arg == "storage=files" || arg == "storage=packs")
+                {
+                    chunkedStorage = arg == "storage=chunks";
+                    packSmallFiles = arg == "storage=packs";
+                }
+                else if (arg.find("pack-threshold=") == 0)
+                {
+                    const long long n = std::stoll(arg.substr(15));
+                    if (n < 1)
+                    {
+                        std::cerr << "打包阈值必须大于 0: " << arg << std::endl;
+                        return 1;
+                    }
+                    packThreshold = static_cast<uint64_t>(n);
+                }
                 else if ((arg == "-W" || arg == "-w") && i + 1 < argc)
                 {
                     encryptionKey = argv[++i];
@@ -416,6 +557,22 @@ int main(int argc, char *argv[])
             config.encryptionType = BackupManager::EncryptionType::AES;
             config.encryptionKey = encryptionKey;
             config.enableEncryption = enableEncryption;
+            config.scanThreads = scanThreads;
+            config.executeThreads = executeThreads;
+            config.compressionThreads = compressionThreads;
+            config.useIoUring = useIoUring;
+            config.chunkedStorage = chunkedStorage;
+            config.packSmallFiles = packSmallFiles;
+            config.packThreshold = packThreshold;
+            config.deltaUpdates = deltaUpdates;
+            config.snapshots = snapshots;
+            config.scanBackend = scanBackend;
+            config.useScanCache = useScanCache;
+            config.diffAgainstMetadata = diffAgainstMetadata;
+            config.detectRenames = detectRenames;
+            config.streamingPlan = streamingPlan;
+            config.includePatterns = includePatterns;
+            config.excludePatterns = excludePatterns;
 
             // 创建备份管理器并执行备份
             BackupManager manager(config);
@@ -426,8 +583,50 @@ int main(int argc, char *argv[])
             auto plan = manager.buildPlan();
 
             std::cout << "正在执行备份计划...\n";
-            manager.executePlan(plan);
+            const bool succeeded = manager.executePlan(plan);
+            if (manager.resumedActions() > 0)
+            {
+                std::cout << "接续上次中断的备份: 跳过 " << manager.resumedActions() << " 个已完成的操作\n";
+            }
+            if (!succeeded)
+            {
+                std::cout << "部分操作失败，已完成的操作记录在 .journal 中，重新运行同一命令即可接续\n";
+            }
+            if (!manager.snapshotId().empty())
+            {
+                std::cout << (succeeded ? "快照: " : "快照未完成: ") << manager.snapshotId() << "\n";
+            }
+            for (const auto &[method, count] : manager.copyMethodCounts())
+            {
+                std::cout << "复制方式 " << method << ": " << count << " 个文件\n";
+            }
+            if (chunkedStorage)
+            {
+                const auto stats = manager.chunkStats();
+                std::cout << "块存储: 共 " << stats.chunks << " 块，新写入 " << stats.newChunks
+                          << " 块（" << stats.storedBytes << " 字节）\n";
+            }
+            if (packSmallFiles)
+            {
+                const auto stats = manager.packStats();
+                std::cout << "打包: " << stats.files << " 个小文件写入包文件（" << stats.storedBytes << " 字节）";
+                if (stats.removedPacks > 0)
+                {
+                    std::cout << "，整理时搬移 " << stats.repackedBytes << " 字节、删除 " << stats.removedPacks
+                              << " 个包";
+                }
+                std::cout << "\n";
+            }
+            if (const auto delta = manager.deltaStats(); delta.files > 0)
+            {
+                std::cout << "增量修补: " << delta.files << " 个文件，写入 " << delta.bytesWritten
+                          << " / " << delta.bytesTotal << " 字节\n";
+            }
 
+            if (!succeeded)
+            {
+                return 1;
+            }
             std::cout << "目录备份完成！\n";
         }
         else if (command == "restore")
@@ -435,8 +634,12 @@ int main(int argc, char *argv[])
             std::string backupDir = argv[2];
             std::string restoreDir = argv[3];
             std::string encryptionKey;
+            unsigned executeThreads = 1;
+            unsigned compressionThreads = 1;
+            bool useIoUring = false;
+            std::string snapshot;
 
-            // 解析可选的-W参数
+            // 解析可选参数
             for (int i = 4; i < argc; ++i)
             {
                 std::string arg = argv[i];
@@ -444,9 +647,25 @@ int main(int argc, char *argv[])
                 {
                     encryptionKey = argv[++i];
                 }
+                else if (arg.find("snapshot=") == 0)
+                {
+                    snapshot = arg.substr(9);
+                }
+                else if (arg.find("jobs=") == 0 && std::stoi(arg.substr(5)) > 0)
+                {
+                    executeThreads = static_cast<unsigned>(std::stoi(arg.substr(5)));
+                }
+                else if (arg.find("compress-threads=") == 0 && std::stoi(arg.substr(17)) > 0)
+                {
+                    compressionThreads = static_cast<unsigned>(std::stoi(arg.substr(17)));
+                }
+                else if (arg == "io=uring" || arg == "io=blocking")
+                {
+                    useIoUring = arg == "io=uring";
+                }
                 else
                 {
-                    std::cerr << "用法: " << argv[0] << " restore <备份目录> <还原目录> [-W <密码>]\n";
+                    std::cerr << "用法: " << argv[0] << " restore <备份目录> <还原目录> [jobs=<N>] [compress-threads=<N>] [io=<方式>] [snapshot=<ID>] [-W <密码>]\n";
                     return 1;
                 }
             }
@@ -455,11 +674,22 @@ int main(int argc, char *argv[])
             BackupManager::BackupConfig config;
             config.backupRoot = backupDir;
             config.encryptionKey = encryptionKey;
+            config.executeThreads = executeThreads;
+            config.compressionThreads = compressionThreads;
+            config.useIoUring = useIoUring;
 
             // 创建备份管理器并执行还原
             BackupManager manager(config);
             std::cout << "正在从备份还原...\n";
-            manager.restore(restoreDir);
+            manager.restore(restoreDir, snapshot);
+            if (!manager.snapshotId().empty())
+            {
+                std::cout << "已还原快照: " << manager.snapshotId() << "\n";
+            }
+            for (const auto &[method, count] : manager.copyMethodCounts())
+            {
+                std::cout << "复制方式 " << method << ": " << count << " 个文件\n";
+            }
 
             std::cout << "目录还原完成！\n";
         }
@@ -0,0 +1,198 @@
+#include "ActionJournal.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace backup::core
+{
+
+    namespace
+    {
+        constexpr const char *kMagic = "SDJOURNAL1 ";
+
+        void flushToDisk(std::FILE *file)
+        {
+            if (std::fflush(file) != 0)
+            {
+                throw std::runtime_error("写入操作日志失败");
+            }
+#if defined(_WIN32)
+            _commit(_fileno(file));
+#else
+            ::fsync(fileno(file));
+#endif
+        }
+
+        // 把 file 所在文件系统上已写入的数据落盘；备份目录中的文件与日志在同一文件系统上
+        void syncFileSystem(std::FILE *file)
+        {
+#if defined(__linux__)
+            if (::syncfs(fileno(file)) != 0)
+            {
+                throw std::runtime_error("同步备份数据失败");
+            }
+#elif !defined(_WIN32)
+            (void)file;
+            ::sync();
+#else
+            (void)file;
+#endif
+        }
+    }
+
+    ActionJournal::ActionJournal(const fs::path &path, const std::string &header, Options options)
+        : path_(path), options_(options)
+    {
+        load(header);
+        lastSync_ = std::chrono::steady_clock::now();
+    }
+
+    ActionJournal::ActionJournal(const fs::path &path, const std::string &header)
+        : ActionJournal(path, header, Options{}) {}
+
+    ActionJournal::~ActionJournal()
+    {
+        if (file_)
+        {
+            try
+            {
+                syncLocked();
+            }
+            catch (const std::exception &)
+            {
+                // 未写入的条目对应的操作下次重做
+            }
+            std::fclose(file_);
+        }
+    }
+
+    bool ActionJournal::matches(const fs::path &path, const std::string &header)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::string firstLine;
+        return in && std::getline(in, firstLine) && firstLine == kMagic + header;
+    }
+
+    void ActionJournal::load(const std::string &header)
+    {
+        const std::string firstLine = kMagic + header + "\n";
+
+        std::string content;
+        {
+            std::ifstream in(path_, std::ios::binary);
+            if (in)
+            {
+                content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            }
+        }
+
+        if (content.compare(0, firstLine.size(), firstLine) == 0)
+        {
+            resumed_ = true;
+            size_t begin = firstLine.size();
+            for (size_t end; (end = content.find('\n', begin)) != std::string::npos; begin = end + 1)
+            {
+                if (end > begin)
+                {
+                    done_.insert(content.substr(begin, end - begin));
+                }
+            }
+            // 截掉写到一半的最后一行，之后的追加从完整的行开始
+            if (begin < content.size())
+            {
+                fs::resize_file(path_, begin);
+            }
+            file_ = std::fopen(path_.string().c_str(), "ab");
+        }
+        else
+        {
+            file_ = std::fopen(path_.string().c_str(), "wb");
+            if (file_)
+            {
+                std::fputs(firstLine.c_str(), file_);
+                flushToDisk(file_);
+            }
+        }
+        if (!file_)
+        {
+            throw std::runtime_error("无法打开操作日志: " + path_.string());
+        }
+    }
+
+    bool ActionJournal::resumed() const noexcept
+    {
+        return resumed_;
+    }
+
+    bool ActionJournal::contains(const std::string &entry) const
+    {
+        return done_.count(entry) != 0;
+    }
+
+    void ActionJournal::record(const std::string &entry)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ += entry;
+        pending_ += '\n';
+        ++pendingEntries_;
+        if (pendingEntries_ >= options_.syncEntries ||
+            std::chrono::steady_clock::now() - lastSync_ >= options_.syncInterval)
+        {
+            syncLocked();
+        }
+    }
+
+    void ActionJournal::sync()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        syncLocked();
+    }
+
+    void ActionJournal::syncLocked()
+    {
+        lastSync_ = std::chrono::steady_clock::now();
+        if (pending_.empty() || !file_)
+        {
+            return;
+        }
+        // 条目表示操作已完成，必须在它所指的数据落盘之后写入
+        if (options_.syncData)
+        {
+            options_.syncData();
+        }
+        else
+        {
+            syncFileSystem(file_);
+        }
+        if (std::fwrite(pending_.data(), 1, pending_.size(), file_) != pending_.size())
+        {
+            throw std::runtime_error("写入操作日志失败");
+        }
+        flushToDisk(file_);
+        pending_.clear();
+        pendingEntries_ = 0;
+    }
+
+    void ActionJournal::remove()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_)
+        {
+            std::fclose(file_);
+            file_ = nullptr;
+        }
+        pending_.clear();
+        pendingEntries_ = 0;
+        std::error_code ec;
+        fs::remove(path_, ec);
+    }
+
+} // namespace backup::core
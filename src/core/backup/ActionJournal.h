@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace backup::core
+{
+
+    namespace fs = std::filesystem;
+
+    /*
+     * ActionJournal: 备份执行的预写日志
+     *  - 每个操作完整完成（含权限与 mtime）后追加一行条目，执行中断时已完成的操作留有记录
+     *  - 条目先缓存在内存中，累计 syncEntries 条或距上次同步超过 syncInterval 时写入并 fsync，
+     *    中断时最多丢失最后一批记录，对应的操作在下次执行时重做
+     *  - 每批条目写入前先让它们所指的数据落盘（默认对日志所在的文件系统执行 syncfs），
+     *    断电重启后日志中不会出现数据尚未写完的文件
+     *  - 第一行为头部（格式版本与备份配置），与本次执行不一致时丢弃旧日志
+     *  - 末尾不完整的一行（写到一半时中断）在打开时截掉
+     */
+    class ActionJournal
+    {
+    public:
+        struct Options
+        {
+            size_t syncEntries = 256;
+            std::chrono::milliseconds syncInterval{1000};
+            std::function<void()> syncData; // 写入每批条目前调用，为空时使用 syncfs
+        };
+
+        // 打开 path 处的日志：头部与 header 一致时载入已有条目并在其后追加，否则重新创建
+        ActionJournal(const fs::path &path, const std::string &header, Options options);
+        ActionJournal(const fs::path &path, const std::string &header);
+        ~ActionJournal();
+
+        ActionJournal(const ActionJournal &) = delete;
+        ActionJournal &operator=(const ActionJournal &) = delete;
+
+        // 打开时存在头部一致的旧日志，即上一次执行被中断
+        bool resumed() const noexcept;
+        // 上一次执行中已完成的操作（条目不得包含换行）
+        bool contains(const std::string &entry) const;
+
+        // 可被多个线程同时调用
+        void record(const std::string &entry);
+        // 立即写入缓存的条目并 fsync
+        void sync();
+        // 执行成功、元数据已提交后删除日志
+        void remove();
+
+        // path 处有头部与 header 一致的日志，即打开后 resumed() 为 true
+        static bool matches(const fs::path &path, const std::string &header);
+
+        static constexpr const char *kFile = ".journal";
+
+    private:
+        fs::path path_;
+        Options options_;
+        std::unordered_set<std::string> done_;
+        bool resumed_ = false;
+
+        std::mutex mutex_;
+        std::FILE *file_ = nullptr;
+        std::string pending_;
+        size_t pendingEntries_ = 0;
+        std::chrono::steady_clock::time_point lastSync_;
+
+        void load(const std::string &header);
+        void syncLocked();
+    };
+
+} // namespace backup::core
@@ -1,12 +1,22 @@
 #include "BackupManager.h"
 #include "BackupMetadata.h"
+#include "compression/BlockFormat.h"
 #include "compression/Compression.h"
 #include "encryption/Encryption.h"
+#include "util/ByteSink.h"
+#include "util/Hash.h"
+#include "util/IoUring.h"
+#include "util/Parallel.h"
+#include "util/TimeUtils.h"
 
 #include <stdexcept>
 #include <filesystem>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <unordered_set>
+#include <atomic>
+#include <charconv>
 
 namespace backup::core
 {
@@ -18,7 +28,17 @@ namespace backup::core
     namespace fs = std::filesystem;
 
     BackupManager::BackupManager(BackupConfig config)
-        : config_(std::move(config)) {}
+        : config_(std::move(config)),
+          repositoryRoot_(config_.backupRoot),
+          baseRoot_(config_.backupRoot),
+          internalFiles_({}, {std::string("/") + kMetadataFile,
+                              std::string("/") + kMetadataFile + ".tmp",
+                              std::string("/") + kScanCacheFile,
+                              std::string("/") + ActionJournal::kFile,
+                              std::string("/") + packaging::PackStore::kIndexFile,
+                              std::string("/") + packaging::PackStore::kDirectory + "/",
+                              std::string("/") + ChunkStore::kDirectory + "/",
+                              std::string("/") + kSignatureDirectory + "/"}) {}
 
     namespace
     {
@@ -49,6 +69,111 @@ namespace backup::core
                 throw std::invalid_argument("加密类型无效");
             }
         }
+
+        bool isUnder(const std::string &path, const std::string &root)
+        {
+            return path.size() > root.size() && path[root.size()] == '/' &&
+                   path.compare(0, root.size(), root) == 0;
+        }
+
+        // 父目录已被删除的路径无需再删；剩下的删除互不重叠，可以并行
+        std::vector<const BackupManager::BackupAction *>
+        outermostRemovals(std::vector<const BackupManager::BackupAction *> removals)
+        {
+            std::sort(removals.begin(), removals.end(),
+                      [](const BackupManager::BackupAction *a, const BackupManager::BackupAction *b)
+                      {
+                          return FileTreeDiff::pathLess(a->targetPath.generic_string(),
+                                                        b->targetPath.generic_string());
+                      });
+
+            std::vector<const BackupManager::BackupAction *> outermost;
+            for (const auto *action : removals)
+            {
+                const std::string target = action->targetPath.generic_string();
+                if (outermost.empty() ||
+                    (target != outermost.back()->targetPath.generic_string() &&
+                     !isUnder(target, outermost.back()->targetPath.generic_string())))
+                {
+                    outermost.push_back(action);
+                }
+            }
+            return outermost;
+        }
+
+        // 快照 ID 为 UTC 时间（如 20260103T082134Z），同一秒内的后续快照加 _2、_3 …；
+        // 不是这种形式的名字（如手工放入 snapshots/ 的目录）返回空，不当作快照
+        std::optional<std::pair<std::string, unsigned long>> snapshotKey(const std::string &id)
+        {
+            constexpr size_t kTimeLength = 16;
+            if (id.size() < kTimeLength || id[8] != 'T' || id[15] != 'Z')
+            {
+                return std::nullopt;
+            }
+            for (size_t i = 0; i < 15; ++i)
+            {
+                if (i != 8 && (id[i] < '0' || id[i] > '9'))
+                {
+                    return std::nullopt;
+                }
+            }
+            if (id.size() == kTimeLength)
+            {
+                return std::make_pair(id, 1ul);
+            }
+
+            unsigned long n = 0;
+            const char *begin = id.data() + kTimeLength + 1;
+            const char *end = id.data() + id.size();
+            if (id[kTimeLength] != '_' || begin == end)
+            {
+                return std::nullopt;
+            }
+            const auto [ptr, ec] = std::from_chars(begin, end, n);
+            if (ec != std::errc() || ptr != end)
+            {
+                return std::nullopt;
+            }
+            return std::make_pair(id.substr(0, kTimeLength), n);
+        }
+
+        // 流式对比要求条目按先序排列；旧版本写出的元数据未排序
+        bool entriesInOrder(BackupMetadataReader &reader)
+        {
+            BackupFileEntry entry;
+            std::string previous;
+            while (reader.next(entry))
+            {
+                if (!previous.empty() && !FileTreeDiff::pathLess(previous, entry.relativePath))
+                {
+                    return false;
+                }
+                previous = std::move(entry.relativePath);
+            }
+            return true;
+        }
+
+        // 转发到下游的同时对经过的内容求哈希
+        class HashingSink : public util::ByteSink
+        {
+        public:
+            HashingSink(util::ByteSink &output, util::XxHash64 &hash) : output_(output), hash_(hash) {}
+
+            void write(const uint8_t *data, size_t size) override
+            {
+                hash_.update(data, size);
+                output_.write(data, size);
+            }
+
+            void finish() override
+            {
+                output_.finish();
+            }
+
+        private:
+            util::ByteSink &output_;
+            util::XxHash64 &hash_;
+        };
     }
 
     void BackupManager::scan()
@@ -58,6 +183,10 @@ namespace backup::core
             throw std::runtime_error("源目录无效");
         }
 
+        config_.backupRoot = repositoryRoot_;
+        baseRoot_ = repositoryRoot_;
+        snapshotId_.clear();
+
         if (!fs::exists(config_.backupRoot))
         {
             fs::create_directories(config_.backupRoot);
@@ -66,78 +195,567 @@ namespace backup::core
         {
             throw std::runtime_error("备份目录无效");
         }
+        if (config_.snapshots)
+        {
+            beginSnapshot();
+        }
+
+        filesystem::ScanOptions scanOptions;
+        scanOptions.threads = config_.scanThreads;
+        scanOptions.backend = config_.scanBackend;
+
+        // 扫描缓存只用于源目录
+        filesystem::ScanOptions sourceOptions = scanOptions;
+        sourceOptions.identity = config_.detectRenames;
+
+        // 过滤只作用于源目录；此前已备份、现在被排除的路径按删除处理
+        filter_ = filesystem::PathFilter(config_.includePatterns, config_.excludePatterns);
+        if (!filter_.empty())
+        {
+            sourceOptions.filter = &filter_;
+        }
+        scanCache_.reset();
+        if (config_.useScanCache)
+        {
+            scanCache_ = std::make_unique<filesystem::ScanCache>(config_.sourceRoot);
+            scanCache_->load(baseRoot_ / kScanCacheFile);
+            sourceOptions.cache = scanCache_.get();
+        }
+
+        sourceOptions_ = sourceOptions;
+        backupOptions_ = scanOptions;
+        backupOptions_.filter = &internalFiles_;
+
+        sourceTree_.reset();
+        backupTree_.reset();
+        metadataWriter_.reset();
+        rewriteAll_ = false;
 
-        sourceTree_ = std::make_unique<FileTree>(config_.sourceRoot);
-        backupTree_ = std::make_unique<FileTree>(config_.backupRoot);
+        const fs::path metaPath = baseRoot_ / kMetadataFile;
 
+        streaming_ = config_.streamingPlan && !config_.detectRenames;
+        streamFromMetadata_ = false;
+        if (streaming_ && fs::exists(metaPath))
+        {
+            try
+            {
+                BackupMetadataReader reader(baseRoot_);
+                rewriteAll_ = reader.header().compressionType != compressionName() ||
+                              reader.header().encryptionType != encryptionName() ||
+                              reader.header().storageType != storageName();
+                if (config_.diffAgainstMetadata)
+                {
+                    streamFromMetadata_ = entriesInOrder(reader);
+                    streaming_ = streamFromMetadata_;
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "[扫描] 元数据不可用，改为扫描备份目录: " << e.what() << "\n";
+            }
+        }
+        if (streaming_)
+        {
+            // 目录在 buildPlan() 中边遍历边对比
+            return;
+        }
+
+        sourceTree_ = std::make_unique<FileTree>(config_.sourceRoot, sourceOptions_);
         sourceTree_->build();
-        backupTree_->build();
+
+        if (fs::exists(metaPath))
+        {
+            try
+            {
+                auto metadata = BackupMetadata::readMetadata(baseRoot_);
+
+                // 存储格式变化后旧文件无法按新配置还原，必须全部重写
+                rewriteAll_ = metadata.compressionType != compressionName() ||
+                              metadata.encryptionType != encryptionName() ||
+                              metadata.storageType != storageName();
+
+                // 元数据记录的是源文件大小与 mtime，压缩/加密后也能正确比较，
+                // 同时省去对备份目录的第二次完整扫描
+                if (config_.diffAgainstMetadata)
+                {
+                    backupTree_ = BackupMetadata::buildTree(metadata, baseRoot_);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "[扫描] 元数据不可用，改为扫描备份目录: " << e.what() << "\n";
+                backupTree_.reset();
+            }
+        }
+
+        if (!backupTree_)
+        {
+            backupTree_ = std::make_unique<FileTree>(baseRoot_, backupOptions_);
+            backupTree_->build();
+        }
     }
 
     std::vector<BackupManager::BackupAction> BackupManager::buildPlan()
     {
+        if (streaming_)
+        {
+            return buildStreamingPlan();
+        }
+
         if (!sourceTree_ || !backupTree_)
         {
             throw std::runtime_error("必须先执行 scan()，再执行 buildPlan()");
         }
 
         changes_ = FileTreeDiff::diff(*backupTree_, *sourceTree_);
+
+        // 全部重写时改名没有意义
+        if (config_.detectRenames && !rewriteAll_)
+        {
+            filesystem::RenameOptions renameOptions;
+            renameOptions.newContentRoot = config_.sourceRoot;
+            // 只有未压缩、未加密的逐文件备份内容与源文件一致，可直接计算指纹
+            if (compressionName() == "none" && encryptionName() == "none" && storageName() == "files")
+            {
+                renameOptions.oldContentRoot = baseRoot_;
+            }
+            FileTreeDiff::inheritFingerprints(*backupTree_, *sourceTree_);
+            FileTreeDiff::detectRenames(changes_, renameOptions);
+        }
+
+        if (rewriteAll_)
+        {
+            std::unordered_set<std::string> changed;
+            for (const auto &change : changes_)
+            {
+                changed.insert(change.relativePath);
+            }
+
+            std::vector<std::shared_ptr<filesystem::FileNode>> pending{sourceTree_->getRoot()};
+            while (!pending.empty())
+            {
+                auto node = std::move(pending.back());
+                pending.pop_back();
+                for (const auto &child : node->getChildren())
+                {
+                    if (child->isDirectory())
+                    {
+                        pending.push_back(child);
+                    }
+                    else if (!changed.count(child->getRelativePath()))
+                    {
+                        changes_.push_back({ChangeType::Modified, child->getRelativePath(), nullptr, child});
+                    }
+                }
+            }
+
+            // 保持与 diff 相同的先序顺序（目录在其内容之前）
+            std::stable_sort(changes_.begin(), changes_.end(),
+                             [](const FileChange &a, const FileChange &b)
+                             { return FileTreeDiff::pathLess(a.relativePath, b.relativePath); });
+        }
+
         return translateChangesToActions(changes_);
     }
 
-    bool BackupManager::executePlan(const std::vector<BackupAction> &plan)
+    // 源目录遍历与旧条目流（元数据或备份目录遍历）按先序归并，
+    // 内存只与目录深度有关；新元数据同时写入临时文件，执行成功后替换
+    std::vector<BackupManager::BackupAction> BackupManager::buildStreamingPlan()
     {
-        bool success = true;
+        using filesystem::WalkEntry;
+
+        filesystem::TreeWalker source(config_.sourceRoot, sourceOptions_);
+        std::unique_ptr<BackupMetadataReader> metadata;
+        std::unique_ptr<filesystem::TreeWalker> backup;
+        if (streamFromMetadata_)
+        {
+            metadata = std::make_unique<BackupMetadataReader>(baseRoot_);
+        }
+        else
+        {
+            backup = std::make_unique<filesystem::TreeWalker>(baseRoot_, backupOptions_);
+        }
+
+        BackupFileEntry stored;
+        auto nextOld = [&](WalkEntry &entry) -> bool
+        {
+            if (backup)
+            {
+                return backup->next(entry);
+            }
+            if (!metadata->next(stored))
+            {
+                return false;
+            }
+            entry.relativePath = std::move(stored.relativePath);
+            entry.type = stored.isDirectory ? filesystem::FileType::Directory
+                                            : filesystem::FileType::File;
+            entry.size = stored.size;
+            entry.mtime = util::int64ToFileTime(stored.mtimeNs);
+            return true;
+        };
+
+        metadataWriter_.reset();
+        if (!config_.dryRun)
+        {
+            metadataWriter_ = std::make_unique<BackupMetadataWriter>(
+                config_.backupRoot, config_.sourceRoot, compressionName(), encryptionName(),
+                0, storageName());
+        }
+
+        std::vector<BackupAction> actions;
+        auto removed = [&](const WalkEntry &entry)
+        {
+            if (config_.deleteRemoved)
+            {
+                actions.push_back({ActionType::RemovePath, {}, resolveBackupPath(entry.relativePath)});
+            }
+        };
+        auto added = [&](const WalkEntry &entry)
+        {
+            if (entry.isDirectory())
+            {
+                actions.push_back({ActionType::CreateDirectory, {}, resolveBackupPath(entry.relativePath)});
+            }
+            else
+            {
+                actions.push_back({ActionType::CopyFile,
+                                   resolveSourcePath(entry.relativePath),
+                                   resolveBackupPath(entry.relativePath)});
+            }
+        };
+
+        WalkEntry o, n;
+        bool hasOld = nextOld(o);
+        bool hasNew = source.next(n);
+
+        // 整棵旧子树由一个 RemovePath 删除，其中的条目直接跳过
+        auto dropOld = [&]()
+        {
+            const std::string root = o.relativePath;
+            const bool isDirectory = o.isDirectory();
+            do
+            {
+                hasOld = nextOld(o);
+            } while (hasOld && isDirectory && isUnder(o.relativePath, root));
+        };
+
+        while (hasOld || hasNew)
+        {
+            const int cmp = !hasOld ? 1
+                          : !hasNew ? -1
+                          : o.relativePath == n.relativePath ? 0
+                          : FileTreeDiff::pathLess(o.relativePath, n.relativePath) ? -1 : 1;
+            if (cmp < 0)
+            {
+                removed(o);
+                dropOld();
+                continue;
+            }
+
+            if (cmp > 0)
+            {
+                added(n);
+            }
+            else if (o.type != n.type)
+            {
+                removed(o);
+                dropOld();
+                added(n);
+            }
+            else
+            {
+                if (n.isFile() && (rewriteAll_ || o.size != n.size || o.mtime != n.mtime))
+                {
+                    actions.push_back({ActionType::UpdateFile,
+                                       resolveSourcePath(n.relativePath),
+                                       resolveBackupPath(n.relativePath)});
+                }
+                hasOld = nextOld(o);
+            }
 
+            if (metadataWriter_)
+            {
+                metadataWriter_->add(n);
+            }
+            hasNew = source.next(n);
+        }
+
+        return actions;
+    }
+
+    // 按阶段执行，阶段之间是屏障：改名（依次）→ 删除 → 建目录（依次）→ 复制/更新文件。
+    // 写文件时目录已就绪、同一路径上的旧内容已删除，文件之间互不依赖
+    bool BackupManager::executePlan(const std::vector<BackupAction> &plan)
+    {
+        std::vector<const BackupAction *> renames;
+        std::vector<const BackupAction *> removals;
+        std::vector<const BackupAction *> directories;
+        std::vector<const BackupAction *> files;
         for (const auto &action : plan)
         {
-            if (!executeBackupAction(action))
+            switch (action.type)
+            {
+            case ActionType::RenamePath:
+                renames.push_back(&action);
+                break;
+            case ActionType::RemovePath:
+                removals.push_back(&action);
+                break;
+            case ActionType::CreateDirectory:
+                directories.push_back(&action);
+                break;
+            default:
+                files.push_back(&action);
+                break;
+            }
+        }
+        const bool overwrites = !removals.empty() ||
+                                std::any_of(files.begin(), files.end(), [](const BackupAction *action)
+                                            { return action->type == ActionType::UpdateFile; });
+        removals = outermostRemovals(std::move(removals));
+        resetCopyCounts();
+        openChunkStore();
+        openPackStore(baseRoot_);
+        deltaFiles_ = 0;
+        deltaWritten_ = 0;
+        deltaTotal_ = 0;
+        resumedActions_ = 0;
+
+        if (!snapshotId_.empty() && config_.dryRun)
+        {
+            // 试运行不留下空的快照目录
+            std::error_code ec;
+            fs::remove(config_.backupRoot, ec);
+        }
+
+        // 已完成的操作记入日志；上一次执行中断时留下的日志在这里接续
+        std::unique_ptr<ActionJournal> journal;
+        std::vector<std::string> entries(plan.size()); // 与 plan 下标对应，空表示不记录
+        if (!config_.dryRun)
+        {
+            try
+            {
+                journal = std::make_unique<ActionJournal>(config_.backupRoot / ActionJournal::kFile, journalHeader());
+                if (journal->resumed())
+                {
+                    removeStaleTemporaries();
+                }
+                if (!snapshotId_.empty() && baseRoot_ != config_.backupRoot)
+                {
+                    linkBaseSnapshot(*journal);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "[备份] 准备执行失败: " << e.what() << "\n";
+                metadataWriter_.reset();
+                return false;
+            }
+
+            auto skipDone = [&](std::vector<const BackupAction *> &actions)
+            {
+                actions.erase(
+                    std::remove_if(actions.begin(), actions.end(), [&](const BackupAction *action)
+                                   {
+                                       std::string &entry = entries[action - plan.data()];
+                                       entry = journalEntry(*action);
+                                       if (entry.empty() || !journal->contains(entry))
+                                       {
+                                           return false;
+                                       }
+                                       const bool isFile = action->type == ActionType::CopyFile ||
+                                                           action->type == ActionType::UpdateFile;
+                                       if (isFile && !fs::exists(action->targetPath))
+                                       {
+                                           return false;
+                                       }
+                                       if (isFile && config_.detectRenames && action->node &&
+                                           action->node->getHash() == 0)
+                                       {
+                                           try
+                                           {
+                                               action->node->setHash(util::fingerprintFile(action->sourcePath));
+                                           }
+                                           catch (const std::exception &)
+                                           {
+                                               return false;
+                                           }
+                                       }
+                                       ++resumedActions_;
+                                       return true;
+                                   }),
+                    actions.end());
+            };
+            skipDone(renames);
+            skipDone(removals);
+            skipDone(files);
+        }
+
+        auto record = [&](const BackupAction &action)
+        {
+            const std::string &entry = entries[&action - plan.data()];
+            if (!journal || entry.empty())
+            {
+                return;
+            }
+            try
+            {
+                journal->record(entry);
+            }
+            catch (const std::exception &e)
+            {
+                // 操作本身已完成，只是中断后需要重做
+                std::cerr << "[备份] " << e.what() << "\n";
+            }
+        };
+
+        std::atomic<bool> success{true};
+        auto run = [&](const BackupAction *action)
+        {
+            if (executeBackupAction(*action))
+            {
+                record(*action);
+            }
+            else
             {
                 success = false;
             }
+        };
+
+        for (const auto *action : renames)
+        {
+            run(action);
+        }
+        util::parallelFor(removals.size(), config_.executeThreads,
+                          [&](size_t i)
+                          { run(removals[i]); });
+        for (const auto *action : directories)
+        {
+            run(action);
+        }
+        if (!copyWithIoUring(
+                files, [&](const BackupAction &action)
+                { run(&action); },
+                record))
+        {
+            util::parallelFor(files.size(), config_.executeThreads,
+                              [&](size_t i)
+                              { run(files[i]); });
         }
 
         if (success && !config_.dryRun)
         {
-            // 仅当启用了相应功能时记录算法名称，否则记录为 none
-            std::string compressionStr = "none";
-            std::string encryptionStr = "none";
-
-            if (config_.enableCompression)
+            // 索引先于元数据提交：元数据中的文件都能在包中找到
+            if (packs_)
             {
-                switch (config_.compressionType)
+                // 快照之间共用包文件，旧快照的索引可能仍引用其中的记录，不整理
+                if (snapshotId_.empty())
                 {
-                case CompressionType::Huffman:
-                    compressionStr = "huffman";
-                    break;
-                case CompressionType::Lz77:
-                    compressionStr = "lz77";
-                    break;
-                default:
-                    compressionStr = "none";
-                    break;
+                    try
+                    {
+                        packs_->compact();
+                    }
+                    catch (const std::exception &e)
+                    {
+                        std::cerr << "[打包] 跳过整理: " << e.what() << "\n";
+                    }
                 }
+                packs_->commit(config_.backupRoot / packaging::PackStore::kIndexFile);
             }
 
-            if (config_.enableEncryption)
+            if (streaming_)
             {
-                switch (config_.encryptionType)
+                if (metadataWriter_)
                 {
-                case EncryptionType::AES:
-                    encryptionStr = "aes";
-                    break;
-                default:
-                    encryptionStr = "none";
-                    break;
+                    metadataWriter_->commit();
                 }
             }
+            else
+            {
+                const std::string compressionStr = compressionName();
+                const std::string encryptionStr = encryptionName();
+
+                BackupMetadata::writeMetadata(*sourceTree_, config_.backupRoot, compressionStr, encryptionStr,
+                                              storageName());
+            }
+            // 元数据已提交，下次执行以它为基准，不再需要日志
+            journal->remove();
 
-            BackupMetadata::writeMetadata(*sourceTree_, config_.backupRoot, compressionStr, encryptionStr);
+            // 被覆盖或删除的清单引用的块可能已无用；改回逐文件存储后整个块存储都不再需要
+            if (chunks_ && overwrites)
+            {
+                collectChunks();
+            }
+            else if (!chunks_ && snapshotId_.empty() && fs::exists(config_.backupRoot / ChunkStore::kDirectory))
+            {
+                // 快照模式下旧快照可能仍在使用块存储
+                fs::remove_all(config_.backupRoot / ChunkStore::kDirectory);
+            }
+            if (!packs_ && snapshotId_.empty() && fs::exists(config_.backupRoot / packaging::PackStore::kDirectory))
+            {
+                fs::remove_all(config_.backupRoot / packaging::PackStore::kDirectory);
+                fs::remove(config_.backupRoot / packaging::PackStore::kIndexFile);
+            }
+            if (!deltaEnabled() && fs::exists(config_.backupRoot / kSignatureDirectory))
+            {
+                fs::remove_all(config_.backupRoot / kSignatureDirectory);
+            }
+
+            if (scanCache_)
+            {
+                scanCache_->save(config_.backupRoot / kScanCacheFile);
+            }
+        }
+        else if (journal)
+        {
+            // 保留日志，下次执行跳过已完成的操作
+            journal->sync();
         }
+        // 未提交的临时元数据由析构函数删除
+        metadataWriter_.reset();
 
         return success;
     }
 
+    // 仅当启用了相应功能时记录算法名称，否则记录为 none
+    std::string BackupManager::compressionName() const
+    {
+        if (!config_.enableCompression)
+            return "none";
+
+        switch (config_.compressionType)
+        {
+        case CompressionType::Huffman:
+            return "huffman";
+        case CompressionType::Lz77:
+            return "lz77";
+        default:
+            return "none";
+        }
+    }
+
+    std::string BackupManager::encryptionName() const
+    {
+        if (!config_.enableEncryption)
+            return "none";
+
+        switch (config_.encryptionType)
+        {
+        case EncryptionType::AES:
+            return "aes";
+        default:
+            return "none";
+        }
+    }
+
+    std::string BackupManager::storageName() const
+    {
+        if (config_.chunkedStorage)
+            return "chunks";
+        return config_.packSmallFiles ? "packs" : "files";
+    }
+
     fs::path BackupManager::resolveSourcePath(const std::string &relativePath) const
     {
         return config_.sourceRoot / relativePath;
@@ -148,10 +766,17 @@ namespace backup::core
         return config_.backupRoot / relativePath;
     }
 
+    std::string BackupManager::relativeToBackup(const fs::path &path) const
+    {
+        return path.lexically_relative(config_.backupRoot).generic_string();
+    }
+
     std::vector<BackupManager::BackupAction>
     BackupManager::translateChangesToActions(const std::vector<filesystem::FileChange> &changes) const
     {
 
+        // 改名必须最先执行：其余操作可能位于改名后的路径之下
+        std::vector<BackupAction> renames;
         std::vector<BackupAction> actions;
         for (const auto &change : changes)
         {
@@ -170,13 +795,22 @@ namespace backup::core
                 {
                     actions.push_back({ActionType::CopyFile,
                                        resolveSourcePath(rel),
-                                       resolveBackupPath(rel)});
+                                       resolveBackupPath(rel),
+                                       change.newNode});
                 }
                 break;
 
             case ChangeType::Modified:
                 actions.push_back({ActionType::UpdateFile,
                                    resolveSourcePath(rel),
+                                   resolveBackupPath(rel),
+                                   change.newNode});
+                break;
+
+            case ChangeType::Renamed:
+            case ChangeType::Moved:
+                renames.push_back({ActionType::RenamePath,
+                                   resolveBackupPath(change.oldRelativePath),
                                    resolveBackupPath(rel)});
                 break;
 
@@ -194,7 +828,8 @@ namespace backup::core
             }
         }
 
-        return actions;
+        renames.insert(renames.end(), actions.begin(), actions.end());
+        return renames;
     }
 
     bool BackupManager::executeBackupAction(const BackupAction &action)
@@ -213,65 +848,106 @@ namespace backup::core
             case ActionType::CopyFile:
             case ActionType::UpdateFile:
             {
-                fs::create_directories(action.targetPath.parent_path());
-
-                fs::path current = action.sourcePath;
-                fs::path tempCompressed = action.targetPath;
-                tempCompressed += ".tmp_compress";
-                fs::path tempEncrypted = action.targetPath;
-                tempEncrypted += ".tmp_encrypt";
-
-                // 压缩（可选）
-                if (config_.enableCompression && config_.compressionType != CompressionType::None)
+                uint64_t fingerprint = 0;
+                if (packs_ && fs::file_size(action.sourcePath) < config_.packThreshold)
                 {
-                    if (!applyCompression(current, tempCompressed))
+                    // 权限与 mtime 记录在索引中；此前单独保存的同名文件（大小跨过了阈值）不再需要
+                    std::error_code ec;
+                    fs::remove(action.targetPath, ec);
+                    fs::remove(signaturePath(action.targetPath), ec);
+                    fingerprint = packs_->storeFile(action.sourcePath, relativeToBackup(action.targetPath));
+                }
+                else
+                {
+                    if (packs_)
                     {
-                        fs::remove(tempCompressed);
-                        return false;
+                        packs_->erase(relativeToBackup(action.targetPath));
+                    }
+                    fs::create_directories(action.targetPath.parent_path());
+                    if (!snapshotId_.empty())
+                    {
+                        // 可能是指向上一个快照的硬链接，必须先断开，不能覆盖旧快照的内容
+                        fs::remove(action.targetPath);
                     }
-                    current = tempCompressed;
-                }
 
-                // 加密（可选）
-                if (config_.enableEncryption && config_.encryptionType != EncryptionType::None)
-                {
-                    if (!applyEncryption(current, tempEncrypted))
+                    std::optional<util::FileSignature> signature;
+                    if (deltaEnabled())
                     {
-                        fs::remove(tempCompressed);
-                        fs::remove(tempEncrypted);
-                        return false;
+                        signature = storeWithDelta(action.sourcePath, action.targetPath);
+                    }
+                    else
+                    {
+                        fingerprint = storeFile(action.sourcePath, action.targetPath);
                     }
-                    current = tempEncrypted;
-                }
 
-                // 写入最终目标
-                if (current == action.sourcePath)
-                {
-                    fs::copy_file(
-                        action.sourcePath,
+                    // 设置文件权限和时间戳
+                    fs::permissions(
                         action.targetPath,
-                        fs::copy_options::overwrite_existing);
+                        fs::status(action.sourcePath).permissions());
+                    fs::last_write_time(
+                        action.targetPath,
+                        fs::last_write_time(action.sourcePath));
+
+                    // 签名记录写完后的大小与 mtime，下次据此判断备份文件是否被改动过
+                    if (signature)
+                    {
+                        signature->mtimeNs = util::fileTimeToInt64(fs::last_write_time(action.targetPath));
+                        const fs::path path = signaturePath(action.targetPath);
+                        fs::create_directories(path.parent_path());
+                        signature->save(path);
+                    }
                 }
-                else
+
+                // 记录写入时顺带计算的内容指纹，供后续备份识别改名；
+                // 原样复制的文件不再读一遍，识别改名时按需从备份文件计算
+                if (config_.detectRenames && action.node && action.node->getHash() == 0 && fingerprint != 0)
                 {
-                    fs::rename(current, action.targetPath);
+                    action.node->setHash(fingerprint);
                 }
-
-                fs::remove(tempCompressed);
-                fs::remove(tempEncrypted);
-
-                // 设置文件权限和时间戳
-                fs::permissions(
-                    action.targetPath,
-                    fs::status(action.sourcePath).permissions());
-                fs::last_write_time(
-                    action.targetPath,
-                    fs::last_write_time(action.sourcePath));
                 break;
             }
 
             case ActionType::RemovePath:
+            {
                 fs::remove_all(action.targetPath);
+                std::error_code ec;
+                fs::remove_all(signaturePath(action.targetPath), ec);
+                if (packs_)
+                {
+                    packs_->erase(relativeToBackup(action.targetPath));
+                }
+                break;
+            }
+
+            case ActionType::RenamePath:
+                if (packs_)
+                {
+                    packs_->rename(relativeToBackup(action.sourcePath), relativeToBackup(action.targetPath),
+                                   !config_.deleteRemoved);
+                }
+                // 只保存在包中的文件没有对应的独立文件；
+                // 或者上一次执行中断前已改名，只是没来得及记入日志
+                if (!fs::exists(action.sourcePath) && (packs_ || fs::exists(action.targetPath)))
+                {
+                    break;
+                }
+                fs::create_directories(action.targetPath.parent_path());
+                if (config_.deleteRemoved)
+                {
+                    fs::rename(action.sourcePath, action.targetPath);
+                    // 签名跟随改名；不存在时无需处理
+                    std::error_code ec;
+                    const fs::path signature = signaturePath(action.targetPath);
+                    fs::create_directories(signature.parent_path(), ec);
+                    fs::rename(signaturePath(action.sourcePath), signature, ec);
+                }
+                else
+                {
+                    // 非镜像模式保留旧路径，在备份目录内复制，仍免去重新压缩/加密
+                    fs::copy(action.sourcePath, action.targetPath,
+                             fs::copy_options::recursive | fs::copy_options::copy_symlinks |
+                                 fs::copy_options::overwrite_existing);
+                }
                 break;
 
             default:
@@ -287,8 +963,28 @@ namespace backup::core
         }
     }
 
-    void BackupManager::restore(const fs::path &restoreRoot)
+    void BackupManager::restore(const fs::path &restoreRoot, const std::string &snapshot)
     {
+        config_.backupRoot = repositoryRoot_;
+        snapshotId_.clear();
+        const auto snapshots = listSnapshots(repositoryRoot_);
+        if (!snapshot.empty())
+        {
+            if (std::find(snapshots.begin(), snapshots.end(), snapshot) == snapshots.end())
+            {
+                throw std::runtime_error("快照不存在: " + snapshot);
+            }
+            snapshotId_ = snapshot;
+        }
+        else if (!snapshots.empty() && !fs::exists(repositoryRoot_ / kMetadataFile))
+        {
+            snapshotId_ = snapshots.back();
+        }
+        if (!snapshotId_.empty())
+        {
+            config_.backupRoot = repositoryRoot_ / kSnapshotDirectory / snapshotId_;
+        }
+
         auto metadata = BackupMetadata::readMetadata(config_.backupRoot);
 
         // 从metadata中读取压缩和加密类型
@@ -320,11 +1016,32 @@ namespace backup::core
             config_.enableEncryption = false;
         }
 
-        auto actions = translateMetadataToActions(metadata, fs::absolute(restoreRoot));
+        config_.chunkedStorage = metadata.storageType == "chunks";
+        config_.packSmallFiles = metadata.storageType == "packs";
 
-        for (const auto &action : actions)
+        auto actions = translateMetadataToActions(metadata, fs::absolute(restoreRoot));
+        resetCopyCounts();
+        openChunkStore();
+        openPackStore(config_.backupRoot);
+
+        // 目录在前、文件在后；目录依次创建，文件并行还原
+        const auto firstFile = std::find_if(actions.begin(), actions.end(),
+                                            [](const BackupAction &action)
+                                            { return action.type != ActionType::CreateDirectory; });
+        std::for_each(actions.begin(), firstFile,
+                      [this](const BackupAction &action)
+                      { executeRestoreAction(action); });
+        std::vector<const BackupAction *> files;
+        for (auto it = firstFile; it != actions.end(); ++it)
+        {
+            files.push_back(&*it);
+        }
+        if (!copyWithIoUring(files, [this](const BackupAction &action)
+                             { executeRestoreAction(action); }))
         {
-            executeRestoreAction(action);
+            util::parallelFor(files.size(), config_.executeThreads,
+                              [&](size_t i)
+                              { executeRestoreAction(*files[i]); });
         }
     }
 
@@ -376,54 +1093,12 @@ namespace backup::core
             {
                 fs::create_directories(action.targetPath.parent_path());
 
-                fs::path current = action.sourcePath;
-                fs::path tempDecrypted = action.targetPath;
-                tempDecrypted += ".tmp_decrypt";
-                fs::path tempDecompressed = action.targetPath;
-                tempDecompressed += ".tmp_decompress";
-
-                // 解密（可选）
-                if (config_.enableEncryption && config_.encryptionType != EncryptionType::None)
-                {
-                    if (!applyDecryption(action.sourcePath, tempDecrypted))
-                    {
-                        fs::remove(tempDecrypted);
-                        return false;
-                    }
-                }
-                // 未开启加密直接复制到解密阶段的临时文件，便于后续统一处理
-                else
-                {
-                    fs::copy_file(action.sourcePath, tempDecrypted, fs::copy_options::overwrite_existing);
-                }
-                current = tempDecrypted;
-
-                // 解压（可选）
-                if (config_.enableCompression && config_.compressionType != CompressionType::None)
-                {
-                    if (!applyDecompression(current, tempDecompressed))
-                    {
-                        fs::remove(tempDecrypted);
-                        fs::remove(tempDecompressed);
-                        return false;
-                    }
-                    if (current == tempDecrypted)
-                        fs::remove(tempDecrypted);
-                    current = tempDecompressed;
-                }
-
-                // 写入最终目标
-                if (current == action.sourcePath)
-                {
-                    fs::copy_file(action.sourcePath, action.targetPath, fs::copy_options::overwrite_existing);
-                }
-                else
+                // 包中的文件连同权限与 mtime 一起还原
+                if (packs_ && packs_->loadFile(relativeToBackup(action.sourcePath), action.targetPath))
                 {
-                    fs::rename(current, action.targetPath);
+                    break;
                 }
-
-                fs::remove(tempDecrypted);
-                fs::remove(tempDecompressed);
+                loadFile(action.sourcePath, action.targetPath);
 
                 // 恢复备份文件的权限与时间戳
                 fs::permissions(
@@ -448,101 +1123,576 @@ namespace backup::core
         }
     }
 
-    bool BackupManager::applyCompression(const fs::path &input, const fs::path &output) const
+    bool BackupManager::copyWithIoUring(const std::vector<const BackupAction *> &files,
+                                        const std::function<void(const BackupAction &)> &fallback,
+                                        const std::function<void(const BackupAction &)> &copied)
     {
-        if (config_.compressionType == CompressionType::None)
+        const bool compress = config_.enableCompression && config_.compressionType != CompressionType::None;
+        const bool encrypt = config_.enableEncryption && config_.encryptionType != EncryptionType::None;
+        if (!config_.useIoUring || config_.dryRun || compress || encrypt || chunks_ || packs_ || deltaEnabled() ||
+            files.empty())
         {
-            // 直接复制文件
-            fs::copy_file(input, output, fs::copy_options::overwrite_existing);
-            return true;
+            return false;
         }
 
+        std::vector<util::CopyJob> jobs;
+        jobs.reserve(files.size());
+        for (const auto *action : files)
+        {
+            if (!snapshotId_.empty())
+            {
+                // 断开指向上一个快照的硬链接
+                std::error_code ec;
+                fs::remove(action->targetPath, ec);
+            }
+            jobs.push_back({action->sourcePath, action->targetPath});
+        }
         try
         {
-            // 创建对应的压缩器
-            auto compressor = backup::core::compression::createCompressor(
-                toCompressionAlgo(config_.compressionType));
-            compressor->compress(input, output);
-            return true;
+            if (!util::copyFilesWithIoUring(jobs, 64))
+            {
+                return false;
+            }
         }
         catch (const std::exception &e)
         {
-            std::cerr << "[压缩] 失败: " << e.what() << "\n";
+            std::cerr << "[io_uring] 失败，改用阻塞复制: " << e.what() << "\n";
             return false;
         }
+
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            const BackupAction &action = *files[i];
+            if (jobs[i].error != 0)
+            {
+                fallback(action);
+                continue;
+            }
+            ++copyCounts_[static_cast<size_t>(util::CopyMethod::IoUring)];
+            if (copied)
+            {
+                copied(action);
+            }
+        }
+        return true;
     }
 
-    bool BackupManager::applyDecompression(const fs::path &input, const fs::path &output) const
+    void BackupManager::copyPlain(const fs::path &source, const fs::path &target) const
     {
-        if (config_.compressionType == CompressionType::None)
+        try
         {
-            // 直接复制文件
-            fs::copy_file(input, output, fs::copy_options::overwrite_existing);
-            return true;
+            const auto method = util::copyFileFast(source, target);
+            ++copyCounts_[static_cast<size_t>(method)];
+        }
+        catch (...)
+        {
+            std::error_code ec;
+            fs::remove(target, ec);
+            throw;
+        }
+    }
+
+    void BackupManager::resetCopyCounts()
+    {
+        for (auto &count : copyCounts_)
+        {
+            count = 0;
+        }
+    }
+
+    void BackupManager::openChunkStore()
+    {
+        chunks_.reset();
+        if (!config_.chunkedStorage)
+        {
+            return;
+        }
+
+        ChunkStore::Options options;
+        options.compress = config_.enableCompression && config_.compressionType != CompressionType::None;
+        if (options.compress)
+        {
+            options.compressionType = toCompressionAlgo(config_.compressionType);
+        }
+        options.encrypt = config_.enableEncryption && config_.encryptionType != EncryptionType::None;
+        if (options.encrypt)
+        {
+            options.encryptionType = toEncryptionAlgo(config_.encryptionType);
+            options.encryptionKey = config_.encryptionKey;
+        }
+        options.threads = config_.compressionThreads;
+        // 所有快照共用一个块存储
+        chunks_ = std::make_unique<ChunkStore>(repositoryRoot_, std::move(options));
+    }
+
+    void BackupManager::openPackStore(const fs::path &indexRoot)
+    {
+        packs_.reset();
+        if (storageName() != "packs")
+        {
+            return;
+        }
+
+        packaging::PackStore::Options options;
+        options.compress = config_.enableCompression && config_.compressionType != CompressionType::None;
+        if (options.compress)
+        {
+            options.compressionType = toCompressionAlgo(config_.compressionType);
+        }
+        options.encrypt = config_.enableEncryption && config_.encryptionType != EncryptionType::None;
+        if (options.encrypt)
+        {
+            options.encryptionType = toEncryptionAlgo(config_.encryptionType);
+            options.encryptionKey = config_.encryptionKey;
+        }
+        packs_ = std::make_unique<packaging::PackStore>(repositoryRoot_ / packaging::PackStore::kDirectory,
+                                                        indexRoot / packaging::PackStore::kIndexFile,
+                                                        std::move(options));
+    }
+
+    void BackupManager::collectChunks()
+    {
+        // 快照模式下所有快照（包括中断的）中的清单都可能引用块
+        std::vector<fs::path> roots;
+        if (snapshotId_.empty())
+        {
+            roots.push_back(config_.backupRoot);
+        }
+        else
+        {
+            for (const auto &entry : fs::directory_iterator(repositoryRoot_ / kSnapshotDirectory))
+            {
+                if (entry.is_directory())
+                {
+                    roots.push_back(entry.path());
+                }
+            }
         }
 
+        std::unordered_set<std::string> live;
         try
         {
-            // 创建对应的解压器
-            auto compressor = backup::core::compression::createCompressor(
-                toCompressionAlgo(config_.compressionType));
-            compressor->decompress(input, output);
-            return true;
+            for (const auto &root : roots)
+            {
+                filesystem::TreeWalker walker(root, backupOptions_);
+                for (const auto &entry : walker)
+                {
+                    if (!entry.isFile())
+                    {
+                        continue;
+                    }
+                    for (auto &ref : ChunkStore::readManifest(root / entry.relativePath))
+                    {
+                        live.insert(std::move(ref.id));
+                    }
+                }
+            }
         }
         catch (const std::exception &e)
         {
-            std::cerr << "[解压] 失败: " << e.what() << "\n";
-            return false;
+            std::cerr << "[块存储] 跳过清理: " << e.what() << "\n";
+            return;
         }
+        chunks_->sweep(live);
+    }
+
+    bool BackupManager::deltaEnabled() const
+    {
+        // 快照之间共享硬链接，不能原地修补
+        return config_.deltaUpdates && compressionName() == "none" && encryptionName() == "none" &&
+               !config_.chunkedStorage && !config_.snapshots;
     }
 
-    bool BackupManager::applyEncryption(const fs::path &input, const fs::path &output) const
+    void BackupManager::beginSnapshot()
     {
-        if (config_.encryptionType == EncryptionType::None)
+        // 快照是时间点的完整镜像，已删除的文件不再出现
+        config_.deleteRemoved = true;
+
+        std::string id;
+        for (char c : util::currentTimeUTC())
         {
-            // 直接复制文件
-            fs::copy_file(input, output, fs::copy_options::overwrite_existing);
-            return true;
+            if (c != '-' && c != ':')
+            {
+                id += c;
+            }
+        }
+        const fs::path snapshotsDir = repositoryRoot_ / kSnapshotDirectory;
+
+        // 最新的快照没有元数据却留有操作日志：上一次备份中断，配置相同时在原快照中接续；
+        // 配置不同时中断的快照无法沿用（其中的文件可能与上一个快照共用硬链接），删除后重新开始
+        std::string newest;
+        std::optional<std::pair<std::string, unsigned long>> newestKey;
+        std::error_code ec;
+        for (fs::directory_iterator it(snapshotsDir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const std::string name = it->path().filename().string();
+            const auto key = snapshotKey(name);
+            if (it->is_directory() && key && (!newestKey || *newestKey < *key))
+            {
+                newest = name;
+                newestKey = key;
+            }
+        }
+        const bool interrupted = !newest.empty() && !fs::exists(snapshotsDir / newest / kMetadataFile) &&
+                                 fs::exists(snapshotsDir / newest / ActionJournal::kFile);
+        if (interrupted && ActionJournal::matches(snapshotsDir / newest / ActionJournal::kFile, journalHeader()))
+        {
+            snapshotId_ = newest;
+        }
+        else
+        {
+            if (interrupted && !config_.dryRun)
+            {
+                // 删除硬链接不影响其他快照中的文件
+                fs::remove_all(snapshotsDir / newest, ec);
+            }
+            snapshotId_ = id;
+            for (unsigned n = 2; fs::exists(snapshotsDir / snapshotId_); ++n)
+            {
+                snapshotId_ = id + "_" + std::to_string(n);
+            }
+        }
+
+        const auto previous = listSnapshots(repositoryRoot_);
+        config_.backupRoot = snapshotsDir / snapshotId_;
+        baseRoot_ = previous.empty() ? config_.backupRoot : snapshotsDir / previous.back();
+        fs::create_directories(config_.backupRoot);
+    }
+
+    void BackupManager::linkBaseSnapshot(ActionJournal &journal)
+    {
+        // 链接完成后才执行计划中的操作，此后不能再链接，否则会用旧内容覆盖已写入的文件
+        constexpr const char *kLinked = "L";
+        if (journal.contains(kLinked))
+        {
+            return;
+        }
+
+        filesystem::TreeWalker walker(baseRoot_, backupOptions_);
+        for (const auto &entry : walker)
+        {
+            const fs::path target = config_.backupRoot / entry.relativePath;
+            if (entry.isDirectory())
+            {
+                fs::create_directory(target);
+                continue;
+            }
+            const fs::path source = baseRoot_ / entry.relativePath;
+            std::error_code ec;
+            // 中断前已链接的文件
+            if (fs::equivalent(source, target, ec))
+            {
+                continue;
+            }
+            // 已有的目标（中断前复制的文件可能不完整）先删除再链接，不能原地截断：它可能与其他快照共用
+            fs::remove(target, ec);
+            ec.clear();
+            fs::create_hard_link(source, target, ec);
+            if (ec)
+            {
+                // 例如超过了文件系统的硬链接数上限；目标已存在时不在其上复制
+                if (ec == std::errc::file_exists)
+                {
+                    throw std::runtime_error("无法链接到快照: " + target.string() + ": " + ec.message());
+                }
+                util::copyFileFast(source, target);
+                fs::permissions(target, fs::status(source).permissions());
+                fs::last_write_time(target, fs::last_write_time(source));
+            }
+        }
+        journal.record(kLinked);
+        journal.sync();
+    }
+
+    std::string BackupManager::journalHeader() const
+    {
+        return compressionName() + "|" + encryptionName() + "|" + storageName() + "|" +
+               fs::absolute(config_.sourceRoot).generic_string();
+    }
+
+    std::string BackupManager::journalEntry(const BackupAction &action) const
+    {
+        // 打包时索引在执行成功后才写出，中断前写入包中的文件、改名与删除都要重做
+        if (packs_ && (action.type == ActionType::RemovePath || action.type == ActionType::RenamePath))
+        {
+            return {};
+        }
+
+        switch (action.type)
+        {
+        case ActionType::CopyFile:
+        case ActionType::UpdateFile:
+        {
+            std::error_code ec;
+            const auto size = fs::file_size(action.sourcePath, ec);
+            if (ec || (packs_ && size < config_.packThreshold))
+            {
+                return {};
+            }
+            const auto mtime = fs::last_write_time(action.sourcePath, ec);
+            if (ec)
+            {
+                return {};
+            }
+            return "F|" + relativeToBackup(action.targetPath) + "|" + std::to_string(size) + "|" +
+                   std::to_string(util::fileTimeToInt64(mtime));
+        }
+        case ActionType::RemovePath:
+            return "X|" + relativeToBackup(action.targetPath);
+        case ActionType::RenamePath:
+            return "R|" + relativeToBackup(action.sourcePath) + "|" + relativeToBackup(action.targetPath);
+        default:
+            return {};
+        }
+    }
+
+    void BackupManager::removeStaleTemporaries() const
+    {
+        auto endsWith = [](const std::string &name, const std::string &suffix)
+        {
+            return name.size() >= suffix.size() &&
+                   name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+
+        std::vector<fs::path> stale;
+        // 旧版本压缩/加密时在目标文件旁写入的中间文件
+        filesystem::TreeWalker walker(config_.backupRoot, backupOptions_);
+        for (const auto &entry : walker)
+        {
+            if (entry.isFile() &&
+                (endsWith(entry.relativePath, ".tmp_compress") || endsWith(entry.relativePath, ".tmp_encrypt") ||
+                 endsWith(entry.relativePath, ".tmp_decrypt") || endsWith(entry.relativePath, ".tmp_decompress")))
+            {
+                stale.push_back(config_.backupRoot / entry.relativePath);
+            }
+        }
+        // 签名与块先写入 <名称>.tmp… 再改名
+        std::error_code ec;
+        for (const fs::path &dir : {config_.backupRoot / kSignatureDirectory, repositoryRoot_ / ChunkStore::kDirectory})
+        {
+            for (fs::recursive_directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                if (it->is_regular_file() && it->path().filename().string().find(".tmp") != std::string::npos)
+                {
+                    stale.push_back(it->path());
+                }
+            }
+            ec.clear();
+        }
+        for (const auto &path : stale)
+        {
+            fs::remove(path, ec);
+        }
+    }
+
+    const std::string &BackupManager::snapshotId() const noexcept
+    {
+        return snapshotId_;
+    }
+
+    std::vector<std::string> BackupManager::listSnapshots(const fs::path &backupRoot)
+    {
+        std::vector<std::string> snapshots;
+        std::error_code ec;
+        for (fs::directory_iterator it(backupRoot / kSnapshotDirectory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const std::string name = it->path().filename().string();
+            if (it->is_directory() && snapshotKey(name) && fs::exists(it->path() / kMetadataFile))
+            {
+                snapshots.push_back(name);
+            }
+        }
+        std::sort(snapshots.begin(), snapshots.end(), [](const std::string &a, const std::string &b)
+                  { return *snapshotKey(a) < *snapshotKey(b); });
+        return snapshots;
+    }
+
+    fs::path BackupManager::signaturePath(const fs::path &target) const
+    {
+        return config_.backupRoot / kSignatureDirectory / target.lexically_relative(config_.backupRoot);
+    }
+
+    std::optional<util::FileSignature> BackupManager::storeWithDelta(const fs::path &source, const fs::path &target)
+    {
+        const fs::path path = signaturePath(target);
+        util::FileSignature old;
+        std::error_code ec;
+        const bool patchable = old.load(path) &&
+                               fs::file_size(target, ec) == old.fileSize && !ec &&
+                               util::fileTimeToInt64(fs::last_write_time(target, ec)) == old.mtimeNs && !ec;
+        // 修改 target 之前先删除签名，中途失败时不会留下与内容不符的签名
+        fs::remove(path, ec);
+
+        if (fs::file_size(source) < kDeltaMinSize)
+        {
+            copyPlain(source, target);
+            return std::nullopt;
+        }
+        if (!patchable)
+        {
+            copyPlain(source, target);
+            return util::signFile(target);
+        }
+
+        auto result = util::patchFile(source, target, old);
+        ++deltaFiles_;
+        deltaWritten_ += result.bytesWritten;
+        deltaTotal_ += result.signature.fileSize;
+        return std::move(result.signature);
+    }
+
+    size_t BackupManager::resumedActions() const noexcept
+    {
+        return resumedActions_;
+    }
+
+    packaging::PackStore::Stats BackupManager::packStats() const
+    {
+        return packs_ ? packs_->stats() : packaging::PackStore::Stats{};
+    }
+
+    BackupManager::DeltaStats BackupManager::deltaStats() const
+    {
+        return {deltaFiles_.load(), deltaWritten_.load(), deltaTotal_.load()};
+    }
+
+    ChunkStore::Stats BackupManager::chunkStats() const
+    {
+        return chunks_ ? chunks_->stats() : ChunkStore::Stats{};
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> BackupManager::copyMethodCounts() const
+    {
+        std::vector<std::pair<std::string, uint64_t>> counts;
+        for (size_t i = 0; i < copyCounts_.size(); ++i)
+        {
+            if (const uint64_t n = copyCounts_[i].load())
+            {
+                counts.emplace_back(util::copyMethodName(static_cast<util::CopyMethod>(i)), n);
+            }
+        }
+        return counts;
+    }
+
+    // 源文件 → 压缩（可选）→ 加密（可选）→ 目标文件，各阶段直接串联，不落临时文件。
+    // 压缩时为流水线：读取线程、compressionThreads 个压缩线程、调用线程中按序加密、写盘线程
+    uint64_t BackupManager::storeFile(const fs::path &source, const fs::path &target) const
+    {
+        if (chunks_)
+        {
+            return chunks_->storeFile(source, target);
+        }
+
+        const bool compress = config_.enableCompression && config_.compressionType != CompressionType::None;
+        const bool encrypt = config_.enableEncryption && config_.encryptionType != EncryptionType::None;
+        if (!compress && !encrypt)
+        {
+            // 备份文件与源文件内容相同，识别改名时需要的指纹可以从备份文件计算
+            copyPlain(source, target);
+            return 0;
         }
 
         try
         {
-            // 创建对应的加密器
-            auto encryptor = backup::core::encryption::createEncryptor(
-                toEncryptionAlgo(config_.encryptionType));
-            encryptor->setKey(config_.encryptionKey);
-            encryptor->encrypt(input, output);
-            return true;
+            util::FileSink file(target);
+            util::AsyncSink writer(file);
+            std::unique_ptr<encryption::Encryption> encryptor;
+            std::unique_ptr<util::ByteSink> cipher;
+            util::ByteSink *output = &writer;
+            if (encrypt)
+            {
+                encryptor = encryption::createEncryptor(toEncryptionAlgo(config_.encryptionType));
+                encryptor->setKey(config_.encryptionKey);
+                cipher = encryptor->encryptTo(writer);
+                output = cipher.get();
+            }
+
+            util::XxHash64 hash;
+            if (compress)
+            {
+                compression::BlockOptions options;
+                options.threads = config_.compressionThreads;
+                options.inputHash = &hash;
+                compression::compressBlocks(toCompressionAlgo(config_.compressionType), source, *output, options);
+            }
+            else
+            {
+                HashingSink hashing(*output, hash);
+                util::pumpFile(source, hashing);
+            }
+            output->finish();
+            return util::fingerprintOf(hash);
         }
-        catch (const std::exception &e)
+        catch (...)
         {
-            std::cerr << "[加密] 失败: " << e.what() << "\n";
-            return false;
+            // 目标已被截断，写了一半的文件没有保留价值
+            std::error_code ec;
+            fs::remove(target, ec);
+            throw;
         }
     }
 
-    bool BackupManager::applyDecryption(const fs::path &input, const fs::path &output) const
+    // 备份文件 → 解密（可选）→ 解压（可选）→ 目标文件；
+    // 解压时读取与解密在读取线程中，各块并行解压，调用线程按序写盘
+    void BackupManager::loadFile(const fs::path &stored, const fs::path &target) const
     {
-        if (config_.encryptionType == EncryptionType::None)
+        if (chunks_)
         {
-            // 直接复制文件
-            fs::copy_file(input, output, fs::copy_options::overwrite_existing);
-            return true;
+            chunks_->loadFile(stored, target);
+            return;
+        }
+
+        const bool decompress = config_.enableCompression && config_.compressionType != CompressionType::None;
+        const bool decrypt = config_.enableEncryption && config_.encryptionType != EncryptionType::None;
+        if (!decompress && !decrypt)
+        {
+            copyPlain(stored, target);
+            return;
         }
 
         try
         {
-            // 创建对应的解密器
-            auto encryptor = backup::core::encryption::createEncryptor(
-                toEncryptionAlgo(config_.encryptionType));
-            encryptor->setKey(config_.encryptionKey);
-            encryptor->decrypt(input, output);
-            return true;
+            util::FileSink file(target);
+            std::unique_ptr<encryption::Encryption> decryptor;
+            if (decrypt)
+            {
+                decryptor = encryption::createEncryptor(toEncryptionAlgo(config_.encryptionType));
+                decryptor->setKey(config_.encryptionKey);
+            }
+
+            if (!decompress)
+            {
+                auto cipher = decryptor->decryptTo(file);
+                util::pumpFile(stored, *cipher);
+                cipher->finish();
+                return;
+            }
+
+            compression::BlockOptions options;
+            options.threads = config_.compressionThreads;
+            compression::decompressBlocks(
+                toCompressionAlgo(config_.compressionType),
+                [&](util::ByteSink &blocks)
+                {
+                    if (decrypt)
+                    {
+                        auto cipher = decryptor->decryptTo(blocks);
+                        util::pumpFile(stored, *cipher);
+                        cipher->finish();
+                    }
+                    else
+                    {
+                        util::pumpFile(stored, blocks);
+                    }
+                },
+                file, options);
+            file.finish();
         }
-        catch (const std::exception &e)
+        catch (...)
         {
-            std::cerr << "[解密] 失败: " << e.what() << "\n";
-            return false;
+            std::error_code ec;
+            fs::remove(target, ec);
+            throw;
         }
     }
 
@@ -4,10 +4,22 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <functional>
+#include <array>
+#include <atomic>
+#include <optional>
+#include <utility>
 
 #include "filesystem/FileTree.h"
 #include "filesystem/FileTreeDiff.h"
+#include "filesystem/ScanCache.h"
+#include "filesystem/PathFilter.h"
+#include "ActionJournal.h"
 #include "BackupMetadata.h"
+#include "ChunkStore.h"
+#include "packaging/Packaging.h"
+#include "util/Delta.h"
+#include "util/FileCopy.h"
 
 namespace backup::core
 {
@@ -51,6 +63,33 @@ namespace backup::core
             EncryptionType encryptionType = EncryptionType::AES;
             std::string encryptionKey;     // 加密密钥
             bool enableEncryption = false; // 是否启用加密
+            // 扫描配置
+            unsigned scanThreads = 1; // 目录扫描线程数，>1 时启用并行扫描
+            filesystem::ScanBackend scanBackend = filesystem::ScanBackend::Portable; // 目录读取方式
+            bool useScanCache = false; // 使用备份目录中的 .scancache 跳过未变化目录的 readdir
+            bool diffAgainstMetadata = true; // 以 .backupmeta 为对比基准，不再扫描备份目录
+            bool detectRenames = false;      // 识别重命名/移动，在备份目录内改名而不是删除后重新写入
+            // 过滤规则（glob，语法见 filesystem/PathFilter.h），被排除的目录不会被读取
+            std::vector<std::string> includePatterns;
+            std::vector<std::string> excludePatterns;
+            // 单遍流式扫描：边遍历源目录边与元数据对比并写出新元数据，不在内存中构建目录树；
+            // 启用 detectRenames 或遇到旧版本无序元数据时自动改用目录树对比
+            bool streamingPlan = false;
+            // 执行配置
+            unsigned executeThreads = 1; // 执行计划/还原时并行处理文件的线程数
+            unsigned compressionThreads = 1; // 单个文件内并行压缩/解压各块的线程数
+            bool useIoUring = false; // 不压缩不加密时经由 io_uring 批量复制文件（仅 Linux，不可用时回退）
+            // 存储配置
+            bool chunkedStorage = false; // 文件切分为内容定义的块去重保存（见 ChunkStore.h），备份目录中只保存块清单
+            // 小于 packThreshold 的文件合并写入 .packs/ 下的包文件（见 packaging/Packaging.h），不再各占一个文件；
+            // 与 chunkedStorage 同时设置时以块存储为准
+            bool packSmallFiles = false;
+            uint64_t packThreshold = 64 << 10;
+            // 不压缩、不加密的逐文件存储中，较大的文件保存块签名，更新时原地修补，只写入变化的块
+            bool deltaUpdates = false;
+            // 每次备份生成独立的快照 <backupRoot>/snapshots/<时间戳>/（带各自的 .backupmeta），
+            // 未变化的文件硬链接到上一个快照，变化的文件正常写入；快照总是镜像源目录
+            bool snapshots = false;
         };
 
         enum class ActionType
@@ -58,7 +97,8 @@ namespace backup::core
             CreateDirectory,
             CopyFile,
             UpdateFile,
-            RemovePath
+            RemovePath,
+            RenamePath // 备份目录内 sourcePath -> targetPath
         };
 
         struct BackupAction
@@ -66,6 +106,7 @@ namespace backup::core
             ActionType type;
             fs::path sourcePath; // restore 时为 backup path
             fs::path targetPath;
+            std::shared_ptr<filesystem::FileNode> node{}; // 对应的源节点，写入后回填内容指纹
         };
 
         explicit BackupManager(BackupConfig config);
@@ -76,18 +117,76 @@ namespace backup::core
 
         bool executePlan(const std::vector<BackupAction> &plan);
 
-        void restore(const fs::path &restoreRoot);
+        // 备份目录中有快照时还原 snapshot 指定的快照，为空则还原最新的快照
+        void restore(const fs::path &restoreRoot, const std::string &snapshot = {});
+
+        // 最近一次 scan() 创建或 restore() 使用的快照 ID，不是快照时为空
+        const std::string &snapshotId() const noexcept;
+
+        // 备份目录中已完成的快照，按时间从旧到新；中断的备份留下的快照没有元数据，不计入
+        static std::vector<std::string> listSnapshots(const fs::path &backupRoot);
+
+        // 最近一次 executePlan()/restore() 中各复制方式处理的文件数（不压缩不加密时），
+        // 只列出用到的方式，如 {"copy_file_range", 120}
+        std::vector<std::pair<std::string, uint64_t>> copyMethodCounts() const;
+
+        // 最近一次 executePlan()/restore() 的块存储统计（未启用块存储时全为 0）
+        ChunkStore::Stats chunkStats() const;
+
+        struct DeltaStats
+        {
+            uint64_t files = 0;        // 按签名原地修补的文件数
+            uint64_t bytesWritten = 0; // 其中实际写入的字节数
+            uint64_t bytesTotal = 0;   // 这些文件的总大小
+        };
+
+        // 最近一次 executePlan() 的增量修补统计
+        DeltaStats deltaStats() const;
+
+        // 最近一次 executePlan()/restore() 的打包统计（未启用打包时全为 0）
+        packaging::PackStore::Stats packStats() const;
+
+        // 最近一次 executePlan() 接续上一次中断的执行时，按操作日志跳过的已完成操作数
+        size_t resumedActions() const noexcept;
 
     private:
         BackupConfig config_;
+        fs::path repositoryRoot_; // 构造时的 backupRoot；快照模式下 config_.backupRoot 指向本次的快照
+        fs::path baseRoot_;       // 对比基准所在目录：上一个快照，非快照模式下即 backupRoot
+        std::string snapshotId_;
 
         std::unique_ptr<filesystem::FileTree> sourceTree_;
         std::unique_ptr<filesystem::FileTree> backupTree_;
+        std::unique_ptr<filesystem::ScanCache> scanCache_;
+        filesystem::PathFilter filter_;
+        filesystem::PathFilter internalFiles_; // 备份目录中的元数据等内部文件，不参与对比
+        filesystem::ScanOptions sourceOptions_;
+        filesystem::ScanOptions backupOptions_;
+
+        bool streaming_ = false;          // 本次 scan() 选择了流式对比
+        bool streamFromMetadata_ = false; // 流式对比的基准是 .backupmeta 而不是备份目录
+        std::unique_ptr<BackupMetadataWriter> metadataWriter_; // 流式计划生成时写出的新元数据
+
+        mutable std::array<std::atomic<uint64_t>, util::kCopyMethodCount> copyCounts_{};
+        std::unique_ptr<ChunkStore> chunks_; // 启用块存储时在执行/还原前创建
+        std::unique_ptr<packaging::PackStore> packs_; // 启用打包时在执行/还原前创建
+        std::atomic<uint64_t> deltaFiles_{0};
+        std::atomic<uint64_t> deltaWritten_{0};
+        std::atomic<uint64_t> deltaTotal_{0};
+        size_t resumedActions_ = 0;
 
         std::vector<filesystem::FileChange> changes_;
+        bool rewriteAll_ = false; // 压缩/加密方式与上次备份不同，需要重写全部文件
+
+        std::string compressionName() const;
+        std::string encryptionName() const;
+        std::string storageName() const;
 
         fs::path resolveSourcePath(const std::string &relativePath) const;
         fs::path resolveBackupPath(const std::string &relativePath) const;
+        std::string relativeToBackup(const fs::path &path) const;
+
+        std::vector<BackupAction> buildStreamingPlan();
 
         std::vector<BackupAction>
         translateChangesToActions(
@@ -100,23 +199,56 @@ namespace backup::core
         bool executeBackupAction(const BackupAction &action);
         bool executeRestoreAction(const BackupAction &action);
 
-        bool applyCompression(
-            const fs::path &input,
-            const fs::path &output) const;
-
-        bool applyDecompression(
-            const fs::path &input,
-            const fs::path &output) const;
-
-        bool applyEncryption(
-            const fs::path &input,
-            const fs::path &output) const;
-
-        bool applyDecryption(
-            const fs::path &input,
-            const fs::path &output) const;
+        // 不压缩不加密时经由 io_uring 批量复制；不适用或不可用时返回 false，由调用方走阻塞路径。
+        // 复制失败的文件交给 fallback 逐个重做（创建缺失的目录、输出错误），成功的文件交给 copied
+        bool copyWithIoUring(const std::vector<const BackupAction *> &files,
+                             const std::function<void(const BackupAction &)> &fallback,
+                             const std::function<void(const BackupAction &)> &copied = {});
+
+        // 不压缩不加密时的单个文件复制（reflink → copy_file_range → sendfile → 用户态），记录所用方式
+        void copyPlain(const fs::path &source, const fs::path &target) const;
+        void resetCopyCounts();
+
+        // 选定本次快照的目录与对比基准
+        void beginSnapshot();
+        // 把基准快照中的目录与文件逐个硬链接到新快照（同 rsync --link-dest），计划随后作用于新快照；
+        // 接续中断的快照时跳过已链接的文件
+        void linkBaseSnapshot(ActionJournal &journal);
+
+        // 操作日志的头部：存储格式或源目录不同时，上一次中断留下的记录不能沿用
+        std::string journalHeader() const;
+        // 操作完成后记录的条目；文件操作带上执行前源文件的大小与 mtime，源文件此后变化则重做。
+        // 源文件无法访问时返回空，不记录
+        std::string journalEntry(const BackupAction &action) const;
+        // 删除中断的执行留下的临时文件
+        void removeStaleTemporaries() const;
+
+        void openChunkStore();
+        // 包文件所有快照共用，索引从 indexRoot 载入
+        void openPackStore(const fs::path &indexRoot);
+        // 读取备份目录中全部清单，删除不再被引用的块；有清单无法读取时不删除任何块
+        void collectChunks();
+
+        bool deltaEnabled() const;
+        fs::path signaturePath(const fs::path &target) const;
+
+        // 有与 target 当前状态一致的签名时原地修补，否则整体复制；
+        // 返回 target 新内容的签名（小文件不保存签名，返回空），mtime 由调用方设置后填写
+        std::optional<util::FileSignature> storeWithDelta(const fs::path &source, const fs::path &target);
+
+        // 源文件 → 分块压缩 → 加密 → target，失败时抛出异常并删除 target；
+        // 启用块存储时改为写入新块，target 保存块清单。
+        // 返回读取过程中顺带计算的内容指纹；原样复制（内核内复制，不经过用户态）时返回 0
+        uint64_t storeFile(const fs::path &source, const fs::path &target) const;
+
+        // 备份文件 → 解密 → 分块解压 → target，失败时抛出异常并删除 target
+        void loadFile(const fs::path &stored, const fs::path &target) const;
 
         static constexpr const char *kMetadataFile = ".backupmeta";
+        static constexpr const char *kScanCacheFile = ".scancache";
+        static constexpr const char *kSignatureDirectory = ".signatures"; // 与备份目录同构，每个文件一个签名
+        static constexpr uint64_t kDeltaMinSize = 1 << 20; // 更小的文件直接整体复制
+        static constexpr const char *kSnapshotDirectory = "snapshots";
     };
 
 } // namespace backup::core
@@ -2,27 +2,193 @@
 #include "util/TimeUtils.h"
 
 #include <fstream>
+#include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 
 namespace backup::core {
 
-void BackupMetadata::writeMetadata(const filesystem::FileTree& sourceTree,
-                                   const std::filesystem::path& backupRoot,
-                                   const std::string& compressionType,
-                                   const std::string& encryptionType) {
-    const auto metaPath = backupRoot / ".backupmeta";
-    std::ofstream out(metaPath, std::ios::trunc);
-    if (!out.is_open()) {
+namespace {
+
+constexpr const char* kMetadataFile = ".backupmeta";
+constexpr const char* kMetadataTempFile = ".backupmeta.tmp";
+
+// format: F|relPath|size|mtime or D|relPath|0|0,
+// optionally followed by |dev|ino|hash
+// relPath may itself contain '|': the numeric fields are taken from the right,
+// and the writer always emits the long form for such paths
+bool parseEntry(const std::string& line, BackupFileEntry& entry) {
+    std::istringstream ss(line);
+    std::string token;
+    std::vector<std::string> parts;
+    while (std::getline(ss, token, '|')) {
+        parts.push_back(token);
+    }
+    if (parts.size() < 4) return false;
+
+    const size_t trailing = parts.size() >= 7 ? 5 : 2;
+    const size_t pathEnd = parts.size() - trailing;
+    entry = BackupFileEntry{};
+    entry.isDirectory = (parts[0] == "D");
+    entry.relativePath = parts[1];
+    for (size_t i = 2; i < pathEnd; ++i) {
+        entry.relativePath += '|';
+        entry.relativePath += parts[i];
+    }
+    entry.size = std::stoull(parts[pathEnd]);
+    entry.mtimeNs = std::stoll(parts[pathEnd + 1]);
+    if (trailing == 5) {
+        entry.dev = std::stoull(parts[pathEnd + 2]);
+        entry.ino = std::stoull(parts[pathEnd + 3]);
+        entry.hash = std::stoull(parts[pathEnd + 4]);
+    }
+    return true;
+}
+
+} // namespace
+
+BackupMetadataWriter::BackupMetadataWriter(const std::filesystem::path& backupRoot,
+                                           const std::filesystem::path& sourceRoot,
+                                           const std::string& compressionType,
+                                           const std::string& encryptionType,
+                                           uint64_t rootHash,
+                                           const std::string& storageType)
+    : tempPath_(backupRoot / kMetadataTempFile),
+      finalPath_(backupRoot / kMetadataFile) {
+    out_.open(tempPath_, std::ios::trunc);
+    if (!out_.is_open()) {
         throw std::runtime_error("Failed to open metadata file for writing");
     }
 
-    out << "tool=sd-databackup\n";
-    out << "created=" << util::currentTimeUTC() << "\n";
-    out << "source_root=" << sourceTree.getRootPath().string() << "\n";
-    out << "compression=" << compressionType << "\n";
-    out << "encryption=" << encryptionType << "\n";
+    out_ << "tool=sd-databackup\n";
+    out_ << "created=" << util::currentTimeUTC() << "\n";
+    out_ << "source_root=" << sourceRoot.string() << "\n";
+    out_ << "compression=" << compressionType << "\n";
+    out_ << "encryption=" << encryptionType << "\n";
+    if (rootHash != 0) {
+        out_ << "root_hash=" << rootHash << "\n";
+    }
+    // 默认的逐文件存储不写，保持旧格式
+    if (storageType != "files") {
+        out_ << "storage=" << storageType << "\n";
+    }
+
+    out_ << "[filelist]\n";
+}
+
+BackupMetadataWriter::~BackupMetadataWriter() {
+    if (!committed_) {
+        out_.close();
+        std::error_code ec;
+        std::filesystem::remove(tempPath_, ec);
+    }
+}
+
+void BackupMetadataWriter::add(const std::string& relPath, bool isDirectory,
+                               uintmax_t size, int64_t mtimeNs,
+                               uint64_t dev, uint64_t ino, uint64_t hash) {
+    if (isDirectory) {
+        out_ << "D|"
+             << relPath
+             << "|0|0";
+    } else {
+        out_ << "F|"
+             << relPath
+             << "|"
+             << size
+             << "|"
+             << mtimeNs;
+    }
+    // 未知时省略，保持旧格式；路径含 '|' 时总是写出，读取时才能从右侧确定各字段
+    if (dev != 0 || ino != 0 || hash != 0 || relPath.find('|') != std::string::npos) {
+        out_ << "|" << dev << "|" << ino << "|" << hash;
+    }
+    out_ << "\n";
+}
+
+void BackupMetadataWriter::add(const filesystem::WalkEntry& entry) {
+    if (entry.isDirectory()) {
+        add(entry.relativePath, true, 0, 0, entry.dev, entry.ino);
+    } else {
+        add(entry.relativePath, false, entry.size,
+            util::fileTimeToInt64(entry.mtime), entry.dev, entry.ino);
+    }
+}
+
+void BackupMetadataWriter::commit() {
+    out_.flush();
+    if (!out_.good()) {
+        throw std::runtime_error("Failed to write metadata file");
+    }
+    out_.close();
+    // 写完后整体替换，中途失败不会留下残缺的元数据
+    std::filesystem::rename(tempPath_, finalPath_);
+    committed_ = true;
+}
+
+BackupMetadataReader::BackupMetadataReader(const std::filesystem::path& backupRoot)
+    : in_(backupRoot / kMetadataFile) {
+    if (!in_.is_open()) {
+        throw std::runtime_error("Failed to open metadata file for reading");
+    }
+
+    std::string line;
+    while (std::getline(in_, line)) {
+        if (line.empty()) continue;
 
-    out << "[filelist]\n";
+        // section header
+        if (line == "[filelist]") {
+            break;
+        }
+
+        // key=value
+        auto pos = line.find('=');
+        if (pos == std::string::npos) continue;
+
+        std::string key = line.substr(0, pos);
+        std::string value = line.substr(pos + 1);
+
+        if (key == "tool") {
+            header_.tool = value;
+        } else if (key == "created") {
+            header_.createdUTC = value;
+        } else if (key == "source_root") {
+            header_.sourceRoot = value;
+        } else if (key == "compression") {
+            header_.compressionType = value;
+        } else if (key == "encryption") {
+            header_.encryptionType = value;
+        } else if (key == "root_hash") {
+            header_.rootHash = std::stoull(value);
+        } else if (key == "storage") {
+            header_.storageType = value;
+        }
+    }
+}
+
+const BackupMetadataInfo& BackupMetadataReader::header() const noexcept {
+    return header_;
+}
+
+bool BackupMetadataReader::next(BackupFileEntry& entry) {
+    std::string line;
+    while (std::getline(in_, line)) {
+        if (!line.empty() && parseEntry(line, entry)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BackupMetadata::writeMetadata(const filesystem::FileTree& sourceTree,
+                                   const std::filesystem::path& backupRoot,
+                                   const std::string& compressionType,
+                                   const std::string& encryptionType,
+                                   const std::string& storageType) {
+    const auto root = sourceTree.getRoot();
+    BackupMetadataWriter writer(backupRoot, sourceTree.getRootPath(),
+                                compressionType, encryptionType,
+                                root ? root->getHash() : 0, storageType);
 
     sourceTree.traverseDFS([&](const filesystem::FileNode& node) {
         const std::string& relPath = node.getRelativePath();
@@ -32,89 +198,117 @@ void BackupMetadata::writeMetadata(const filesystem::FileTree& sourceTree,
         }
 
         if (node.isDirectory()) {
-            out << "D|"
-                << relPath
-                << "|0|0\n";
+            writer.add(relPath, true, 0, 0,
+                       node.getDevice(), node.getInode(), node.getHash());
         } else {
-            out << "F|"
-                << relPath
-                << "|"
-                << node.getSize()
-                << "|"
-                << util::fileTimeToInt64(node.getMTime())
-                << "\n";
+            writer.add(relPath, false, node.getSize(),
+                       util::fileTimeToInt64(node.getMTime()),
+                       node.getDevice(), node.getInode(), node.getHash());
         }
     });
 
-    out.flush();
-    if (!out.good()) {
-        throw std::runtime_error("Failed to write metadata file");
+    writer.commit();
+}
+
+void BackupMetadata::writeMetadata(const filesystem::CompactFileTree& sourceTree,
+                                   const std::filesystem::path& backupRoot,
+                                   const std::string& compressionType,
+                                   const std::string& encryptionType,
+                                   const std::string& storageType) {
+    BackupMetadataWriter writer(backupRoot, sourceTree.getRootPath(),
+                                compressionType, encryptionType,
+                                sourceTree.empty() ? 0 : sourceTree.node(sourceTree.root()).hash,
+                                storageType);
+
+    sourceTree.traverseDFS([&](filesystem::CompactFileTree::Index i) {
+        // skip root
+        if (i == sourceTree.root()) {
+            return;
+        }
+
+        const auto& node = sourceTree.node(i);
+        if (node.isDirectory()) {
+            writer.add(sourceTree.relativePath(i), true, 0, 0, 0, 0, node.hash);
+        } else {
+            writer.add(sourceTree.relativePath(i), false, node.size, node.mtimeNs);
+        }
+    });
+
+    writer.commit();
+}
+
+void BackupMetadata::writeMetadata(filesystem::TreeWalker& walker,
+                                   const std::filesystem::path& backupRoot,
+                                   const std::string& compressionType,
+                                   const std::string& encryptionType,
+                                   const std::string& storageType) {
+    BackupMetadataWriter writer(backupRoot, walker.getRootPath(),
+                                compressionType, encryptionType, 0, storageType);
+    for (const auto& entry : walker) {
+        writer.add(entry);
     }
+    writer.commit();
 }
 
 BackupMetadataInfo BackupMetadata::readMetadata(const std::filesystem::path& backupRoot) {
-    const auto metaPath = backupRoot / ".backupmeta";
-    std::ifstream in(metaPath);
-    if (!in.is_open()) {
-        throw std::runtime_error("Failed to open metadata file for reading");
+    BackupMetadataReader reader(backupRoot);
+    BackupMetadataInfo info = reader.header();
+
+    BackupFileEntry entry;
+    while (reader.next(entry)) {
+        info.files.push_back(std::move(entry));
     }
+    return info;
+}
 
-    BackupMetadataInfo info;
-    std::string line;
+std::unique_ptr<filesystem::FileTree>
+BackupMetadata::buildTree(const BackupMetadataInfo& info,
+                          const std::filesystem::path& rootPath) {
+    using filesystem::FileNode;
+    using filesystem::FileType;
 
-    enum class Section { None, FileList };
-    Section currentSection = Section::None;
+    auto root = std::make_shared<FileNode>(
+        rootPath.filename().string(), ".", FileType::Directory);
+    root->setHash(info.rootHash);
 
-    while (std::getline(in, line)) {
-        if (line.empty()) continue;
+    // 条目按 DFS 顺序写入，父目录总在子项之前出现
+    std::unordered_map<std::string, std::shared_ptr<FileNode>> dirs;
+    dirs.emplace(".", root);
 
-        // section header
-        if (line == "[filelist]") {
-            currentSection = Section::FileList;
-            continue;
+    for (const auto& entry : info.files) {
+        const auto slash = entry.relativePath.rfind('/');
+        const std::string parentPath =
+            slash == std::string::npos ? "." : entry.relativePath.substr(0, slash);
+        const std::string name =
+            slash == std::string::npos ? entry.relativePath : entry.relativePath.substr(slash + 1);
+
+        auto parent = dirs.find(parentPath);
+        if (parent == dirs.end()) {
+            continue; // 父目录缺失的条目视为损坏，跳过
         }
 
-        if (currentSection == Section::None) {
-            // key=value
-            auto pos = line.find('=');
-            if (pos == std::string::npos) continue;
-
-            std::string key = line.substr(0, pos);
-            std::string value = line.substr(pos + 1);
-
-            if (key == "tool") {
-                info.tool = value;
-            } else if (key == "created") {
-                info.createdUTC = value;
-            } else if (key == "source_root") {
-                info.sourceRoot = value;
-            } else if (key == "compression") {
-                info.compressionType = value;
-            } else if (key == "encryption") {
-                info.encryptionType = value;
-            }
-        } else if (currentSection == Section::FileList) {
-            // parse file entry
-            // format: F|relPath|size|mtime or D|relPath|0|0
-            std::istringstream ss(line);
-            std::string token;
-            std::vector<std::string> parts;
-            while (std::getline(ss, token, '|')) {
-                parts.push_back(token);
-            }
-            if (parts.size() != 4) continue;
-
-            BackupFileEntry entry;
-            entry.isDirectory = (parts[0] == "D");
-            entry.relativePath = parts[1];
-            entry.size = std::stoull(parts[2]);
-            entry.mtimeNs = std::stoll(parts[3]);
-            info.files.push_back(std::move(entry));
+        std::shared_ptr<FileNode> node;
+        if (entry.isDirectory) {
+            node = std::make_shared<FileNode>(name, entry.relativePath, FileType::Directory);
+            dirs.emplace(entry.relativePath, node);
+        } else {
+            node = std::make_shared<FileNode>(
+                name, entry.relativePath, FileType::File,
+                entry.size, util::int64ToFileTime(entry.mtimeNs));
         }
+        node->setIdentity(entry.dev, entry.ino);
+        node->setHash(entry.hash);
+        parent->second->addChild(std::move(node));
     }
 
-    return info;
+    // 旧版本元数据未排序，这里统一按名称排序，与扫描结果保持一致
+    for (auto& kv : dirs) {
+        kv.second->sortChildren();
+    }
 
+    auto tree = std::make_unique<filesystem::FileTree>(rootPath);
+    tree->setRoot(std::move(root));
+    return tree;
 }
 
 } // namespace backup::core
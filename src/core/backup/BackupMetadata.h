@@ -1,7 +1,11 @@
 #pragma once
 
 #include <filesystem>
+#include <fstream>
+#include <memory>
 #include "filesystem/FileTree.h"
+#include "filesystem/CompactFileTree.h"
+#include "filesystem/TreeWalker.h"
 
 
 namespace backup::core{
@@ -11,6 +15,11 @@ struct BackupFileEntry {
     bool isDirectory;
     uintmax_t size = 0;
     int64_t mtimeNs = 0;
+    // 可选字段（旧版本元数据中为 0）：扫描时的设备号/inode，
+    // 文件为内容指纹，目录为子树哈希
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    uint64_t hash = 0;
 };
 
 struct BackupMetadataInfo {
@@ -19,18 +28,82 @@ struct BackupMetadataInfo {
     std::filesystem::path sourceRoot;
     std::string compressionType;  // 压缩算法类型
     std::string encryptionType;   // 加密算法类型
+    std::string storageType = "files"; // 存储方式：files（逐文件）或 chunks（去重块存储）
+    uint64_t rootHash = 0;        // 根目录子树哈希，0 表示未记录
     std::vector<BackupFileEntry> files;
 };
 
 
+// 逐条写入 .backupmeta：先写到 .backupmeta.tmp，commit() 时整体替换；
+// 未 commit 即析构则删除临时文件，原有元数据保持不变
+class BackupMetadataWriter {
+public:
+    BackupMetadataWriter(const std::filesystem::path& backupRoot,
+                         const std::filesystem::path& sourceRoot,
+                         const std::string& compressionType,
+                         const std::string& encryptionType,
+                         uint64_t rootHash = 0,
+                         const std::string& storageType = "files");
+    ~BackupMetadataWriter();
+
+    BackupMetadataWriter(const BackupMetadataWriter&) = delete;
+    BackupMetadataWriter& operator=(const BackupMetadataWriter&) = delete;
+
+    void add(const std::string& relPath, bool isDirectory,
+             uintmax_t size, int64_t mtimeNs,
+             uint64_t dev = 0, uint64_t ino = 0, uint64_t hash = 0);
+    void add(const filesystem::WalkEntry& entry);
+
+    void commit();
+
+private:
+    std::filesystem::path tempPath_;
+    std::filesystem::path finalPath_;
+    std::ofstream out_;
+    bool committed_ = false;
+};
+
+// 逐条读取 .backupmeta，内存占用与条目数无关；header() 中 files 为空
+class BackupMetadataReader {
+public:
+    explicit BackupMetadataReader(const std::filesystem::path& backupRoot);
+
+    const BackupMetadataInfo& header() const noexcept;
+    bool next(BackupFileEntry& entry);
+
+private:
+    std::ifstream in_;
+    BackupMetadataInfo header_;
+};
+
 class BackupMetadata {
 public:
     static void writeMetadata(const filesystem::FileTree& sourceTree, 
                              const std::filesystem::path& backupRoot,
                              const std::string& compressionType = "none",
-                             const std::string& encryptionType = "none");
+                             const std::string& encryptionType = "none",
+                             const std::string& storageType = "files");
+
+    // 与上面输出完全一致，供扁平树使用
+    static void writeMetadata(const filesystem::CompactFileTree& sourceTree,
+                             const std::filesystem::path& backupRoot,
+                             const std::string& compressionType = "none",
+                             const std::string& encryptionType = "none",
+                             const std::string& storageType = "files");
+
+    // 流式写入，不构建目录树；不含子树哈希
+    static void writeMetadata(filesystem::TreeWalker& walker,
+                             const std::filesystem::path& backupRoot,
+                             const std::string& compressionType = "none",
+                             const std::string& encryptionType = "none",
+                             const std::string& storageType = "files");
 
     static BackupMetadataInfo readMetadata(const std::filesystem::path& backupRoot);
 
+    // 由元数据重建上次备份时的源目录树（记录的是源文件大小与 mtime），
+    // rootPath 仅作为树的根路径，不会被扫描
+    static std::unique_ptr<filesystem::FileTree>
+    buildTree(const BackupMetadataInfo& info, const std::filesystem::path& rootPath);
+
 };
 } // namespace backup::core
\ No newline at end of file
@@ -0,0 +1,360 @@
+#include "ChunkStore.h"
+#include "compression/BlockFormat.h"
+#include "util/ByteSink.h"
+#include "util/FileCopy.h"
+#include "util/Hash.h"
+#include "util/Pipeline.h"
+
+#include <openssl/evp.h>
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace backup::core
+{
+
+    namespace
+    {
+        constexpr const char *kManifestMagic = "SDCHUNKS1";
+        constexpr size_t kIdLength = 64; // SHA-256 的十六进制
+
+        size_t windowFor(unsigned threads)
+        {
+            return 2 * static_cast<size_t>(std::max(1u, threads)) + 2;
+        }
+
+        std::string toHex(const uint8_t *data, size_t size)
+        {
+            static const char digits[] = "0123456789abcdef";
+            std::string hex(size * 2, '0');
+            for (size_t i = 0; i < size; ++i)
+            {
+                hex[2 * i] = digits[data[i] >> 4];
+                hex[2 * i + 1] = digits[data[i] & 0x0f];
+            }
+            return hex;
+        }
+
+        bool isChunkId(const std::string &id)
+        {
+            return id.size() == kIdLength &&
+                   std::all_of(id.begin(), id.end(), [](char c)
+                               { return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'); });
+        }
+    }
+
+    ChunkStore::ChunkStore(const fs::path &backupRoot, Options options)
+        : root_(backupRoot / kDirectory),
+          options_(std::move(options)),
+          chunker_(options_.chunking)
+    {
+        if (options_.encrypt && options_.encryptionKey.empty())
+        {
+            throw std::invalid_argument("加密的块存储需要密钥");
+        }
+        if (options_.compress)
+        {
+            format_ += "c" + std::to_string(static_cast<int>(options_.compressionType));
+        }
+        if (options_.encrypt)
+        {
+            format_ += "e" + std::to_string(static_cast<int>(options_.encryptionType));
+        }
+    }
+
+    std::string ChunkStore::chunkId(const uint8_t *data, size_t size) const
+    {
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+        uint8_t digest[EVP_MAX_MD_SIZE];
+        unsigned length = 0;
+        if (!ctx ||
+            EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1 ||
+            (!format_.empty() &&
+             EVP_DigestUpdate(ctx.get(), format_.data(), format_.size()) != 1) ||
+            (options_.encrypt &&
+             EVP_DigestUpdate(ctx.get(), options_.encryptionKey.data(), options_.encryptionKey.size()) != 1) ||
+            EVP_DigestUpdate(ctx.get(), data, size) != 1 ||
+            EVP_DigestFinal_ex(ctx.get(), digest, &length) != 1)
+        {
+            throw std::runtime_error("SHA-256 计算失败");
+        }
+        return toHex(digest, length);
+    }
+
+    fs::path ChunkStore::chunkPath(const std::string &id) const
+    {
+        return root_ / id.substr(0, 2) / id;
+    }
+
+    ChunkStore::ChunkRef ChunkStore::putChunk(const std::vector<uint8_t> &data)
+    {
+        ChunkRef ref{chunkId(data.data(), data.size()), static_cast<uint32_t>(data.size())};
+        ++chunks_;
+
+        std::vector<uint8_t> stored = options_.compress
+                                          ? compression::compressBuffer(options_.compressionType, data)
+                                          : data;
+        if (options_.encrypt)
+        {
+            auto encryptor = encryption::createEncryptor(options_.encryptionType);
+            encryptor->setKey(options_.encryptionKey);
+            std::vector<uint8_t> cipherText;
+            util::BufferSink sink(cipherText);
+            auto cipher = encryptor->encryptTo(sink);
+            cipher->write(stored.data(), stored.size());
+            cipher->finish();
+            stored = std::move(cipherText);
+        }
+
+        // 压缩与加密都是确定的：已有的块长度相同才沿用，长度不符（如断电后写了一半）时重写
+        const fs::path path = chunkPath(ref.id);
+        std::error_code ec;
+        if (fs::file_size(path, ec) == stored.size() && !ec)
+        {
+            return ref;
+        }
+
+        // 同一个块可能被多个线程同时写入：各自写临时文件，改名是原子的，内容相同
+        // 改名前先让数据落盘，改名后同步所在目录，断电后不会留下名字正确而内容不完整的块
+        fs::create_directories(path.parent_path());
+        const fs::path temp = path.string() + ".tmp" + std::to_string(tempCounter_++);
+        try
+        {
+            util::FileSink file(temp);
+            file.write(stored.data(), stored.size());
+            file.finish();
+            util::syncToDisk(temp);
+            fs::rename(temp, path);
+            util::syncToDisk(path.parent_path());
+        }
+        catch (...)
+        {
+            fs::remove(temp, ec);
+            throw;
+        }
+
+        ++newChunks_;
+        storedBytes_ += stored.size();
+        return ref;
+    }
+
+    std::vector<uint8_t> ChunkStore::getChunk(const ChunkRef &ref) const
+    {
+        std::vector<uint8_t> data = util::readWholeFile(chunkPath(ref.id));
+        if (options_.encrypt)
+        {
+            auto decryptor = encryption::createEncryptor(options_.encryptionType);
+            decryptor->setKey(options_.encryptionKey);
+            std::vector<uint8_t> plain;
+            util::BufferSink sink(plain);
+            auto cipher = decryptor->decryptTo(sink);
+            cipher->write(data.data(), data.size());
+            cipher->finish();
+            data = std::move(plain);
+        }
+        if (options_.compress)
+        {
+            data = compression::decompressBuffer(options_.compressionType, data);
+        }
+
+        if (data.size() != ref.size || chunkId(data.data(), data.size()) != ref.id)
+        {
+            throw std::runtime_error("块已损坏: " + ref.id);
+        }
+        return data;
+    }
+
+    // 清单格式：首行魔数，每块一行 "<ID> <长度>"，末行 "end <文件大小>"（用于发现截断）
+    uint64_t ChunkStore::storeFile(const fs::path &source, const fs::path &manifest)
+    {
+        std::ifstream input(source, std::ios::binary);
+        if (!input.is_open())
+        {
+            throw std::runtime_error("无法打开源文件: " + source.string());
+        }
+
+        try
+        {
+            std::ofstream out(manifest, std::ios::trunc);
+            if (!out.is_open())
+            {
+                throw std::runtime_error("无法写入清单: " + manifest.string());
+            }
+            out << kManifestMagic << "\n";
+
+            uint64_t total = 0;
+            util::XxHash64 hash;
+            const size_t maxSize = chunker_.options().maxSize;
+            util::runOrderedPipeline<std::vector<uint8_t>, ChunkRef>(
+                options_.threads, windowFor(options_.threads),
+                [&](const std::function<void(std::vector<uint8_t>)> &emit)
+                {
+                    // 缓冲区中至少保留 maxSize 字节（文件末尾除外），切点与整体读取时一致
+                    std::vector<uint8_t> buffer(2 * maxSize);
+                    size_t begin = 0;
+                    size_t end = 0;
+                    bool eof = false;
+                    for (;;)
+                    {
+                        if (!eof && end - begin < maxSize)
+                        {
+                            std::copy(buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+                            end -= begin;
+                            begin = 0;
+                            input.read(reinterpret_cast<char *>(buffer.data() + end),
+                                       static_cast<std::streamsize>(buffer.size() - end));
+                            end += static_cast<size_t>(input.gcount());
+                            if (input.bad())
+                            {
+                                throw std::runtime_error("读取源文件失败: " + source.string());
+                            }
+                            eof = input.eof();
+                        }
+                        if (begin == end)
+                        {
+                            break;
+                        }
+                        const size_t length = chunker_.cut(buffer.data() + begin, end - begin);
+                        hash.update(buffer.data() + begin, length);
+                        emit(std::vector<uint8_t>(buffer.begin() + begin, buffer.begin() + begin + length));
+                        begin += length;
+                    }
+                },
+                [this](std::vector<uint8_t> &data)
+                { return putChunk(data); },
+                [&](ChunkRef &ref)
+                {
+                    out << ref.id << " " << ref.size << "\n";
+                    total += ref.size;
+                });
+
+            out << "end " << total << "\n";
+            out.close();
+            if (!out)
+            {
+                throw std::runtime_error("写入清单失败: " + manifest.string());
+            }
+            return util::fingerprintOf(hash);
+        }
+        catch (...)
+        {
+            std::error_code ec;
+            fs::remove(manifest, ec);
+            throw;
+        }
+    }
+
+    std::vector<ChunkStore::ChunkRef> ChunkStore::readManifest(const fs::path &manifest)
+    {
+        std::ifstream in(manifest);
+        std::string line;
+        if (!in.is_open() || !std::getline(in, line) || line != kManifestMagic)
+        {
+            throw std::runtime_error("不是块清单: " + manifest.string());
+        }
+
+        std::vector<ChunkRef> refs;
+        uint64_t total = 0;
+        while (std::getline(in, line))
+        {
+            std::istringstream ss(line);
+            std::string id;
+            uint64_t size = 0;
+            if (!(ss >> id >> size))
+            {
+                break;
+            }
+            if (id == "end")
+            {
+                if (size != total)
+                {
+                    break;
+                }
+                return refs;
+            }
+            if (!isChunkId(id) || size == 0 || size > UINT32_MAX)
+            {
+                break;
+            }
+            refs.push_back({std::move(id), static_cast<uint32_t>(size)});
+            total += size;
+        }
+        throw std::runtime_error("块清单已损坏: " + manifest.string());
+    }
+
+    void ChunkStore::loadFile(const fs::path &manifest, const fs::path &target) const
+    {
+        const std::vector<ChunkRef> refs = readManifest(manifest);
+        try
+        {
+            util::FileSink file(target);
+            util::runOrderedPipeline<const ChunkRef *, std::vector<uint8_t>>(
+                options_.threads, windowFor(options_.threads),
+                [&refs](const std::function<void(const ChunkRef *)> &emit)
+                {
+                    for (const auto &ref : refs)
+                    {
+                        emit(&ref);
+                    }
+                },
+                [this](const ChunkRef *&ref)
+                { return getChunk(*ref); },
+                [&file](std::vector<uint8_t> &data)
+                { file.write(data.data(), data.size()); });
+            file.finish();
+        }
+        catch (...)
+        {
+            std::error_code ec;
+            fs::remove(target, ec);
+            throw;
+        }
+    }
+
+    size_t ChunkStore::sweep(const std::unordered_set<std::string> &live) const
+    {
+        size_t removed = 0;
+        std::error_code ec;
+        if (!fs::is_directory(root_, ec))
+        {
+            return 0;
+        }
+        for (const auto &bucket : fs::directory_iterator(root_))
+        {
+            if (!bucket.is_directory())
+            {
+                continue;
+            }
+            for (const auto &entry : fs::directory_iterator(bucket.path()))
+            {
+                const std::string name = entry.path().filename().string();
+                if (isChunkId(name) && live.count(name))
+                {
+                    continue;
+                }
+                // 未被引用的块，或中断的写入留下的临时文件
+                if (fs::remove(entry.path(), ec) && isChunkId(name))
+                {
+                    ++removed;
+                }
+            }
+        }
+        return removed;
+    }
+
+    ChunkStore::Stats ChunkStore::stats() const
+    {
+        return {chunks_.load(), newChunks_.load(), storedBytes_.load()};
+    }
+
+    void ChunkStore::resetStats()
+    {
+        chunks_ = 0;
+        newChunks_ = 0;
+        storedBytes_ = 0;
+    }
+
+} // namespace backup::core
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "compression/Compression.h"
+#include "encryption/Encryption.h"
+#include "util/Chunker.h"
+
+namespace backup::core
+{
+
+    namespace fs = std::filesystem;
+
+    /*
+     * ChunkStore: 内容寻址的去重块存储
+     *  - 文件按内容定义分块（util::Chunker），相同内容的块只保存一次，
+     *    位于 <backupRoot>/.chunks/<ID 前两位>/<ID>
+     *  - 块 ID 为明文的 SHA-256；压缩/加密时先混入存储格式，格式变化后写入新块而不会沿用旧格式的块；
+     *    加密时再混入密钥，ID 不会暴露内容的哈希
+     *  - 每块单独压缩（单块的 SDBLOCK1 容器）、单独加密，写入时先写临时文件再改名
+     *  - 备份目录中与源文件同路径的位置保存清单：文件大小与有序的块列表
+     */
+    class ChunkStore
+    {
+    public:
+        struct Options
+        {
+            bool compress = false;
+            compression::CompressionType compressionType = compression::CompressionType::Lz77;
+            bool encrypt = false;
+            encryption::EncryptionType encryptionType = encryption::EncryptionType::AES;
+            std::string encryptionKey;
+            unsigned threads = 1; // 单个文件内并行哈希、压缩、加密各块的线程数
+            util::ChunkerOptions chunking;
+        };
+
+        struct ChunkRef
+        {
+            std::string id;
+            uint32_t size = 0; // 明文长度
+        };
+
+        struct Stats
+        {
+            uint64_t chunks = 0;      // 写入清单的块数
+            uint64_t newChunks = 0;   // 其中此前不存在、实际写入的块数
+            uint64_t storedBytes = 0; // 新块写入的字节数（压缩/加密后）
+        };
+
+        ChunkStore(const fs::path &backupRoot, Options options);
+
+        // 切分 source，写入尚未保存的块，再把清单写到 manifest；失败时抛出异常并删除 manifest。
+        // 返回 source 的内容指纹（同 util::fingerprintFile）
+        uint64_t storeFile(const fs::path &source, const fs::path &manifest);
+
+        // 按清单依次读取、解密、解压并校验各块，写入 target；失败时抛出异常并删除 target
+        void loadFile(const fs::path &manifest, const fs::path &target) const;
+
+        // 读取清单；格式不对时抛出 std::runtime_error
+        static std::vector<ChunkRef> readManifest(const fs::path &manifest);
+
+        // 删除不在 live 中的块与残留的临时文件，返回删除的块数
+        size_t sweep(const std::unordered_set<std::string> &live) const;
+
+        Stats stats() const;
+        void resetStats();
+
+        static constexpr const char *kDirectory = ".chunks";
+
+    private:
+        fs::path root_;
+        Options options_;
+        util::Chunker chunker_;
+        std::string format_; // 混入块 ID 的存储格式，不压缩不加密时为空
+
+        std::atomic<uint64_t> chunks_{0};
+        std::atomic<uint64_t> newChunks_{0};
+        std::atomic<uint64_t> storedBytes_{0};
+        std::atomic<uint64_t> tempCounter_{0};
+
+        std::string chunkId(const uint8_t *data, size_t size) const;
+        fs::path chunkPath(const std::string &id) const;
+
+        // 写入一个块（已存在时跳过），返回其引用
+        ChunkRef putChunk(const std::vector<uint8_t> &data);
+        std::vector<uint8_t> getChunk(const ChunkRef &ref) const;
+    };
+
+} // namespace backup::core
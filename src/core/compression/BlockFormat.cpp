@@ -0,0 +1,306 @@
+#include "BlockFormat.h"
+#include "Huffman.h"
+#include "LZ77.h"
+#include "util/Pipeline.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+namespace backup::core::compression
+{
+    namespace
+    {
+        constexpr char kMagic[8] = {'S', 'D', 'B', 'L', 'O', 'C', 'K', '1'};
+        constexpr size_t kHeaderSize = 9;
+        constexpr uint8_t kStored = 1;
+        constexpr uint8_t kLz77V2 = 2; // LZ77 块为版本 2 的流格式，没有此标志的是旧的三字节记号
+
+        struct Block
+        {
+            std::vector<uint8_t> data;
+            uint32_t rawSize = 0;
+            bool stored = false;
+            bool lz77v2 = false;
+            bool legacy = false; // 旧版整文件格式，data 为完整的存储内容
+        };
+
+        void putU32(uint8_t *out, uint32_t value)
+        {
+            for (int i = 0; i < 4; ++i)
+                out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+
+        uint32_t getU32(const uint8_t *in)
+        {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i)
+                value |= static_cast<uint32_t>(in[i]) << (8 * i);
+            return value;
+        }
+
+        std::vector<uint8_t> encodeBlock(CompressionType type, const std::vector<uint8_t> &data)
+        {
+            if (type == CompressionType::Huffman)
+                return Huffman().compress(data);
+            return LZ77().compressV2(data);
+        }
+
+        // 旧版本的整文件格式：[size_t 原始大小][算法输出]；
+        // LZ77 另有一种以魔数 "SDLZ77V2" 开头、算法输出为版本 2 流格式的，原始大小的最高字节不可能是 '2'
+        constexpr char kLz77V2Magic[8] = {'S', 'D', 'L', 'Z', '7', '7', 'V', '2'};
+
+        std::vector<uint8_t> decodeWholeFile(CompressionType type, const std::vector<uint8_t> &stored)
+        {
+            const bool v2 = type == CompressionType::Lz77 && stored.size() >= sizeof(kLz77V2Magic) &&
+                            std::memcmp(stored.data(), kLz77V2Magic, sizeof(kLz77V2Magic)) == 0;
+            const size_t offset = v2 ? sizeof(kLz77V2Magic) : 0;
+            size_t originalSize = 0;
+            if (stored.size() < offset + sizeof(originalSize))
+                throw std::runtime_error("Compressed data is truncated");
+            std::memcpy(&originalSize, stored.data() + offset, sizeof(originalSize));
+            const std::vector<uint8_t> data(stored.begin() + offset + sizeof(originalSize), stored.end());
+            if (type == CompressionType::Huffman)
+                return Huffman().decompress(data, originalSize);
+            if (v2)
+                return LZ77::decompressV2(data, originalSize);
+            return LZ77().decompress(data, originalSize);
+        }
+
+        std::vector<uint8_t> decodeBlock(CompressionType type, const Block &block)
+        {
+            if (type == CompressionType::Huffman)
+                return Huffman().decompress(block.data, block.rawSize);
+            if (block.lz77v2)
+                return LZ77::decompressV2(block.data, block.rawSize);
+            return LZ77().decompress(block.data, block.rawSize);
+        }
+
+        // 压缩后不变小的块原样存储
+        Block packBlock(CompressionType type, std::vector<uint8_t> &data)
+        {
+            Block block;
+            block.rawSize = static_cast<uint32_t>(data.size());
+            block.data = encodeBlock(type, data);
+            block.lz77v2 = type == CompressionType::Lz77;
+            if (block.data.size() >= data.size())
+            {
+                block.data = std::move(data);
+                block.stored = true;
+                block.lz77v2 = false;
+            }
+            return block;
+        }
+
+        std::vector<uint8_t> unpackBlock(CompressionType type, Block &block)
+        {
+            if (block.legacy)
+                return decodeWholeFile(type, block.data);
+            if (block.stored)
+            {
+                if (block.data.size() != block.rawSize)
+                    throw std::runtime_error("Corrupt compressed block");
+                return std::move(block.data);
+            }
+            if (block.lz77v2 && type != CompressionType::Lz77)
+                throw std::runtime_error("Corrupt compressed block");
+            std::vector<uint8_t> data = decodeBlock(type, block);
+            if (data.size() != block.rawSize)
+                throw std::runtime_error("Corrupt compressed block");
+            return data;
+        }
+
+        void writeBlock(const Block &block, util::ByteSink &output)
+        {
+            uint8_t header[kHeaderSize];
+            putU32(header, block.rawSize);
+            putU32(header + 4, static_cast<uint32_t>(block.data.size()));
+            header[8] = static_cast<uint8_t>((block.stored ? kStored : 0) | (block.lz77v2 ? kLz77V2 : 0));
+            output.write(header, sizeof(header));
+            output.write(block.data.data(), block.data.size());
+        }
+
+        size_t windowFor(const BlockOptions &options)
+        {
+            return 2 * static_cast<size_t>(std::max(1u, options.threads)) + 2;
+        }
+
+        // 把写入的字节切分成块交给 emit；开头不是魔数时按旧格式整体缓存
+        class BlockParser : public util::ByteSink
+        {
+        public:
+            explicit BlockParser(const std::function<void(Block)> &emit) : emit_(emit) {}
+
+            void write(const uint8_t *data, size_t size) override
+            {
+                buffer_.insert(buffer_.end(), data, data + size);
+                if (state_ == State::Magic && buffer_.size() >= sizeof(kMagic))
+                {
+                    if (std::memcmp(buffer_.data(), kMagic, sizeof(kMagic)) != 0)
+                    {
+                        state_ = State::Legacy;
+                        return;
+                    }
+                    buffer_.erase(buffer_.begin(), buffer_.begin() + sizeof(kMagic));
+                    state_ = State::Blocks;
+                }
+                if (state_ == State::Blocks)
+                    parse();
+                else if (state_ == State::End && !buffer_.empty())
+                    throw std::runtime_error("Unexpected data after the last block");
+            }
+
+            void finish() override
+            {
+                if (state_ == State::Magic || state_ == State::Legacy)
+                {
+                    Block block;
+                    block.legacy = true;
+                    block.data = std::move(buffer_);
+                    buffer_.clear();
+                    state_ = State::End;
+                    emit_(std::move(block));
+                }
+                if (state_ != State::End)
+                    throw std::runtime_error("Compressed data is truncated");
+            }
+
+        private:
+            enum class State
+            {
+                Magic,
+                Blocks,
+                Legacy,
+                End
+            };
+
+            const std::function<void(Block)> &emit_;
+            std::vector<uint8_t> buffer_;
+            size_t offset_ = 0;
+            State state_ = State::Magic;
+
+            void parse()
+            {
+                while (buffer_.size() - offset_ >= kHeaderSize)
+                {
+                    const uint8_t *header = buffer_.data() + offset_;
+                    const uint32_t rawSize = getU32(header);
+                    const uint32_t storedSize = getU32(header + 4);
+                    if (rawSize == 0)
+                    {
+                        offset_ += kHeaderSize;
+                        state_ = State::End;
+                        if (offset_ != buffer_.size())
+                            throw std::runtime_error("Unexpected data after the last block");
+                        buffer_.clear();
+                        offset_ = 0;
+                        return;
+                    }
+                    if (buffer_.size() - offset_ < kHeaderSize + storedSize)
+                        break;
+
+                    Block block;
+                    block.rawSize = rawSize;
+                    block.stored = (header[8] & kStored) != 0;
+                    block.lz77v2 = (header[8] & kLz77V2) != 0;
+                    const uint8_t *payload = header + kHeaderSize;
+                    block.data.assign(payload, payload + storedSize);
+                    offset_ += kHeaderSize + storedSize;
+                    emit_(std::move(block));
+                }
+                // 丢弃已解析的部分，缓冲区不超过一个块
+                buffer_.erase(buffer_.begin(), buffer_.begin() + offset_);
+                offset_ = 0;
+            }
+        };
+    }
+
+    void compressBlocks(CompressionType type, const std::filesystem::path &inputPath,
+                        util::ByteSink &output, const BlockOptions &options)
+    {
+        std::ifstream input(inputPath, std::ios::binary);
+        if (!input.is_open())
+        {
+            throw std::runtime_error("Failed to open input file: " + inputPath.string());
+        }
+        const size_t blockSize = std::clamp<size_t>(options.blockSize, 1, UINT32_MAX);
+
+        output.write(reinterpret_cast<const uint8_t *>(kMagic), sizeof(kMagic));
+        util::runOrderedPipeline<std::vector<uint8_t>, Block>(
+            options.threads, windowFor(options),
+            [&](const std::function<void(std::vector<uint8_t>)> &emit)
+            {
+                for (;;)
+                {
+                    std::vector<uint8_t> data(blockSize);
+                    input.read(reinterpret_cast<char *>(data.data()), static_cast<std::streamsize>(blockSize));
+                    data.resize(static_cast<size_t>(input.gcount()));
+                    if (data.empty())
+                        break;
+                    if (options.inputHash)
+                        options.inputHash->update(data.data(), data.size());
+                    emit(std::move(data));
+                }
+                if (input.bad())
+                    throw std::runtime_error("Failed to read input file: " + inputPath.string());
+            },
+            [type](std::vector<uint8_t> &data)
+            { return packBlock(type, data); },
+            [&output](Block &block)
+            { writeBlock(block, output); });
+
+        const uint8_t end[kHeaderSize] = {};
+        output.write(end, sizeof(end));
+    }
+
+    void decompressBlocks(CompressionType type,
+                          const std::function<void(util::ByteSink &)> &feed,
+                          util::ByteSink &output, const BlockOptions &options)
+    {
+        util::runOrderedPipeline<Block, std::vector<uint8_t>>(
+            options.threads, windowFor(options),
+            [&feed](const std::function<void(Block)> &emit)
+            {
+                BlockParser parser(emit);
+                feed(parser);
+                parser.finish();
+            },
+            [type](Block &block)
+            { return unpackBlock(type, block); },
+            [&output](std::vector<uint8_t> &data)
+            {
+                output.write(data.data(), data.size());
+            });
+    }
+
+    std::vector<uint8_t> compressBuffer(CompressionType type, const std::vector<uint8_t> &data)
+    {
+        if (data.size() > UINT32_MAX)
+            throw std::invalid_argument("Buffer too large for a single block");
+
+        std::vector<uint8_t> out(kMagic, kMagic + sizeof(kMagic));
+        util::BufferSink sink(out);
+        if (!data.empty())
+        {
+            std::vector<uint8_t> copy = data;
+            writeBlock(packBlock(type, copy), sink);
+        }
+        const uint8_t end[kHeaderSize] = {};
+        sink.write(end, sizeof(end));
+        return out;
+    }
+
+    std::vector<uint8_t> decompressBuffer(CompressionType type, const std::vector<uint8_t> &stored)
+    {
+        std::vector<uint8_t> out;
+        const std::function<void(Block)> emit = [&](Block block)
+        {
+            const std::vector<uint8_t> data = unpackBlock(type, block);
+            out.insert(out.end(), data.begin(), data.end());
+        };
+        BlockParser parser(emit);
+        parser.write(stored.data(), stored.size());
+        parser.finish();
+        return out;
+    }
+}
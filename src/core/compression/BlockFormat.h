@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+#include "Compression.h"
+#include "util/ByteSink.h"
+#include "util/Hash.h"
+namespace backup::core::compression
+{
+    // 分块容器：8 字节魔数 "SDBLOCK1"，随后每块一个 9 字节头
+    // [u32 原始长度][u32 存储长度][u8 标志] 加存储数据，原始长度为 0 的块表示结束。
+    // 各块独立压缩（压缩后不变小则原样存储，标志为 1），因此可以并行处理，内存只与块大小有关。
+    // LZ77 块的标志带 2 时为版本 2 的流格式（LZ77::compressV2），不带的是旧版本写入的块。
+    // 旧版本的整文件格式以 8 字节原始大小开头，其最高字节不可能是 '1'，据此区分
+    constexpr size_t kDefaultBlockSize = 1 << 20;
+
+    struct BlockOptions
+    {
+        size_t blockSize = kDefaultBlockSize;
+        unsigned threads = 1; // 并行压缩/解压的线程数，另有一个读取线程
+        util::XxHash64 *inputHash = nullptr; // 非空时压缩的读取线程顺带对原始内容求哈希
+    };
+
+    // 读取 inputPath，按块并行压缩并按顺序写入 output（不调用 output.finish()）
+    void compressBlocks(CompressionType type, const std::filesystem::path &inputPath,
+                        util::ByteSink &output, const BlockOptions &options = {});
+
+    // feed 在读取线程中把存储的内容（分块容器或旧版整文件格式）写入给定的 sink，
+    // 解压结果按顺序写入 output（不调用 output.finish()）
+    void decompressBlocks(CompressionType type,
+                          const std::function<void(util::ByteSink &)> &feed,
+                          util::ByteSink &output, const BlockOptions &options = {});
+
+    // 内存中的整段数据压缩为只含一块的分块容器（不启动线程），供按块保存的场景使用；
+    // data 不能超过 4 GiB
+    std::vector<uint8_t> compressBuffer(CompressionType type, const std::vector<uint8_t> &data);
+
+    // 解压 compressBuffer() 的输出（也接受多块的容器），在调用线程中完成
+    std::vector<uint8_t> decompressBuffer(CompressionType type, const std::vector<uint8_t> &stored);
+}
@@ -1,136 +1,71 @@
 #include "Compression.h"
-#include "Huffman.h"
-#include "LZ77.h"
-#include <fstream>
+#include "BlockFormat.h"
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 namespace backup::core::compression
 {
-    class HuffmanCompression : public Compression
+    namespace
     {
-    public:
-        void compress(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override
+        // 两种算法共用分块容器（见 BlockFormat.h）：按块流式处理，内存只与块大小有关，与文件大小无关
+        class BlockCompression : public Compression
         {
-            std::ifstream input(inputPath, std::ios::binary);
-            if (!input.is_open())
+        public:
+            void compress(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override
             {
-                throw std::runtime_error("Failed to open input file: " + inputPath.string());
+                util::FileSink output(outputPath);
+                compressBlocks(getType(), inputPath, output, options_);
+                output.finish();
             }
-            input.seekg(0, std::ios::end);
-            size_t fileSize = input.tellg();
-            input.seekg(0, std::ios::beg);
-            std::vector<uint8_t> data(fileSize);
-            input.read(reinterpret_cast<char *>(data.data()), fileSize);
-            input.close();
-            Huffman huffman;
-            std::vector<uint8_t> compressedData = huffman.compress(data);
-            std::ofstream output(outputPath, std::ios::binary);
-            if (!output.is_open())
+            void decompress(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override
             {
-                throw std::runtime_error("Failed to open output file: " + outputPath.string());
+                util::FileSink output(outputPath);
+                decompressBlocks(getType(), [&inputPath](util::ByteSink &blocks)
+                                 { util::pumpFile(inputPath, blocks); }, output, options_);
+                output.finish();
             }
-            output.write(reinterpret_cast<const char *>(&fileSize), sizeof(fileSize));
-            output.write(reinterpret_cast<const char *>(compressedData.data()), compressedData.size());
-            output.close();
-        }
-        void decompress(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override
-        {
-            std::ifstream input(inputPath, std::ios::binary);
-            if (!input.is_open())
+            void compress(const std::filesystem::path &inputPath, util::ByteSink &output) override
             {
-                throw std::runtime_error("Failed to open input file: " + inputPath.string());
+                compressBlocks(getType(), inputPath, output, options_);
             }
-            size_t originalSize;
-            input.read(reinterpret_cast<char *>(&originalSize), sizeof(originalSize));
-            std::vector<uint8_t> compressedData;
-            uint8_t byte;
-            while (input.read(reinterpret_cast<char *>(&byte), 1))
+            void decompress(const std::vector<uint8_t> &stored, util::ByteSink &output) override
             {
-                compressedData.push_back(byte);
+                std::vector<uint8_t> decompressedData = decompressBuffer(getType(), stored);
+                output.write(decompressedData.data(), decompressedData.size());
             }
-            input.close();
-            Huffman huffman;
-            std::vector<uint8_t> decompressedData = huffman.decompress(compressedData, originalSize);
-            std::ofstream output(outputPath, std::ios::binary);
-            if (!output.is_open())
+            void setThreads(unsigned threads) override
             {
-                throw std::runtime_error("Failed to open output file: " + outputPath.string());
+                options_.threads = std::max(1u, threads);
             }
-            output.write(reinterpret_cast<const char *>(decompressedData.data()), decompressedData.size());
-            output.close();
-        }
-        CompressionType getType() const override
-        {
-            return CompressionType::Huffman;
-        }
-        std::string getName() const override
-        {
-            return "Huffman";
-        }
-    };
-    class Lz77Compression : public Compression
-    {
-    public:
-        void compress(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override
+
+        private:
+            BlockOptions options_;
+        };
+        class HuffmanCompression : public BlockCompression
         {
-            std::ifstream input(inputPath, std::ios::binary);
-            if (!input.is_open())
+        public:
+            CompressionType getType() const override
             {
-                throw std::runtime_error("Failed to open input file: " + inputPath.string());
+                return CompressionType::Huffman;
             }
-            input.seekg(0, std::ios::end);
-            size_t fileSize = input.tellg();
-            input.seekg(0, std::ios::beg);
-            std::vector<uint8_t> data(fileSize);
-            input.read(reinterpret_cast<char *>(data.data()), fileSize);
-            input.close();
-            LZ77 lz77;
-            std::vector<uint8_t> compressedData = lz77.compress(data);
-            std::ofstream output(outputPath, std::ios::binary);
-            if (!output.is_open())
+            std::string getName() const override
             {
-                throw std::runtime_error("Failed to open output file: " + outputPath.string());
+                return "Huffman";
             }
-            output.write(reinterpret_cast<const char *>(&fileSize), sizeof(fileSize));
-            output.write(reinterpret_cast<const char *>(compressedData.data()), compressedData.size());
-            output.close();
-        }
-        void decompress(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override
+        };
+        class Lz77Compression : public BlockCompression
         {
-            std::ifstream input(inputPath, std::ios::binary);
-            if (!input.is_open())
+        public:
+            CompressionType getType() const override
             {
-                throw std::runtime_error("Failed to open input file: " + inputPath.string());
+                return CompressionType::Lz77;
             }
-            size_t originalSize;
-            input.read(reinterpret_cast<char *>(&originalSize), sizeof(originalSize));
-            input.seekg(0, std::ios::end);
-            std::streampos fileEnd = input.tellg();
-            input.seekg(sizeof(originalSize), std::ios::beg);
-            std::streampos compressedDataStart = input.tellg();
-            size_t compressedSize = fileEnd - compressedDataStart;
-            std::vector<uint8_t> compressedData(compressedSize);
-            input.read(reinterpret_cast<char *>(compressedData.data()), compressedSize);
-            input.close();
-            LZ77 lz77;
-            std::vector<uint8_t> decompressedData = lz77.decompress(compressedData, originalSize);
-            std::ofstream output(outputPath, std::ios::binary);
-            if (!output.is_open())
+            std::string getName() const override
             {
-                throw std::runtime_error("Failed to open output file: " + outputPath.string());
+                return "Lz77";
             }
-            output.write(reinterpret_cast<const char *>(decompressedData.data()), decompressedData.size());
-            output.close();
-        }
-        CompressionType getType() const override
-        {
-            return CompressionType::Lz77;
-        }
-        std::string getName() const override
-        {
-            return "Lz77";
-        }
-    };
+        };
+    }
     std::unique_ptr<Compression> createCompressor(CompressionType type)
     {
         switch (type)
@@ -143,4 +78,4 @@ namespace backup::core::compression
             throw std::invalid_argument("Invalid compression type");
         }
     }
-} 
\ No newline at end of file
+}
@@ -1,18 +1,28 @@
 #pragma once
 #include <string>
 #include <filesystem>
+#include <memory>
+#include <vector>
+#include "util/ByteSink.h"
 namespace backup::core::compression {
 enum class CompressionType {
     Huffman,
     Lz77
 };
+// 写出分块容器，按块流式处理，内存与文件大小无关；解压时也接受旧版本写出的整文件格式
 class Compression {
 public:
     virtual ~Compression() = default;
     virtual void compress(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath) = 0;
     virtual void decompress(const std::filesystem::path& inputPath, const std::filesystem::path& outputPath) = 0;
+    // 流式输出：格式与写文件的版本相同（分块容器，见 BlockFormat.h），写完后不调用 output.finish()
+    virtual void compress(const std::filesystem::path& inputPath, util::ByteSink& output) = 0;
+    // stored 为 compress() 写出的完整内容，也接受旧版本的整文件格式
+    virtual void decompress(const std::vector<uint8_t>& stored, util::ByteSink& output) = 0;
+    // 并行压缩/解压各块的线程数（默认 1），输出与线程数无关
+    virtual void setThreads(unsigned threads) = 0;
     virtual CompressionType getType() const = 0;
     virtual std::string getName() const = 0;
 };
 std::unique_ptr<Compression> createCompressor(CompressionType type);
-} 
\ No newline at end of file
+} 
@@ -54,7 +54,7 @@ namespace backup::core::compression
         }
         return pq.top();
     }
-    void Huffman::generateHuffmanCodes(HuffmanNode *root, const std::string &code, std::map<uint8_t, std::string> &huffmanCodes)
+    void Huffman::generateHuffmanCodes(HuffmanNode *root, HuffmanCode code, std::array<HuffmanCode, 256> &huffmanCodes)
     {
         if (root == nullptr)
         {
@@ -62,43 +62,110 @@ namespace backup::core::compression
         }
         if (root->left == nullptr && root->right == nullptr)
         {
-            huffmanCodes[root->data] = code.empty() ? "0" : code;
+            // 只有一个字节（或没有数据）时根即叶子，编码为 "0"
+            huffmanCodes[root->data] = code.length == 0 ? HuffmanCode{0, 1} : code;
             return;
         }
-        generateHuffmanCodes(root->left, code + "0", huffmanCodes);
+        const HuffmanCode left{code.bits << 1, static_cast<uint8_t>(code.length + 1)};
+        generateHuffmanCodes(root->left, left, huffmanCodes);
         if (root->right != nullptr)
         {
-            generateHuffmanCodes(root->right, code + "1", huffmanCodes);
+            generateHuffmanCodes(root->right, HuffmanCode{left.bits | 1, left.length}, huffmanCodes);
         }
     }
     std::map<uint8_t, uint64_t> Huffman::calculateFrequencies(const std::vector<uint8_t> &data)
     {
-        std::map<uint8_t, uint64_t> frequencyMap;
+        std::array<uint64_t, 256> counts{};
         for (uint8_t byte : data)
         {
-            frequencyMap[byte]++;
+            ++counts[byte];
+        }
+        std::map<uint8_t, uint64_t> frequencyMap;
+        for (size_t byte = 0; byte < counts.size(); ++byte)
+        {
+            if (counts[byte] != 0)
+            {
+                frequencyMap.emplace(static_cast<uint8_t>(byte), counts[byte]);
+            }
         }
         return frequencyMap;
     }
-    std::vector<uint8_t> Huffman::compressData(const std::vector<uint8_t> &input, const std::map<uint8_t, std::string> &huffmanCodes)
+    namespace
     {
-        std::string bitString;
-        for (uint8_t byte : input)
+        /*
+         * 高位在前的位写入器：待写的位左对齐放在 64 位累加器中，每次写入后把累加器整 8 字节写到输出，
+         * 输出位置前进其中完整的字节数，不论是否写满都不需要分支；调用方保证输出末尾有 8 字节余量
+         */
+        class BitWriter
         {
-            bitString += huffmanCodes.at(byte);
+        public:
+            explicit BitWriter(uint8_t *out) : out_(out) {}
+
+            // length 不超过 32，累加器中剩余不到 8 位，加起来放得下
+            void put(uint64_t bits, unsigned length)
+            {
+                // 先在局部变量中算完再写回成员，写输出字节时编译器不必假设成员被改写
+                const uint64_t acc = acc_ | (bits << (64 - used_ - length));
+                const unsigned used = used_ + length;
+                // 逐字节写出（高位在前），编译器合并为一次 8 字节写入
+                out_[0] = static_cast<uint8_t>(acc >> 56);
+                out_[1] = static_cast<uint8_t>(acc >> 48);
+                out_[2] = static_cast<uint8_t>(acc >> 40);
+                out_[3] = static_cast<uint8_t>(acc >> 32);
+                out_[4] = static_cast<uint8_t>(acc >> 24);
+                out_[5] = static_cast<uint8_t>(acc >> 16);
+                out_[6] = static_cast<uint8_t>(acc >> 8);
+                out_[7] = static_cast<uint8_t>(acc);
+                const unsigned whole = used & ~7u;
+                out_ += whole >> 3;
+                acc_ = acc << whole;
+                used_ = used - whole;
+            }
+
+        private:
+            uint8_t *out_;
+            uint64_t acc_ = 0;
+            unsigned used_ = 0;
+        };
+    }
+    std::vector<uint8_t> Huffman::compressData(const std::vector<uint8_t> &input, const std::array<HuffmanCode, 256> &huffmanCodes,
+                                               const std::map<uint8_t, uint64_t> &frequencyMap)
+    {
+        uint64_t totalBits = 0;
+        bool longCodes = false;
+        for (const auto &pair : frequencyMap)
+        {
+            totalBits += pair.second * huffmanCodes[pair.first].length;
+            longCodes |= huffmanCodes[pair.first].length > 32;
+        }
+        // 末尾的 8 字节余量供 BitWriter 整块写入，最后截掉
+        std::vector<uint8_t> compressedData(static_cast<size_t>((totalBits + 7) / 8) + 8);
+        BitWriter writer(compressedData.data());
+        if (!longCodes)
+        {
+            for (uint8_t byte : input)
+            {
+                writer.put(huffmanCodes[byte].bits, huffmanCodes[byte].length);
+            }
         }
-        std::vector<uint8_t> compressedData;
-        for (size_t i = 0; i < bitString.size(); i += 8)
+        else
         {
-            std::string byteString = bitString.substr(i, 8);
-            while (byteString.size() < 8)
+            for (uint8_t byte : input)
             {
-                byteString += "0";
+                const HuffmanCode &code = huffmanCodes[byte];
+                if (code.length > 32)
+                {
+                    writer.put(code.bits >> 32, code.length - 32u);
+                    writer.put(code.bits & 0xFFFFFFFFu, 32);
+                }
+                else
+                {
+                    writer.put(code.bits, code.length);
+                }
             }
-            uint8_t byte = static_cast<uint8_t>(std::stoi(byteString, nullptr, 2));
-            compressedData.push_back(byte);
         }
-        compressedData.push_back(static_cast<uint8_t>(bitString.size() % 8));
+        compressedData.resize(static_cast<size_t>((totalBits + 7) / 8));
+        compressedData.push_back(static_cast<uint8_t>(totalBits % 8));
         return compressedData;
     }
     std::vector<uint8_t> Huffman::decompressData(const std::vector<uint8_t> &input, HuffmanNode *root, size_t originalSize)
@@ -203,9 +270,9 @@ namespace backup::core::compression
     {
         std::map<uint8_t, uint64_t> frequencyMap = calculateFrequencies(data);
         HuffmanNode *root = buildHuffmanTree(frequencyMap);
-        std::map<uint8_t, std::string> huffmanCodes;
-        generateHuffmanCodes(root, "", huffmanCodes);
-        std::vector<uint8_t> compressedData = compressData(data, huffmanCodes);
+        std::array<HuffmanCode, 256> huffmanCodes{};
+        generateHuffmanCodes(root, HuffmanCode{}, huffmanCodes);
+        std::vector<uint8_t> compressedData = compressData(data, huffmanCodes, frequencyMap);
         std::vector<uint8_t> result;
         size_t treeStartPos = 0;
         uint32_t treeSize = 0;
@@ -1,4 +1,5 @@
 #pragma once
+#include <array>
 #include <vector>
 #include <map>
 #include <string>
@@ -15,6 +16,13 @@ namespace backup::core::compression
         HuffmanNode(uint8_t data, uint64_t frequency);
         ~HuffmanNode();
     };
+    // 一个字节的编码：bits 的低 length 位，高位在前写出。
+    // 码长即树的深度，超过 32 位要求总频数达到斐波那契数 F(34) 以上，因此用 64 位保存
+    struct HuffmanCode
+    {
+        uint64_t bits = 0;
+        uint8_t length = 0;
+    };
     struct CompareHuffmanNodes
     {
         bool operator()(const HuffmanNode *lhs, const HuffmanNode *rhs);
@@ -23,9 +31,10 @@ namespace backup::core::compression
     {
     private:
         HuffmanNode *buildHuffmanTree(const std::map<uint8_t, uint64_t> &frequencyMap);
-        void generateHuffmanCodes(HuffmanNode *root, const std::string &code, std::map<uint8_t, std::string> &huffmanCodes);
+        void generateHuffmanCodes(HuffmanNode *root, HuffmanCode code, std::array<HuffmanCode, 256> &huffmanCodes);
         std::map<uint8_t, uint64_t> calculateFrequencies(const std::vector<uint8_t> &data);
-        std::vector<uint8_t> compressData(const std::vector<uint8_t> &input, const std::map<uint8_t, std::string> &huffmanCodes);
+        std::vector<uint8_t> compressData(const std::vector<uint8_t> &input, const std::array<HuffmanCode, 256> &huffmanCodes,
+                                          const std::map<uint8_t, uint64_t> &frequencyMap);
         std::vector<uint8_t> decompressData(const std::vector<uint8_t> &input, HuffmanNode *root, size_t originalSize);
         void saveHuffmanTree(HuffmanNode *root, std::ofstream &output);
         HuffmanNode *loadHuffmanTree(std::ifstream &input);
@@ -6,52 +6,200 @@
 #include <cstring>
 namespace backup::core::compression
 {
-    std::tuple<size_t, size_t, uint8_t> LZ77::findLongestMatch(const std::vector<uint8_t> &data, size_t currentPos)
+    namespace
     {
-        size_t bestOffset = 0;
-        size_t bestLength = 0;
-        uint8_t nextByte = data[currentPos];
-        size_t windowStart = (currentPos > WINDOW_SIZE) ? (currentPos - WINDOW_SIZE) : 0;
-        size_t lookaheadEnd = std::min(currentPos + LOOKAHEAD_SIZE, data.size());
-        for (size_t i = windowStart; i < currentPos; ++i)
+        constexpr size_t kRingSize = 4096; // 不小于窗口内的位置数
+        constexpr size_t kNone = SIZE_MAX;
+
+        // 窗口内键相同的位置按从旧到新串成双向链表；只保存窗口内的位置，节点放在环形数组中
+        class Chains
         {
-            size_t length = 0;
-            while (currentPos + length < lookaheadEnd && data[i + length] == data[currentPos + length])
+        public:
+            explicit Chains(size_t buckets)
+                : head_(buckets, kNone), tail_(buckets, kNone), next_(kRingSize), prev_(kRingSize) {}
+
+            void push(size_t key, size_t pos)
             {
-                ++length;
+                const size_t slot = pos & (kRingSize - 1);
+                next_[slot] = kNone;
+                prev_[slot] = head_[key];
+                if (head_[key] != kNone)
+                    next_[head_[key] & (kRingSize - 1)] = pos;
+                else
+                    tail_[key] = pos;
+                head_[key] = pos;
+            }
+
+            // 位置按从小到大离开窗口，离开的总是所在链表中最旧的一个
+            void pop(size_t key, size_t pos)
+            {
+                tail_[key] = next_[pos & (kRingSize - 1)];
+                if (tail_[key] == kNone)
+                    head_[key] = kNone;
             }
-            if (length > bestLength)
+
+            size_t oldest(size_t key) const { return tail_[key]; }
+            size_t newest(size_t key) const { return head_[key]; }
+            size_t newer(size_t pos) const { return next_[pos & (kRingSize - 1)]; }
+            size_t older(size_t pos) const { return prev_[pos & (kRingSize - 1)]; }
+
+        private:
+            std::vector<size_t> head_;
+            std::vector<size_t> tail_;
+            std::vector<size_t> next_;
+            std::vector<size_t> prev_;
+        };
+
+        constexpr size_t kHashBits = 15;
+
+        size_t key1(const uint8_t *p) { return p[0]; }
+        size_t key2(const uint8_t *p) { return (static_cast<size_t>(p[0]) << 8) | p[1]; }
+        size_t key3(const uint8_t *p)
+        {
+            const uint32_t v = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+            return (v * 2654435761u) >> (32 - kHashBits);
+        }
+
+        /*
+         * 与逐个比较整个窗口等价的匹配查找：结果是窗口中最长的匹配，长度相同时取最早（偏移最大）的位置。
+         *  - 长度 >= 3 的匹配前三个字节相同，只需比较三字节哈希链上的位置；从旧到新比较，
+         *    第一个达到上限的就是逐个比较时会停下的位置
+         *  - 没有长度 >= 3 的匹配时，最长匹配就是前两个（或一个）字节相同的位置中最早的一个，直接取链表的表尾
+         */
+        class MatchFinder
+        {
+        public:
+            MatchFinder(const std::vector<uint8_t> &data, size_t window, size_t maxChain)
+                : data_(data), window_(window), maxChain_(maxChain),
+                  chains1_(size_t(1) << 8), chains2_(size_t(1) << 16), chains3_(size_t(1) << kHashBits) {}
+
+            // 返回 (偏移, 长度)，长度不超过 limit
+            std::pair<size_t, size_t> find(size_t pos, size_t limit)
             {
-                bestLength = length;
-                bestOffset = currentPos - i;
-                if (currentPos + length < data.size())
+                evictBefore(pos);
+                const uint8_t *p = data_.data() + pos;
+                size_t bestPos = 0;
+                size_t bestLength = 0;
+
+                if (limit >= 3)
+                {
+                    const size_t key = key3(p);
+                    auto consider = [&](size_t candidate)
+                    {
+                        // 不比当前最长的更长就不用逐字节比较
+                        if (bestLength != 0 && data_[candidate + bestLength] != p[bestLength])
+                            return false;
+                        const size_t length = matchLength(candidate, pos, limit);
+                        if (length >= 3 && length > bestLength)
+                        {
+                            bestLength = length;
+                            bestPos = candidate;
+                        }
+                        return bestLength == limit;
+                    };
+                    if (maxChain_ == 0)
+                    {
+                        for (size_t c = chains3_.oldest(key); c != kNone; c = chains3_.newer(c))
+                        {
+                            if (consider(c))
+                                break;
+                        }
+                    }
+                    else
+                    {
+                        // 从最近的候选开始，长度相同时保留偏移较小的
+                        const size_t windowStart = pos > window_ ? pos - window_ : 0;
+                        size_t depth = 0;
+                        for (size_t c = chains3_.newest(key); c != kNone && c >= windowStart && depth < maxChain_;
+                             c = chains3_.older(c), ++depth)
+                        {
+                            if (consider(c))
+                                break;
+                        }
+                    }
+                }
+                if (bestLength == 0 && limit >= 2 && chains2_.oldest(key2(p)) != kNone)
                 {
-                    nextByte = data[currentPos + length];
+                    bestPos = chains2_.oldest(key2(p));
+                    bestLength = 2;
                 }
-                else
+                if (bestLength == 0 && chains1_.oldest(key1(p)) != kNone)
                 {
-                    nextByte = 0;
+                    bestPos = chains1_.oldest(key1(p));
+                    bestLength = 1;
                 }
-                if (bestLength == LOOKAHEAD_SIZE)
+                return {bestLength == 0 ? 0 : pos - bestPos, bestLength};
+            }
+
+            // 把 [inserted_, end) 中的位置加入链表
+            void insertUntil(size_t end)
+            {
+                end = std::min(end, data_.size());
+                for (; inserted_ < end; ++inserted_)
                 {
-                    break;
+                    evictBefore(inserted_ + 1); // 腾出环形数组中的槽位
+                    const uint8_t *p = data_.data() + inserted_;
+                    const size_t available = data_.size() - inserted_;
+                    chains1_.push(key1(p), inserted_);
+                    if (available >= 2)
+                        chains2_.push(key2(p), inserted_);
+                    if (available >= 3)
+                        chains3_.push(key3(p), inserted_);
                 }
             }
-        }
-        return std::make_tuple(bestOffset, bestLength, nextByte);
+
+        private:
+            const std::vector<uint8_t> &data_;
+            size_t window_;
+            size_t maxChain_;
+            Chains chains1_;
+            Chains chains2_;
+            Chains chains3_;
+            size_t inserted_ = 0;
+            size_t evicted_ = 0;
+
+            // 移除距 pos 超过窗口大小的位置
+            void evictBefore(size_t pos)
+            {
+                for (; evicted_ + window_ < pos; ++evicted_)
+                {
+                    const uint8_t *p = data_.data() + evicted_;
+                    const size_t available = data_.size() - evicted_;
+                    chains1_.pop(key1(p), evicted_);
+                    if (available >= 2)
+                        chains2_.pop(key2(p), evicted_);
+                    if (available >= 3)
+                        chains3_.pop(key3(p), evicted_);
+                }
+            }
+
+            size_t matchLength(size_t candidate, size_t pos, size_t limit) const
+            {
+                size_t length = 0;
+                while (length < limit && data_[candidate + length] == data_[pos + length])
+                    ++length;
+                return length;
+            }
+        };
     }
+    LZ77::LZ77(size_t maxChain) : maxChain_(maxChain) {}
     std::vector<uint8_t> LZ77::compress(const std::vector<uint8_t> &data)
     {
         std::vector<uint8_t> compressedData;
+        compressedData.reserve(data.size() / 2);
+        MatchFinder finder(data, WINDOW_SIZE, maxChain_);
         size_t currentPos = 0;
         while (currentPos < data.size())
         {
-            auto [offset, length, nextByte] = findLongestMatch(data, currentPos);
+            const size_t limit = std::min(LOOKAHEAD_SIZE, data.size() - currentPos);
+            auto [offset, length] = finder.find(currentPos, limit);
+            const uint8_t nextByte = currentPos + length < data.size() ? data[currentPos + length] : 0;
             uint16_t code = (offset << 4) | (length & 0x0F);
             compressedData.push_back(static_cast<uint8_t>((code >> 8) & 0xFF));
             compressedData.push_back(static_cast<uint8_t>(code & 0xFF));
             compressedData.push_back(nextByte);
             currentPos += (length + 1);
+            finder.insertUntil(currentPos);
         }
         return compressedData;
     }
@@ -89,4 +237,247 @@ namespace backup::core::compression
         }
         return decompressedData;
     }
-} 
\ No newline at end of file
+    namespace
+    {
+        /*
+         * 版本 2 的流格式：
+         *  - 第一个字节为方式：0 为 LZSS 记号，1 为原样保存的数据
+         *  - 记号每 8 个一组，组前一个标志字节，第 i 位（从低位起）为 1 表示第 i 个记号是匹配；
+         *    字面量为 1 个字节，匹配为两个 LEB128 变长整数：长度 - kMinMatch、偏移 - 1
+         *  - 解压到原始大小为止，之后不能再有数据
+         */
+        constexpr uint8_t kTokens = 0;
+        constexpr uint8_t kRaw = 1;
+        constexpr size_t kMinMatch = 4;
+        constexpr size_t kNiceLength = 32; // 找到这么长的匹配就不再比较链上其余的位置
+        // 连续 2^kSkipShift 个位置找不到匹配后，每多 2^kSkipShift 次就多跳过一个位置不查找（不可压缩的数据）
+        constexpr size_t kSkipShift = 5;
+
+        size_t varintSize(size_t value)
+        {
+            size_t size = 1;
+            for (; value >= 0x80; value >>= 7)
+                ++size;
+            return size;
+        }
+
+        void putVarint(std::vector<uint8_t> &out, size_t value)
+        {
+            for (; value >= 0x80; value >>= 7)
+                out.push_back(static_cast<uint8_t>(value | 0x80));
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        size_t getVarint(const std::vector<uint8_t> &in, size_t &pos)
+        {
+            size_t value = 0;
+            for (unsigned shift = 0; shift < 64; shift += 7)
+            {
+                if (pos >= in.size())
+                    throw std::runtime_error("LZ77 stream is truncated");
+                const uint8_t byte = in[pos++];
+                value |= static_cast<size_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    return value;
+            }
+            throw std::runtime_error("Corrupt LZ77 stream");
+        }
+
+        // 四字节哈希链：head_ 为各哈希值最新的位置，prev_ 为环形数组，位置 p 处保存同一哈希值的上一个位置。
+        // 只保存位置的低 32 位，按与当前位置的距离还原，表项占用的缓存减半；
+        // 过期或未初始化的表项至多带来一次多余的比较。哈希表随窗口增大（最多 2^18 项）
+        class HashChains
+        {
+        public:
+            HashChains(const std::vector<uint8_t> &data, size_t maxChain)
+                : data_(data), maxChain_(maxChain)
+            {
+                size_t ring = 1;
+                while (ring < std::min(data.size(), LZ77::kWindowV2))
+                    ring <<= 1;
+                prev_.resize(ring);
+                mask_ = ring - 1;
+                window_ = std::min(ring, LZ77::kWindowV2);
+                while (headBits_ < 18 && (size_t(1) << headBits_) < ring)
+                    ++headBits_;
+                head_.assign(size_t(1) << headBits_, 0);
+            }
+
+            void insert(size_t pos)
+            {
+                if (pos + kMinMatch > data_.size())
+                    return;
+                const size_t h = hash(pos);
+                prev_[pos & mask_] = head_[h];
+                head_[h] = static_cast<uint32_t>(pos);
+            }
+
+            // 返回 (偏移, 长度)，没有长度 >= kMinMatch 的匹配时长度为 0；
+            // 链上的位置从新到旧，距离不再增大或超出窗口时结束，窗口内的位置在环形数组中还未被覆盖
+            std::pair<size_t, size_t> find(size_t pos) const
+            {
+                const size_t limit = data_.size() - pos;
+                if (limit < kMinMatch)
+                    return {0, 0};
+                const uint8_t *p = data_.data() + pos;
+                const uint32_t here = static_cast<uint32_t>(pos);
+                size_t bestOffset = 0;
+                size_t bestLength = kMinMatch - 1;
+                size_t distance = 0;
+                uint32_t stored = head_[hash(pos)];
+                for (size_t depth = 0; depth < maxChain_; ++depth)
+                {
+                    const size_t next = static_cast<uint32_t>(here - stored);
+                    if (next <= distance || next > window_ || next > pos)
+                        break;
+                    distance = next;
+                    stored = prev_[(pos - distance) & mask_];
+
+                    const uint8_t *q = p - distance;
+                    // 比当前最长匹配多出的那个字节不同就不可能更长
+                    if (q[bestLength] != p[bestLength])
+                        continue;
+                    size_t length = 0;
+                    // 先每次比较 8 个字节
+                    for (uint64_t x, y; length + 8 <= limit; length += 8)
+                    {
+                        std::memcpy(&x, q + length, sizeof(x));
+                        std::memcpy(&y, p + length, sizeof(y));
+                        if (x != y)
+                            break;
+                    }
+                    while (length < limit && q[length] == p[length])
+                        ++length;
+                    if (length > bestLength)
+                    {
+                        bestLength = length;
+                        bestOffset = distance;
+                        if (length == limit || length >= kNiceLength)
+                            break;
+                    }
+                }
+                return {bestOffset, bestOffset ? bestLength : 0};
+            }
+
+        private:
+            const std::vector<uint8_t> &data_;
+            std::vector<uint32_t> head_;
+            std::vector<uint32_t> prev_;
+            size_t mask_ = 0;
+            size_t window_ = 0;
+            size_t maxChain_;
+            unsigned headBits_ = 10;
+
+            size_t hash(size_t pos) const
+            {
+                uint32_t v;
+                std::memcpy(&v, data_.data() + pos, sizeof(v));
+                return (v * 2654435761u) >> (32 - headBits_);
+            }
+        };
+    }
+    std::vector<uint8_t> LZ77::compressV2(const std::vector<uint8_t> &data)
+    {
+        const size_t n = data.size();
+        std::vector<uint8_t> out;
+        out.reserve(n / 2 + 16);
+        out.push_back(kTokens);
+        HashChains chains(data, maxChain_ == kExhaustive ? kDefaultChain : maxChain_);
+        size_t flagPos = 0;
+        unsigned flagBit = 8;
+        size_t pos = 0;
+        size_t misses = 0;
+        size_t nextSearch = 0; // 此前的位置直接作为字面量，不查找也不加入哈希链
+        // 输出超过原样保存的大小后不必继续
+        while (pos < n && out.size() <= n)
+        {
+            if (flagBit == 8)
+            {
+                flagPos = out.size();
+                out.push_back(0);
+                flagBit = 0;
+            }
+            const auto [offset, length] = pos >= nextSearch ? chains.find(pos) : std::pair<size_t, size_t>{0, 0};
+            // 编码不比字面量短的匹配不用
+            if (length > 0 && varintSize(length - kMinMatch) + varintSize(offset - 1) < length)
+            {
+                out[flagPos] |= static_cast<uint8_t>(1u << flagBit);
+                putVarint(out, length - kMinMatch);
+                putVarint(out, offset - 1);
+                for (const size_t end = pos + length; pos < end; ++pos)
+                    chains.insert(pos);
+                misses = 0;
+            }
+            else
+            {
+                out.push_back(data[pos]);
+                if (pos >= nextSearch)
+                {
+                    chains.insert(pos);
+                    nextSearch = pos + 1 + (++misses >> kSkipShift);
+                }
+                ++pos;
+            }
+            ++flagBit;
+        }
+        if (out.size() > n)
+        {
+            out.assign(1, kRaw);
+            out.insert(out.end(), data.begin(), data.end());
+        }
+        return out;
+    }
+    std::vector<uint8_t> LZ77::decompressV2(const std::vector<uint8_t> &data, size_t originalSize)
+    {
+        if (data.empty())
+            throw std::runtime_error("LZ77 stream is truncated");
+        if (data[0] == kRaw)
+        {
+            if (data.size() - 1 != originalSize)
+                throw std::runtime_error("Corrupt LZ77 stream");
+            return std::vector<uint8_t>(data.begin() + 1, data.end());
+        }
+        if (data[0] != kTokens)
+            throw std::runtime_error("Unknown LZ77 stream format");
+
+        std::vector<uint8_t> out(originalSize);
+        size_t in = 1;
+        size_t pos = 0;
+        uint8_t flags = 0;
+        unsigned flagBit = 8;
+        while (pos < originalSize)
+        {
+            if (flagBit == 8)
+            {
+                if (in >= data.size())
+                    throw std::runtime_error("LZ77 stream is truncated");
+                flags = data[in++];
+                flagBit = 0;
+            }
+            if (flags & (1u << flagBit++))
+            {
+                const size_t extra = getVarint(data, in);
+                const size_t distance = getVarint(data, in);
+                if (distance >= pos || extra > originalSize - pos || extra + kMinMatch > originalSize - pos)
+                    throw std::runtime_error("Corrupt LZ77 stream");
+                const size_t length = extra + kMinMatch;
+                const size_t offset = distance + 1;
+                // 偏移小于长度时源与目标重叠，逐字节复制
+                const uint8_t *from = out.data() + pos - offset;
+                uint8_t *to = out.data() + pos;
+                for (size_t i = 0; i < length; ++i)
+                    to[i] = from[i];
+                pos += length;
+            }
+            else
+            {
+                if (in >= data.size())
+                    throw std::runtime_error("LZ77 stream is truncated");
+                out[pos++] = data[in++];
+            }
+        }
+        if (in != data.size())
+            throw std::runtime_error("Corrupt LZ77 stream");
+        return out;
+    }
+}
@@ -10,9 +10,19 @@ namespace backup::core::compression
     private:
         static constexpr size_t WINDOW_SIZE = 4095;  
         static constexpr size_t LOOKAHEAD_SIZE = 15; 
-        std::tuple<size_t, size_t, uint8_t> findLongestMatch(const std::vector<uint8_t> &data, size_t currentPos);
+        size_t maxChain_;
     public:
+        // 默认（kExhaustive）找出窗口中最早出现的最长匹配，输出与逐个比较整个窗口完全一致；
+        // maxChain > 0 时每个位置只比较最近的 maxChain 个候选，更快但可能错过更长的匹配，解压方式不变
+        static constexpr size_t kExhaustive = 0;
+        explicit LZ77(size_t maxChain = kExhaustive);
         std::vector<uint8_t> compress(const std::vector<uint8_t> &data);
         std::vector<uint8_t> decompress(const std::vector<uint8_t> &data, size_t originalSize);
+        // 版本 2 的流格式（LZSS，格式见 LZ77.cpp）：窗口 1 MiB，匹配长度不限，压缩后不变小时整段原样保存。
+        // 每个位置最多比较 maxChain 个候选，kExhaustive 时取 kDefaultChain；数据损坏时 decompressV2 抛出 std::runtime_error
+        static constexpr size_t kWindowV2 = size_t(1) << 20;
+        static constexpr size_t kDefaultChain = 16;
+        std::vector<uint8_t> compressV2(const std::vector<uint8_t> &data);
+        static std::vector<uint8_t> decompressV2(const std::vector<uint8_t> &data, size_t originalSize);
     };
-} 
\ No newline at end of file
+} 
@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <vector>
 #include <cstring>
+#include <algorithm>
 #include <openssl/evp.h>
 
 namespace backup::core::encryption
@@ -41,137 +42,107 @@ namespace backup::core::encryption
         memcpy(iv, hash, 16); // 使用哈希前16字节作为IV
     }
 
-    void AESEncryption::encrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath)
+    namespace
     {
-        if (m_key.empty())
-        {
-            throw std::runtime_error("Encryption key not set");
-        }
-
-        std::ifstream input(inputPath, std::ios::binary);
-        if (!input.is_open())
-        {
-            throw std::runtime_error("Failed to open input file: " + inputPath.string());
-        }
-
-        std::ofstream output(outputPath, std::ios::binary);
-        if (!output.is_open())
-        {
-            throw std::runtime_error("Failed to open output file: " + outputPath.string());
-        }
-
-        uint8_t key[32], iv[16];
-        deriveKey(m_key, key, iv);
-
-        EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-        if (!ctx)
-        {
-            throw std::runtime_error("Failed to create EVP context");
-        }
-
-        const EVP_CIPHER *cipher = EVP_aes_256_cbc();
-        if (!EVP_EncryptInit_ex(ctx, cipher, nullptr, key, iv))
-        {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Failed to initialize encryption");
-        }
-
-        const size_t BUFFER_SIZE = 4096;
-        std::vector<uint8_t> inBuffer(BUFFER_SIZE);
-        std::vector<uint8_t> outBuffer(BUFFER_SIZE + EVP_MAX_BLOCK_LENGTH);
-        int inLen, outLen;
-
-        while (input.good())
+        // AES-256-CBC 流式变换，encrypt 为 false 时解密
+        class CipherSink : public util::ByteSink
         {
-            input.read(reinterpret_cast<char *>(inBuffer.data()), BUFFER_SIZE);
-            inLen = input.gcount();
-            if (inLen <= 0)
-                break;
+        public:
+            CipherSink(bool encrypt, const uint8_t *key, const uint8_t *iv, util::ByteSink &output)
+                : m_encrypt(encrypt), m_output(output), m_ctx(EVP_CIPHER_CTX_new())
+            {
+                if (!m_ctx)
+                {
+                    throw std::runtime_error("Failed to create EVP context");
+                }
+                if (!EVP_CipherInit_ex(m_ctx, EVP_aes_256_cbc(), nullptr, key, iv, encrypt ? 1 : 0))
+                {
+                    EVP_CIPHER_CTX_free(m_ctx);
+                    throw std::runtime_error(encrypt ? "Failed to initialize encryption"
+                                                     : "Failed to initialize decryption");
+                }
+            }
 
-            if (!EVP_EncryptUpdate(ctx, outBuffer.data(), &outLen, inBuffer.data(), inLen))
+            ~CipherSink() override
             {
-                EVP_CIPHER_CTX_free(ctx);
-                throw std::runtime_error("Encryption failed");
+                EVP_CIPHER_CTX_free(m_ctx);
             }
 
-            output.write(reinterpret_cast<const char *>(outBuffer.data()), outLen);
-        }
+            void write(const uint8_t *data, size_t size) override
+            {
+                while (size > 0)
+                {
+                    const int inLen = static_cast<int>(std::min(size, BUFFER_SIZE));
+                    int outLen = 0;
+                    if (!EVP_CipherUpdate(m_ctx, m_buffer, &outLen, data, inLen))
+                    {
+                        throw std::runtime_error(m_encrypt ? "Encryption failed" : "Decryption failed");
+                    }
+                    m_output.write(m_buffer, static_cast<size_t>(outLen));
+                    data += inLen;
+                    size -= static_cast<size_t>(inLen);
+                }
+            }
 
-        if (!EVP_EncryptFinal_ex(ctx, outBuffer.data(), &outLen))
-        {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Encryption finalization failed");
-        }
+            void finish() override
+            {
+                int outLen = 0;
+                if (!EVP_CipherFinal_ex(m_ctx, m_buffer, &outLen))
+                {
+                    throw std::runtime_error(m_encrypt ? "Encryption finalization failed"
+                                                       : "Decryption finalization failed");
+                }
+                m_output.write(m_buffer, static_cast<size_t>(outLen));
+                m_output.finish();
+            }
 
-        output.write(reinterpret_cast<const char *>(outBuffer.data()), outLen);
+        private:
+            static constexpr size_t BUFFER_SIZE = 4096;
 
-        EVP_CIPHER_CTX_free(ctx);
+            bool m_encrypt;
+            util::ByteSink &m_output;
+            EVP_CIPHER_CTX *m_ctx;
+            uint8_t m_buffer[BUFFER_SIZE + EVP_MAX_BLOCK_LENGTH];
+        };
     }
 
-    void AESEncryption::decrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath)
+    std::unique_ptr<util::ByteSink> AESEncryption::encryptTo(util::ByteSink &output)
     {
         if (m_key.empty())
         {
             throw std::runtime_error("Encryption key not set");
         }
 
-        std::ifstream input(inputPath, std::ios::binary);
-        if (!input.is_open())
-        {
-            throw std::runtime_error("Failed to open input file: " + inputPath.string());
-        }
-
-        std::ofstream output(outputPath, std::ios::binary);
-        if (!output.is_open())
-        {
-            throw std::runtime_error("Failed to open output file: " + outputPath.string());
-        }
-
         uint8_t key[32], iv[16];
         deriveKey(m_key, key, iv);
+        return std::make_unique<CipherSink>(true, key, iv, output);
+    }
 
-        EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-        if (!ctx)
-        {
-            throw std::runtime_error("Failed to create EVP context");
-        }
-
-        const EVP_CIPHER *cipher = EVP_aes_256_cbc();
-        if (!EVP_DecryptInit_ex(ctx, cipher, nullptr, key, iv))
-        {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Failed to initialize decryption");
-        }
-
-        const size_t BUFFER_SIZE = 4096;
-        std::vector<uint8_t> inBuffer(BUFFER_SIZE);
-        std::vector<uint8_t> outBuffer(BUFFER_SIZE + EVP_MAX_BLOCK_LENGTH);
-        int inLen, outLen;
-
-        while (input.good())
+    std::unique_ptr<util::ByteSink> AESEncryption::decryptTo(util::ByteSink &output)
+    {
+        if (m_key.empty())
         {
-            input.read(reinterpret_cast<char *>(inBuffer.data()), BUFFER_SIZE);
-            inLen = input.gcount();
-            if (inLen <= 0)
-                break;
-
-            if (!EVP_DecryptUpdate(ctx, outBuffer.data(), &outLen, inBuffer.data(), inLen))
-            {
-                EVP_CIPHER_CTX_free(ctx);
-                throw std::runtime_error("Decryption failed");
-            }
-
-            output.write(reinterpret_cast<const char *>(outBuffer.data()), outLen);
+            throw std::runtime_error("Encryption key not set");
         }
 
-        if (!EVP_DecryptFinal_ex(ctx, outBuffer.data(), &outLen))
-        {
-            EVP_CIPHER_CTX_free(ctx);
-            throw std::runtime_error("Decryption finalization failed");
-        }
+        uint8_t key[32], iv[16];
+        deriveKey(m_key, key, iv);
+        return std::make_unique<CipherSink>(false, key, iv, output);
+    }
 
-        output.write(reinterpret_cast<const char *>(outBuffer.data()), outLen);
+    void AESEncryption::encrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath)
+    {
+        util::FileSink output(outputPath);
+        auto cipher = encryptTo(output);
+        util::pumpFile(inputPath, *cipher);
+        cipher->finish();
+    }
 
-        EVP_CIPHER_CTX_free(ctx);
+    void AESEncryption::decrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath)
+    {
+        util::FileSink output(outputPath);
+        auto cipher = decryptTo(output);
+        util::pumpFile(inputPath, *cipher);
+        cipher->finish();
     }
-}
\ No newline at end of file
+}
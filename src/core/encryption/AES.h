@@ -16,6 +16,10 @@ namespace backup::core::encryption
 
         void decrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override;
 
+        std::unique_ptr<util::ByteSink> encryptTo(util::ByteSink &output) override;
+
+        std::unique_ptr<util::ByteSink> decryptTo(util::ByteSink &output) override;
+
         EncryptionType getType() const override;
 
         std::string getName() const override;
@@ -2,6 +2,7 @@
 #include <string>
 #include <filesystem>
 #include <memory>
+#include "util/ByteSink.h"
 
 namespace backup::core::encryption
 {
@@ -27,6 +28,13 @@ namespace backup::core::encryption
         // 解密文件
         virtual void decrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) = 0;
 
+        // 流式加密：写入返回的 sink 的数据加密后写入 output，
+        // 其 finish() 写出最后一块并调用 output.finish()；output 须比返回的 sink 活得久
+        virtual std::unique_ptr<util::ByteSink> encryptTo(util::ByteSink &output) = 0;
+
+        // 流式解密，约定同 encryptTo()
+        virtual std::unique_ptr<util::ByteSink> decryptTo(util::ByteSink &output) = 0;
+
         // 获取加密类型
         virtual EncryptionType getType() const = 0;
 
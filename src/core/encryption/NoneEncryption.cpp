@@ -19,6 +19,18 @@ namespace backup::core::encryption
         throw std::runtime_error("None encryption type does not support decrypt operation");
     }
 
+    // 与 encrypt() 一样不处理数据：不加密时调用方直接写入目标，不经过加密器
+    std::unique_ptr<util::ByteSink> NoneEncryption::encryptTo(util::ByteSink & /*output*/)
+    {
+        throw std::runtime_error("None encryption type does not support encrypt operation");
+    }
+
+    // 同上，不加密时还原直接读取源文件
+    std::unique_ptr<util::ByteSink> NoneEncryption::decryptTo(util::ByteSink & /*output*/)
+    {
+        throw std::runtime_error("None encryption type does not support decrypt operation");
+    }
+
     EncryptionType NoneEncryption::getType() const
     {
         return EncryptionType::None;
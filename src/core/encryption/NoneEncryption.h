@@ -13,6 +13,8 @@ namespace backup::core::encryption
         void setKey(const std::string &key) override;
         void encrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override;
         void decrypt(const std::filesystem::path &inputPath, const std::filesystem::path &outputPath) override;
+        std::unique_ptr<util::ByteSink> encryptTo(util::ByteSink &output) override;
+        std::unique_ptr<util::ByteSink> decryptTo(util::ByteSink &output) override;
         EncryptionType getType() const override;
         std::string getName() const override;
     };
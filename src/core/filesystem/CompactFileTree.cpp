@@ -0,0 +1,200 @@
+#include "CompactFileTree.h"
+#include "FileTree.h"
+#include "util/TimeUtils.h"
+#include <limits>
+#include <stdexcept>
+
+namespace backup::filesystem {
+namespace fs = std::filesystem;
+
+CompactFileTree::CompactFileTree(const fs::path& rootPath, ScanOptions options)
+    : rootPath_(rootPath), options_(options) {}
+
+CompactFileTree::Index
+CompactFileTree::appendNode(std::string_view name, FileType type, Index parent,
+                            uint64_t sizeOrHash, int64_t mtimeNs) {
+    if (nodes_.size() >= npos) {
+        throw std::runtime_error("Too many entries for CompactFileTree");
+    }
+    if (names_.size() + name.size() > std::numeric_limits<uint32_t>::max() ||
+        name.size() > std::numeric_limits<uint16_t>::max()) {
+        throw std::runtime_error("Name arena of CompactFileTree is full");
+    }
+
+    Node node{};
+    node.size = sizeOrHash;
+    node.mtimeNs = mtimeNs;
+    node.parent = parent;
+    node.firstChild = 0;
+    node.childCount = 0;
+    node.nameOffset = static_cast<uint32_t>(names_.size());
+    node.nameLength = static_cast<uint16_t>(name.size());
+    node.type = type;
+
+    names_.append(name);
+    nodes_.push_back(node);
+    return static_cast<Index>(nodes_.size() - 1);
+}
+
+void CompactFileTree::build() {
+    if (!fs::exists(rootPath_) || !fs::is_directory(rootPath_)) {
+        throw std::runtime_error("Root path must be an existing directory");
+    }
+
+    nodes_.clear();
+    names_.clear();
+    appendNode(rootPath_.filename().string(), FileType::Directory, npos, 0, 0);
+
+    // breadth-first: nodes are read in index order, so every directory's
+    // children are appended as one contiguous run
+    for (Index i = 0; i < nodes_.size(); ++i) {
+        if (!nodes_[i].isDirectory()) {
+            continue;
+        }
+
+        const auto relPath = relativePath(i);
+        const fs::path absPath = i == root() ? rootPath_ : rootPath_ / relPath;
+        auto entries = listDirectory(absPath, relPath, options_);
+
+        const auto first = static_cast<Index>(nodes_.size());
+        for (const auto& entry : entries) {
+            appendNode(entry.name, entry.type, i,
+                       entry.type == FileType::File ? entry.size : 0,
+                       entry.type == FileType::File
+                           ? util::fileTimeToInt64(entry.mtime) : 0);
+        }
+        nodes_[i].firstChild = first;
+        nodes_[i].childCount = static_cast<Index>(entries.size());
+    }
+
+    // children always sit after their parent, so a reverse sweep is bottom-up
+    for (Index i = static_cast<Index>(nodes_.size()); i-- > 0;) {
+        auto& dir = nodes_[i];
+        if (!dir.isDirectory()) {
+            continue;
+        }
+        SubtreeHasher hasher;
+        for (Index c = dir.firstChild; c < dir.firstChild + dir.childCount; ++c) {
+            const auto& child = nodes_[c];
+            if (child.isDirectory()) {
+                hasher.addDirectory(name(c), child.hash);
+            } else {
+                hasher.addFile(name(c), child.size, child.mtimeNs);
+            }
+        }
+        dir.hash = hasher.digest();
+    }
+}
+
+CompactFileTree CompactFileTree::fromFileTree(const FileTree& tree) {
+    CompactFileTree compact(tree.getRootPath(), tree.getScanOptions());
+    auto root = tree.getRoot();
+    if (!root) {
+        return compact;
+    }
+
+    std::vector<std::shared_ptr<FileNode>> pending{root};
+    compact.appendNode(root->getName(), FileType::Directory, npos, root->getHash(), 0);
+
+    for (Index i = 0; i < pending.size(); ++i) {
+        const auto& children = pending[i]->getChildren();
+        const auto first = static_cast<Index>(compact.nodes_.size());
+        for (const auto& child : children) {
+            compact.appendNode(child->getName(),
+                               child->isFile() ? FileType::File : FileType::Directory,
+                               i,
+                               child->isFile() ? child->getSize() : child->getHash(),
+                               child->isFile() ? util::fileTimeToInt64(child->getMTime()) : 0);
+            pending.push_back(child);
+        }
+        compact.nodes_[i].firstChild = first;
+        compact.nodes_[i].childCount = static_cast<Index>(children.size());
+        pending[i].reset();
+    }
+    return compact;
+}
+
+const fs::path& CompactFileTree::getRootPath() const noexcept {
+    return rootPath_;
+}
+
+bool CompactFileTree::empty() const noexcept {
+    return nodes_.empty();
+}
+
+size_t CompactFileTree::size() const noexcept {
+    return nodes_.size();
+}
+
+CompactFileTree::Index CompactFileTree::root() const noexcept {
+    return 0;
+}
+
+const CompactFileTree::Node& CompactFileTree::node(Index index) const {
+    return nodes_.at(index);
+}
+
+std::string_view CompactFileTree::name(Index index) const {
+    const auto& n = nodes_.at(index);
+    return std::string_view(names_).substr(n.nameOffset, n.nameLength);
+}
+
+std::string CompactFileTree::relativePath(Index index) const {
+    if (index == root()) {
+        return ".";
+    }
+
+    // walk up to the root, then join the names in reverse
+    std::vector<Index> chain;
+    for (Index i = index; i != root(); i = nodes_.at(i).parent) {
+        chain.push_back(i);
+    }
+
+    std::string path;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+        if (!path.empty()) path += '/';
+        path += name(*it);
+    }
+    return path;
+}
+
+CompactFileTree::FileTime CompactFileTree::mtime(Index index) const {
+    return util::int64ToFileTime(nodes_.at(index).mtimeNs);
+}
+
+void CompactFileTree::traverseDFS(const std::function<void(Index)>& visitor) const {
+    if (nodes_.empty()) {
+        return;
+    }
+
+    // explicit stack of indices; children are pushed in reverse so that
+    // they pop in name order
+    std::vector<Index> stack{root()};
+    while (!stack.empty()) {
+        Index i = stack.back();
+        stack.pop_back();
+        visitor(i);
+
+        const auto& n = nodes_[i];
+        for (Index c = n.childCount; c > 0; --c) {
+            stack.push_back(n.firstChild + c - 1);
+        }
+    }
+}
+
+std::shared_ptr<FileNode> CompactFileTree::toFileNode(Index index) const {
+    const auto& n = nodes_.at(index);
+    auto node = std::make_shared<FileNode>(
+        std::string(name(index)),
+        relativePath(index),
+        n.type,
+        n.isFile() ? n.size : 0,
+        mtime(index)
+    );
+    if (n.isDirectory()) {
+        node->setHash(n.hash);
+    }
+    return node;
+}
+
+} // namespace backup::filesystem
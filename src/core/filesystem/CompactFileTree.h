@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FileNode.h"
+#include "DirectoryLister.h"
+
+namespace backup::filesystem {
+
+class FileTree;
+
+/*
+ *   CompactFileTree is a flat, index-based alternative to the shared_ptr
+ *   FileNode tree, meant for very large sources.
+ *
+ *   - nodes live in one contiguous array in breadth-first order, so the
+ *     children of a directory are the index range
+ *     [firstChild, firstChild + childCount), sorted by name
+ *   - names are stored once in a shared string arena
+ *   - relative paths are not stored; they are rebuilt from parent links
+ *
+ *   A node costs 40 bytes plus its name, against several heap blocks
+ *   (control block, two strings, a vector) per FileNode. Directories carry
+ *   the same subtree hash as FileTree, in the slot files use for size.
+ */
+class CompactFileTree {
+public:
+    using Index = uint32_t;
+    using FileTime = FileNode::FileTime;
+
+    static constexpr Index npos = UINT32_MAX;
+
+    struct Node {
+        union {
+            uint64_t size;      // file
+            uint64_t hash;      // directory: subtree hash, see SubtreeHasher
+        };
+        int64_t mtimeNs;        // valid only for file, same encoding as .backupmeta
+        Index parent;           // npos for the root
+        Index firstChild;
+        Index childCount;
+        uint32_t nameOffset;    // into the name arena
+        uint16_t nameLength;
+        FileType type;
+
+        bool isFile() const noexcept { return type == FileType::File; }
+        bool isDirectory() const noexcept { return type == FileType::Directory; }
+    };
+
+    // options.threads is ignored; the breadth-first build is single-threaded
+    explicit CompactFileTree(const std::filesystem::path& rootPath,
+                             ScanOptions options = {});
+
+    // scans rootPath directly, without going through FileNode
+    void build();
+
+    // flattens an already built FileTree
+    static CompactFileTree fromFileTree(const FileTree& tree);
+
+    const std::filesystem::path& getRootPath() const noexcept;
+
+    bool empty() const noexcept;
+    size_t size() const noexcept;
+    Index root() const noexcept;
+
+    const Node& node(Index index) const;
+    std::string_view name(Index index) const;
+    std::string relativePath(Index index) const;   // "." for the root
+    FileTime mtime(Index index) const;
+
+    // pre-order, children in name order; the same order as FileTree::traverseDFS
+    void traverseDFS(const std::function<void(Index)>& visitor) const;
+
+    // detached copy of one node (without children), for FileChange
+    std::shared_ptr<FileNode> toFileNode(Index index) const;
+
+private:
+    std::filesystem::path rootPath_;
+    ScanOptions options_;
+    std::vector<Node> nodes_;
+    std::string names_;
+
+    // sizeOrHash fills the size/hash union
+    Index appendNode(std::string_view name, FileType type, Index parent,
+                     uint64_t sizeOrHash, int64_t mtimeNs);
+};
+
+} // namespace backup::filesystem
@@ -0,0 +1,384 @@
+#include "DirectoryLister.h"
+#include "ScanCache.h"
+#include "PathFilter.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+namespace backup::filesystem {
+namespace fs = std::filesystem;
+
+namespace {
+
+void sortByName(std::vector<DirEntry>& entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const DirEntry& a, const DirEntry& b) {
+                  return a.name < b.name;
+              });
+}
+
+// dev/inode of path, following symlinks; left at 0 when unavailable
+void fillIdentity(const fs::path& path, DirEntry& entry) {
+#if defined(_WIN32)
+    (void)path;
+    (void)entry;
+#else
+    struct stat st {};
+    if (::stat(path.c_str(), &st) == 0) {
+        entry.dev = static_cast<uint64_t>(st.st_dev);
+        entry.ino = static_cast<uint64_t>(st.st_ino);
+    }
+#endif
+}
+
+std::vector<DirEntry> listPortable(const fs::path& absPath, bool identity) {
+    std::vector<DirEntry> entries;
+
+    try {
+        for (const auto& entry : fs::directory_iterator(absPath)) {
+            if (entry.is_directory()) {
+                entries.push_back({entry.path().filename().string(),
+                                   FileType::Directory});
+            } else if (entry.is_regular_file()) {
+                entries.push_back({entry.path().filename().string(),
+                                   FileType::File,
+                                   entry.file_size(),
+                                   entry.last_write_time()});
+            } else {
+                continue;
+            }
+            if (identity) {
+                fillIdentity(entry.path(), entries.back());
+            }
+        }
+    } catch (const fs::filesystem_error&) {
+        // skip unreadable directories
+    }
+
+    return entries;
+}
+
+// re-stat of the children a cache hit says are there
+std::vector<DirEntry> restatPortable(const fs::path& absPath,
+                                     const std::vector<ScanCache::Entry>& cached,
+                                     bool identity) {
+    std::vector<DirEntry> entries;
+    entries.reserve(cached.size());
+
+    for (const auto& c : cached) {
+        if (c.type == FileType::Directory) {
+            entries.push_back({c.name, FileType::Directory, 0, {}, c.dev, c.ino});
+            if (identity && c.ino == 0) {
+                fillIdentity(absPath / c.name, entries.back());
+            }
+            continue;
+        }
+        std::error_code ec;
+        fs::directory_entry entry(absPath / c.name, ec);
+        if (ec) continue;
+        if (entry.is_directory(ec)) {
+            entries.push_back({c.name, FileType::Directory});
+        } else if (entry.is_regular_file(ec)) {
+            auto size = entry.file_size(ec);
+            if (ec) continue;
+            auto mtime = entry.last_write_time(ec);
+            if (ec) continue;
+            entries.push_back({c.name, FileType::File, size, mtime});
+        } else {
+            continue;
+        }
+        if (identity) {
+            fillIdentity(absPath / c.name, entries.back());
+        }
+    }
+    return entries;
+}
+
+#if defined(__linux__)
+
+// layout returned by the getdents64 syscall (not exported by glibc headers)
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+constexpr size_t kDirentBufferSize = 256 * 1024;
+
+struct RawStat {
+    bool isDirectory;
+    bool isRegular;
+    uintmax_t size;
+    int64_t mtimeSec;
+    int64_t mtimeNsec;
+    uint64_t dev;
+    uint64_t ino;
+};
+
+bool statAt(int dirFd, const char* name, bool follow, RawStat& out) {
+#if defined(STATX_TYPE)
+    struct statx stx {};
+    const int flags = follow ? 0 : AT_SYMLINK_NOFOLLOW;
+    // only the fields the tree keeps; lets network filesystems skip the rest
+    if (::statx(dirFd, name, flags,
+                STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO, &stx) == 0) {
+        out.isDirectory = S_ISDIR(stx.stx_mode);
+        out.isRegular = S_ISREG(stx.stx_mode);
+        out.size = stx.stx_size;
+        out.mtimeSec = stx.stx_mtime.tv_sec;
+        out.mtimeNsec = stx.stx_mtime.tv_nsec;
+        out.dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+        out.ino = stx.stx_ino;
+        return true;
+    }
+    if (errno != ENOSYS) {
+        return false;
+    }
+#endif
+    struct stat st {};
+    if (::fstatat(dirFd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) {
+        return false;
+    }
+    out.isDirectory = S_ISDIR(st.st_mode);
+    out.isRegular = S_ISREG(st.st_mode);
+    out.size = static_cast<uintmax_t>(st.st_size);
+    out.mtimeSec = st.st_mtim.tv_sec;
+    out.mtimeNsec = st.st_mtim.tv_nsec;
+    out.dev = static_cast<uint64_t>(st.st_dev);
+    out.ino = static_cast<uint64_t>(st.st_ino);
+    return true;
+}
+
+// file_time_type's epoch is implementation-defined (libstdc++ shifts it away
+// from the Unix epoch). C++20's file_clock::to_sys gives the offset exactly;
+// before that it is measured once against the standard library's own
+// conversion of the same stat result. Empty if the measurement fails.
+std::optional<std::chrono::nanoseconds> fileClockOffset() {
+    static const std::optional<std::chrono::nanoseconds> offset =
+        []() -> std::optional<std::chrono::nanoseconds> {
+#if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
+        return -std::chrono::duration_cast<std::chrono::nanoseconds>(
+            fs::file_time_type::clock::to_sys(fs::file_time_type{}).time_since_epoch());
+#else
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            struct stat before {}, after {};
+            std::error_code ec;
+            if (::stat("/", &before) != 0) break;
+            auto ft = fs::last_write_time("/", ec);
+            if (ec || ::stat("/", &after) != 0) break;
+            if (before.st_mtim.tv_sec != after.st_mtim.tv_sec ||
+                before.st_mtim.tv_nsec != after.st_mtim.tv_nsec) {
+                continue;
+            }
+            auto sys = std::chrono::seconds(before.st_mtim.tv_sec) +
+                       std::chrono::nanoseconds(before.st_mtim.tv_nsec);
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       ft.time_since_epoch()) - sys;
+        }
+        return std::nullopt;
+#endif
+    }();
+    return offset;
+}
+
+// Without the offset, raw mtimes would never equal the ones recorded by the
+// portable backend and every file would look modified, so the raw backend
+// is only used when the offset is known.
+bool rawBackendUsable() {
+    static const bool usable = [] {
+        if (fileClockOffset()) {
+            return true;
+        }
+        std::cerr << "[scan] cannot relate stat times to file_time_type; "
+                     "using the portable scan backend\n";
+        return false;
+    }();
+    return usable;
+}
+
+FileNode::FileTime toFileTime(int64_t sec, int64_t nsec) {
+    auto ns = std::chrono::seconds(sec) + std::chrono::nanoseconds(nsec) +
+              *fileClockOffset();
+    return FileNode::FileTime{
+        std::chrono::duration_cast<FileNode::FileTime::duration>(ns)};
+}
+
+DirEntry fromRawStat(const char* name, const RawStat& st) {
+    if (st.isDirectory) {
+        return {name, FileType::Directory, 0, {}, st.dev, st.ino};
+    }
+    return {name, FileType::File, st.size,
+            toFileTime(st.mtimeSec, st.mtimeNsec), st.dev, st.ino};
+}
+
+std::vector<DirEntry> listLinuxRaw(const fs::path& absPath) {
+    std::vector<DirEntry> entries;
+
+    const int dirFd = ::open(absPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        // skip unreadable directories
+        return entries;
+    }
+
+    // subdirectories found via d_type are assumed to live on the same device
+    struct stat dirStat {};
+    const uint64_t dirDev =
+        ::fstat(dirFd, &dirStat) == 0 ? static_cast<uint64_t>(dirStat.st_dev) : 0;
+
+    std::vector<char> buffer(kDirentBufferSize);
+    for (;;) {
+        const long n = ::syscall(SYS_getdents64, dirFd, buffer.data(), buffer.size());
+        if (n <= 0) {
+            break;
+        }
+
+        for (long offset = 0; offset < n;) {
+            const auto* d = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+            offset += d->d_reclen;
+
+            const char* name = d->d_name;
+            if (name[0] == '.' &&
+                (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+
+            if (d->d_type == DT_DIR) {
+                // d_type is enough; no stat needed for directories
+                entries.push_back({name, FileType::Directory, 0, {}, dirDev, d->d_ino});
+                continue;
+            }
+            if (d->d_type != DT_REG && d->d_type != DT_LNK && d->d_type != DT_UNKNOWN) {
+                continue;
+            }
+
+            // symlinks are followed, like directory_iterator's is_directory()
+            RawStat st{};
+            if (!statAt(dirFd, name, d->d_type != DT_REG, st)) {
+                continue;
+            }
+            if (st.isDirectory || st.isRegular) {
+                entries.push_back(fromRawStat(name, st));
+            }
+        }
+    }
+
+    ::close(dirFd);
+    return entries;
+}
+
+std::vector<DirEntry> restatLinuxRaw(const fs::path& absPath,
+                                     const std::vector<ScanCache::Entry>& cached) {
+    std::vector<DirEntry> entries;
+    entries.reserve(cached.size());
+
+    const int dirFd = ::open(absPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return entries;
+    }
+
+    for (const auto& c : cached) {
+        if (c.type == FileType::Directory) {
+            entries.push_back({c.name, FileType::Directory, 0, {}, c.dev, c.ino});
+            continue;
+        }
+        RawStat st{};
+        if (!statAt(dirFd, c.name.c_str(), true, st)) {
+            continue;
+        }
+        if (st.isDirectory || st.isRegular) {
+            entries.push_back(fromRawStat(c.name.c_str(), st));
+        }
+    }
+
+    ::close(dirFd);
+    return entries;
+}
+
+#endif
+
+std::vector<DirEntry> readEntries(const fs::path& absPath, const ScanOptions& options) {
+#if defined(__linux__)
+    if (options.backend == ScanBackend::LinuxRaw && rawBackendUsable()) {
+        return listLinuxRaw(absPath);
+    }
+#endif
+    return listPortable(absPath, options.identity);
+}
+
+std::vector<DirEntry> restatEntries(const fs::path& absPath,
+                                    const std::vector<ScanCache::Entry>& cached,
+                                    const ScanOptions& options) {
+#if defined(__linux__)
+    if (options.backend == ScanBackend::LinuxRaw && rawBackendUsable()) {
+        return restatLinuxRaw(absPath, cached);
+    }
+#endif
+    return restatPortable(absPath, cached, options.identity);
+}
+
+void applyFilter(std::vector<DirEntry>& entries, const std::string& relPath,
+                 const PathFilter* filter) {
+    if (!filter || filter->empty()) {
+        return;
+    }
+    std::string childPath;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&](const DirEntry& e) {
+                                     childPath = relPath == "." ? e.name : relPath + "/" + e.name;
+                                     return !filter->accepts(childPath, e.name,
+                                                             e.type == FileType::Directory);
+                                 }),
+                  entries.end());
+}
+
+} // namespace
+
+std::vector<DirEntry> listDirectory(const fs::path& absPath,
+                                    const std::string& relPath,
+                                    const ScanOptions& options) {
+    DirIdentity identity;
+    if (!options.cache || !statDirectory(absPath, identity)) {
+        auto entries = readEntries(absPath, options);
+        sortByName(entries);
+        applyFilter(entries, relPath, options.filter);
+        return entries;
+    }
+
+    std::vector<DirEntry> entries;
+    if (const auto* cached = options.cache->lookup(relPath, identity)) {
+        // cached listings are stored sorted, so a hit needs no sort
+        entries = restatEntries(absPath, *cached, options);
+    } else {
+        entries = readEntries(absPath, options);
+        sortByName(entries);
+    }
+
+    std::vector<ScanCache::Entry> listing;
+    listing.reserve(entries.size());
+    for (const auto& e : entries) {
+        listing.push_back({e.name, e.type, e.dev, e.ino});
+    }
+    // the cache keeps the unfiltered listing, so changing the rules later
+    // does not hide entries behind a cache hit
+    options.cache->record(relPath, identity, std::move(listing));
+    applyFilter(entries, relPath, options.filter);
+    return entries;
+}
+
+} // namespace backup::filesystem
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "FileNode.h"
+
+namespace backup::filesystem {
+
+class ScanCache;
+class PathFilter;
+
+/*
+ *   How directories are read during a scan.
+ *   - Portable: std::filesystem::directory_iterator
+ *   - LinuxRaw: getdents64 in large batches plus one statx per file,
+ *     relative to the directory fd; d_type avoids stats for directories.
+ *     Falls back to Portable on other platforms.
+ */
+enum class ScanBackend {
+    Portable,
+    LinuxRaw
+};
+
+/*
+ *   ScanOptions controls how a tree walks the source directory.
+ *   threads <= 1 keeps the single-threaded recursive scan; larger values
+ *   hand directories to a pool of work-stealing workers (FileTree only).
+ */
+struct ScanOptions {
+    unsigned threads = 1;
+    ScanBackend backend = ScanBackend::Portable;
+    ScanCache* cache = nullptr;   // optional, not owned; see ScanCache.h
+    // also report device/inode numbers (rename detection). Free on
+    // LinuxRaw; costs one extra stat per entry on Portable.
+    bool identity = false;
+    // optional, not owned; rejected directories are never read
+    const PathFilter* filter = nullptr;
+};
+
+/*
+ *   DirEntry is the raw result of reading one directory entry, before it
+ *   is turned into a FileNode (or a CompactFileTree node).
+ */
+struct DirEntry {
+    std::string name;
+    FileType type;
+    uintmax_t size = 0;              // valid only for file
+    FileNode::FileTime mtime{};      // valid only for file
+    uint64_t dev = 0;                // 0 when unknown
+    uint64_t ino = 0;
+};
+
+// Lists the regular files and directories directly under absPath, sorted by
+// name and passed through options.filter. Unreadable directories yield
+// whatever could be read (usually nothing).
+// relPath is the directory's path relative to the scan root ("." for the
+// root); it keys the optional scan cache.
+std::vector<DirEntry> listDirectory(const std::filesystem::path& absPath,
+                                    const std::string& relPath,
+                                    const ScanOptions& options);
+
+} // namespace backup::filesystem
@@ -1,4 +1,5 @@
 #include "FileNode.h"
+#include <algorithm>
 #include <cassert>
 
 namespace backup::filesystem {
@@ -39,10 +40,39 @@ FileNode::FileTime FileNode::getMTime() const noexcept {
     return mtime_;
 }
 
+void FileNode::setIdentity(uint64_t dev, uint64_t ino) noexcept {
+    dev_ = dev;
+    ino_ = ino;
+}
+
+uint64_t FileNode::getDevice() const noexcept {
+    return dev_;
+}
+
+uint64_t FileNode::getInode() const noexcept {
+    return ino_;
+}
+
+void FileNode::setHash(uint64_t hash) noexcept {
+    hash_ = hash;
+}
+
+uint64_t FileNode::getHash() const noexcept {
+    return hash_;
+}
+
 void FileNode::addChild(std::shared_ptr<FileNode> child) {
     children_.push_back(std::move(child));
 }
 
+void FileNode::sortChildren() {
+    std::sort(children_.begin(), children_.end(),
+              [](const std::shared_ptr<FileNode>& a,
+                 const std::shared_ptr<FileNode>& b) {
+                  return a->getName() < b->getName();
+              });
+}
+
 const std::vector<std::shared_ptr<FileNode>>&
 FileNode::getChildren() const noexcept {
     return children_;
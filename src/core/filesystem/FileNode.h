@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
@@ -35,7 +36,19 @@ public:
     uintmax_t getSize() const; // valid only for file
     FileTime getMTime() const noexcept;
 
+    // device/inode seen by the scan, 0 when unknown; used to pair renames
+    void setIdentity(uint64_t dev, uint64_t ino) noexcept;
+    uint64_t getDevice() const noexcept;
+    uint64_t getInode() const noexcept;
+
+    // files: content fingerprint (util::fingerprintFile);
+    // directories: subtree hash (FileTree::computeSubtreeHashes).
+    // 0 when unknown
+    void setHash(uint64_t hash) noexcept;
+    uint64_t getHash() const noexcept;
+
     void addChild(std::shared_ptr<FileNode> child);
+    void sortChildren();   // by name, the order FileTree::build produces
     const std::vector<std::shared_ptr<FileNode>>& getChildren() const noexcept;
 
 private:
@@ -44,7 +57,9 @@ private:
     FileType type_;
     uintmax_t size_;       
     FileTime mtime_;
-
+    uint64_t dev_ = 0;
+    uint64_t ino_ = 0;
+    uint64_t hash_ = 0;
 
     std::vector<std::shared_ptr<FileNode>> children_;
 };
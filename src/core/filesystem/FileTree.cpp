@@ -1,11 +1,97 @@
 #include "FileTree.h"
+#include "util/TimeUtils.h"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
 namespace backup::filesystem {
 namespace fs = std::filesystem;
 
-FileTree::FileTree(const fs::path& rootPath)
-    : rootPath_(rootPath) {}
+namespace {
+
+uint64_t hashSubtree(FileNode& dir) {
+    SubtreeHasher hasher;
+    for (const auto& child : dir.getChildren()) {
+        if (child->isDirectory()) {
+            hasher.addDirectory(child->getName(), hashSubtree(*child));
+        } else {
+            hasher.addFile(child->getName(), child->getSize(),
+                           util::fileTimeToInt64(child->getMTime()));
+        }
+    }
+    const uint64_t h = hasher.digest();
+    dir.setHash(h);
+    return h;
+}
+
+struct ScanTask {
+    fs::path absPath;
+    std::shared_ptr<FileNode> dir;
+};
+
+// Per-worker deque of pending directories. The owner pushes and pops at the
+// back (depth-first, warm caches); idle workers steal from the front, which
+// holds the oldest and usually largest subtrees.
+class WorkQueue {
+public:
+    void push(ScanTask task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+
+    bool pop(ScanTask& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) return false;
+        out = std::move(tasks_.back());
+        tasks_.pop_back();
+        return true;
+    }
+
+    bool steal(ScanTask& out) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) return false;
+        out = std::move(tasks_.front());
+        tasks_.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<ScanTask> tasks_;
+};
+
+} // namespace
+
+void SubtreeHasher::addName(std::string_view name) {
+    // the terminator keeps ("ab", "c") and ("a", "bc") apart
+    const char terminator = '\0';
+    hasher_.update(name.data(), name.size());
+    hasher_.update(&terminator, 1);
+}
+
+void SubtreeHasher::addFile(std::string_view name, uint64_t size, int64_t mtimeNs) {
+    addName(name);
+    const uint64_t fields[2] = {size + 1, static_cast<uint64_t>(mtimeNs)};
+    hasher_.update(fields, sizeof(fields));
+}
+
+void SubtreeHasher::addDirectory(std::string_view name, uint64_t subtreeHash) {
+    addName(name);
+    // a zero where files have size + 1 marks the entry as a directory
+    const uint64_t fields[2] = {0, subtreeHash};
+    hasher_.update(fields, sizeof(fields));
+}
+
+uint64_t SubtreeHasher::digest() const {
+    const uint64_t h = hasher_.digest();
+    return h == 0 ? 1 : h;
+}
+
+FileTree::FileTree(const fs::path& rootPath, ScanOptions options)
+    : rootPath_(rootPath), options_(options) {}
 
 void FileTree::build() {
     if (!fs::exists(rootPath_) || !fs::is_directory(rootPath_)) {
@@ -18,38 +104,107 @@ void FileTree::build() {
         FileType::Directory
     );
 
-    buildRecursive(rootPath_, root_);
+    if (options_.threads > 1) {
+        buildParallel(options_.threads);
+    } else {
+        buildRecursive(rootPath_, root_);
+    }
+
+    computeSubtreeHashes();
+}
+
+void FileTree::computeSubtreeHashes() {
+    if (root_) {
+        hashSubtree(*root_);
+    }
+}
+
+std::vector<std::shared_ptr<FileNode>>
+FileTree::readDirectory(const fs::path& absPath, const FileNode& parent) const {
+    std::vector<std::shared_ptr<FileNode>> children;
+    const std::string& parentRel = parent.getRelativePath();
+
+    for (auto& entry : listDirectory(absPath, parentRel, options_)) {
+        auto rel = parentRel == "." ? entry.name : parentRel + "/" + entry.name;
+        auto node = std::make_shared<FileNode>(
+            std::move(entry.name),
+            std::move(rel),
+            entry.type,
+            entry.size,
+            entry.mtime
+        );
+        node->setIdentity(entry.dev, entry.ino);
+        children.push_back(std::move(node));
+    }
+    return children;
 }
 
 void FileTree::buildRecursive(const fs::path& absPath,
                               const std::shared_ptr<FileNode>& parent) {
-    try {
-        for (const auto& entry : fs::directory_iterator(absPath)) {
-            const auto& p = entry.path();
-            auto rel = fs::relative(p, rootPath_).generic_string();
-
-            if (entry.is_directory()) {
-                auto dir = std::make_shared<FileNode>(
-                    p.filename().string(),
-                    rel,
-                    FileType::Directory
-                );
-                parent->addChild(dir);
-                buildRecursive(p, dir);
-            } else if (entry.is_regular_file()) {
-                auto file = std::make_shared<FileNode>(
-                    p.filename().string(),
-                    rel,
-                    FileType::File,
-                    entry.file_size(),
-                    entry.last_write_time()
-                );
-                parent->addChild(file);
+    for (auto& child : readDirectory(absPath, *parent)) {
+        parent->addChild(child);
+        if (child->isDirectory()) {
+            buildRecursive(absPath / child->getName(), child);
+        }
+    }
+}
+
+void FileTree::buildParallel(unsigned threads) {
+    std::vector<WorkQueue> queues(threads);
+    // directories queued or being read; workers exit once it reaches zero
+    std::atomic<size_t> pending{1};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    queues[0].push({rootPath_, root_});
+
+    auto worker = [&](unsigned id) {
+        ScanTask task;
+        while (pending.load(std::memory_order_acquire) > 0) {
+            bool found = queues[id].pop(task);
+            for (unsigned k = 1; !found && k < threads; ++k) {
+                found = queues[(id + k) % threads].steal(task);
+            }
+            if (!found) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            try {
+                // only the worker holding the task touches task.dir, so
+                // children need no locking; order comes from readDirectory
+                for (auto& child : readDirectory(task.absPath, *task.dir)) {
+                    task.dir->addChild(child);
+                    if (child->isDirectory()) {
+                        pending.fetch_add(1, std::memory_order_relaxed);
+                        queues[id].push({task.absPath / child->getName(), child});
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!error) error = std::current_exception();
             }
+            task = ScanTask{};
+            pending.fetch_sub(1, std::memory_order_acq_rel);
         }
-    } catch (const fs::filesystem_error&) {
-        // skip unreadable directories
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        pool.emplace_back(worker, i);
+    }
+    for (auto& t : pool) {
+        t.join();
     }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void FileTree::setRoot(std::shared_ptr<FileNode> root) {
+    root_ = std::move(root);
 }
 
 std::shared_ptr<FileNode> FileTree::getRoot() const noexcept {
@@ -60,6 +215,10 @@ const fs::path& FileTree::getRootPath() const noexcept {
     return rootPath_;
 }
 
+const ScanOptions& FileTree::getScanOptions() const noexcept {
+    return options_;
+}
+
 void FileTree::traverseDFS(
     const std::function<void(const FileNode&)>& visitor) const {
     if (root_) {
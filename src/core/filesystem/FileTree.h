@@ -2,31 +2,72 @@
 #include <filesystem>
 #include <memory>
 #include <functional>
+#include <string_view>
+#include <vector>
 #include "FileNode.h"
+#include "DirectoryLister.h"
+#include "util/Hash.h"
 
 namespace backup::filesystem {
 
+/*
+ *   SubtreeHasher hashes one directory's listing, fed child by child in
+ *   name order. FileTree and CompactFileTree both use it, so they agree on
+ *   every subtree hash and on what ends up in .backupmeta.
+ */
+class SubtreeHasher {
+public:
+    void addFile(std::string_view name, uint64_t size, int64_t mtimeNs);
+    void addDirectory(std::string_view name, uint64_t subtreeHash);
+    uint64_t digest() const;   // never 0, which means "unknown"
+
+private:
+    util::XxHash64 hasher_;
+
+    void addName(std::string_view name);
+};
+
 class FileTree {
 public:
-    explicit FileTree(const std::filesystem::path& rootPath);
+    explicit FileTree(const std::filesystem::path& rootPath,
+                      ScanOptions options = {});
 
     FileTree(const FileTree&) = delete;
     FileTree& operator=(const FileTree&) = delete;
 
     void build();
 
+    // adopts a tree assembled elsewhere (e.g. from backup metadata)
+    // instead of scanning rootPath
+    void setRoot(std::shared_ptr<FileNode> root);
+
     std::shared_ptr<FileNode> getRoot() const noexcept;
     const std::filesystem::path& getRootPath() const noexcept;
+    const ScanOptions& getScanOptions() const noexcept;
 
     void traverseDFS(const std::function<void(const FileNode&)>& visitor) const;
 
+    // Bottom-up hash of every directory over its children's (name, type,
+    // size, mtime), folding in each subdirectory's own hash. Equal hashes
+    // mean equal subtrees, so a diff can skip them. build() calls this.
+    void computeSubtreeHashes();
+
 private:
     std::filesystem::path rootPath_;
+    ScanOptions options_;
     std::shared_ptr<FileNode> root_;
 
+    // children of one directory, sorted by name so that the tree shape
+    // does not depend on readdir order or on which worker read it
+    std::vector<std::shared_ptr<FileNode>>
+    readDirectory(const std::filesystem::path& absPath,
+                  const FileNode& parent) const;
+
     void buildRecursive(const std::filesystem::path& absPath,
                         const std::shared_ptr<FileNode>& parent);
 
+    void buildParallel(unsigned threads);
+
     void traverseDFSRecursive(const std::shared_ptr<FileNode>& node,
                               const std::function<void(const FileNode&)>& visitor) const;
 };
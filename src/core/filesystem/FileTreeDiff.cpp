@@ -1,69 +1,441 @@
 #include "FileTreeDiff.h"
+#include "util/Hash.h"
 #include <algorithm>
+#include <iterator>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace backup::filesystem {
 
+namespace {
+
+bool isUnder(const std::string& path, const std::string& root) {
+    return path.size() > root.size() && path[root.size()] == '/' &&
+           path.compare(0, root.size(), root) == 0;
+}
+
+std::string parentOf(const std::string& path) {
+    const auto slash = path.rfind('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+struct IdentityHash {
+    size_t operator()(const std::pair<uint64_t, uint64_t>& id) const noexcept {
+        return std::hash<uint64_t>{}(id.first * 0x9E3779B97F4A7C15ULL ^ id.second);
+    }
+};
+
+// the node's stored fingerprint, computed from contentRoot when missing
+uint64_t fingerprintOf(FileNode& node, const std::filesystem::path& contentRoot) {
+    if (node.getHash() == 0 && !contentRoot.empty()) {
+        try {
+            node.setHash(util::fingerprintFile(contentRoot / node.getRelativePath()));
+        } catch (const std::exception&) {
+            // unreadable: stays unknown and never matches
+        }
+    }
+    return node.getHash();
+}
+
+bool sameSubtree(const FileNode& a, const FileNode& b) {
+    return a.getHash() != 0 && a.getHash() == b.getHash();
+}
+
+// Copies file fingerprints from old to new wherever the file is unchanged.
+void inheritHashes(const FileNode& oldDir, const FileNode& newDir,
+                   bool (*isSameFile)(const FileNode&, const FileNode&)) {
+    const auto& o = oldDir.getChildren();
+    const auto& n = newDir.getChildren();
+    auto oi = o.begin(), ni = n.begin();
+
+    while (oi != o.end() && ni != n.end()) {
+        int cmp = (*oi)->getName().compare((*ni)->getName());
+        if (cmp < 0) {
+            ++oi;
+        } else if (cmp > 0) {
+            ++ni;
+        } else {
+            const auto& a = *oi++;
+            const auto& b = *ni++;
+            if (a->isDirectory() && b->isDirectory()) {
+                inheritHashes(*a, *b, isSameFile);
+            } else if (a->isFile() && b->isFile() && b->getHash() == 0 &&
+                       isSameFile(*a, *b)) {
+                b->setHash(a->getHash());
+            }
+        }
+    }
+}
+
+// Merge-join of two FileTrees: both child lists are sorted by name, so they
+// are walked in lockstep and only the recursion stack is kept. Directories
+// with equal subtree hashes are not descended into.
+class NodeDiffer {
+public:
+    using Node = std::shared_ptr<FileNode>;
+
+    explicit NodeDiffer(const FileTreeDiff::ChangeVisitor& visitor,
+                        bool (*isSameFile)(const FileNode&, const FileNode&))
+        : visitor_(visitor), isSameFile_(isSameFile) {}
+
+    void compareChildren(const FileNode& oldDir, const FileNode& newDir) {
+        const auto& o = oldDir.getChildren();
+        const auto& n = newDir.getChildren();
+        auto oi = o.begin(), ni = n.begin();
+
+        while (oi != o.end() || ni != n.end()) {
+            int cmp = oi == o.end() ? 1
+                    : ni == n.end() ? -1
+                    : (*oi)->getName().compare((*ni)->getName());
+            if (cmp < 0) {
+                emitSubtree(ChangeType::Removed, *oi++);
+            } else if (cmp > 0) {
+                emitSubtree(ChangeType::Added, *ni++);
+            } else {
+                compareNode(*oi++, *ni++);
+            }
+        }
+    }
+
+    void emitSubtree(ChangeType type, const Node& node) {
+        if (type == ChangeType::Added) {
+            visitor_({type, node->getRelativePath(), nullptr, node});
+        } else {
+            visitor_({type, node->getRelativePath(), node, nullptr});
+        }
+        for (const auto& child : node->getChildren()) {
+            emitSubtree(type, child);
+        }
+    }
+
+private:
+    const FileTreeDiff::ChangeVisitor& visitor_;
+    bool (*isSameFile_)(const FileNode&, const FileNode&);
+
+    void compareNode(const Node& a, const Node& b) {
+        if (a->isDirectory() != b->isDirectory()) {
+            emitSubtree(ChangeType::Removed, a);
+            emitSubtree(ChangeType::Added, b);
+        } else if (a->isFile()) {
+            if (!isSameFile_(*a, *b)) {
+                visitor_({ChangeType::Modified, b->getRelativePath(), a, b});
+            }
+        } else if (!sameSubtree(*a, *b)) {
+            compareChildren(*a, *b);
+        }
+    }
+};
+
+// Same walk over the index ranges of two flat trees.
+class CompactDiffer {
+public:
+    using Index = CompactFileTree::Index;
+
+    CompactDiffer(const CompactFileTree& oldTree,
+                  const CompactFileTree& newTree,
+                  const FileTreeDiff::ChangeVisitor& visitor)
+        : oldTree_(oldTree), newTree_(newTree), visitor_(visitor) {}
+
+    void compareChildren(Index oldDir, Index newDir) {
+        const auto& o = oldTree_.node(oldDir);
+        const auto& n = newTree_.node(newDir);
+        Index oi = o.firstChild, oe = o.firstChild + o.childCount;
+        Index ni = n.firstChild, ne = n.firstChild + n.childCount;
+
+        while (oi < oe || ni < ne) {
+            int cmp = oi == oe ? 1
+                    : ni == ne ? -1
+                    : oldTree_.name(oi).compare(newTree_.name(ni));
+            if (cmp < 0) {
+                emitSubtree(ChangeType::Removed, oldTree_, oi++);
+            } else if (cmp > 0) {
+                emitSubtree(ChangeType::Added, newTree_, ni++);
+            } else {
+                compareNode(oi++, ni++);
+            }
+        }
+    }
+
+    void emitChildren(ChangeType type, const CompactFileTree& tree, Index dir) {
+        const auto& n = tree.node(dir);
+        for (Index c = 0; c < n.childCount; ++c) {
+            emitSubtree(type, tree, n.firstChild + c);
+        }
+    }
+
+private:
+    const CompactFileTree& oldTree_;
+    const CompactFileTree& newTree_;
+    const FileTreeDiff::ChangeVisitor& visitor_;
+
+    void compareNode(Index oi, Index ni) {
+        const auto& a = oldTree_.node(oi);
+        const auto& b = newTree_.node(ni);
+
+        if (a.type != b.type) {
+            emitSubtree(ChangeType::Removed, oldTree_, oi);
+            emitSubtree(ChangeType::Added, newTree_, ni);
+        } else if (a.isFile()) {
+            if (a.size != b.size || a.mtimeNs != b.mtimeNs) {
+                visitor_({ChangeType::Modified,
+                          newTree_.relativePath(ni),
+                          oldTree_.toFileNode(oi),
+                          newTree_.toFileNode(ni)});
+            }
+        } else if (a.hash == 0 || a.hash != b.hash) {
+            compareChildren(oi, ni);
+        }
+    }
+
+    void emitSubtree(ChangeType type, const CompactFileTree& tree, Index i) {
+        auto node = tree.toFileNode(i);
+        auto path = node->getRelativePath();
+        if (type == ChangeType::Added) {
+            visitor_({type, std::move(path), nullptr, std::move(node)});
+        } else {
+            visitor_({type, std::move(path), std::move(node), nullptr});
+        }
+        emitChildren(type, tree, i);
+    }
+};
+
+} // namespace
+
+void FileTreeDiff::diff(const FileTree& oldTree, const FileTree& newTree,
+                        const ChangeVisitor& visitor) {
+    auto oldRoot = oldTree.getRoot();
+    auto newRoot = newTree.getRoot();
+    NodeDiffer differ(visitor, &FileTreeDiff::isSameFile);
+
+    if (oldRoot && newRoot) {
+        if (!sameSubtree(*oldRoot, *newRoot)) {
+            differ.compareChildren(*oldRoot, *newRoot);
+        }
+    } else if (newRoot) {
+        for (const auto& child : newRoot->getChildren()) {
+            differ.emitSubtree(ChangeType::Added, child);
+        }
+    } else if (oldRoot) {
+        for (const auto& child : oldRoot->getChildren()) {
+            differ.emitSubtree(ChangeType::Removed, child);
+        }
+    }
+}
+
 std::vector<FileChange>
 FileTreeDiff::diff(const FileTree& oldTree, const FileTree& newTree) {
-    auto oldMap = flatten(oldTree);
-    auto newMap = flatten(newTree);
+    std::vector<FileChange> changes;
+    diff(oldTree, newTree, [&changes](const FileChange& change) {
+        changes.push_back(change);
+    });
+    return changes;
+}
 
+void FileTreeDiff::diff(const CompactFileTree& oldTree, const CompactFileTree& newTree,
+                        const ChangeVisitor& visitor) {
+    CompactDiffer differ(oldTree, newTree, visitor);
+    if (!oldTree.empty() && !newTree.empty()) {
+        const auto oldHash = oldTree.node(oldTree.root()).hash;
+        if (oldHash == 0 || oldHash != newTree.node(newTree.root()).hash) {
+            differ.compareChildren(oldTree.root(), newTree.root());
+        }
+    } else if (!newTree.empty()) {
+        differ.emitChildren(ChangeType::Added, newTree, newTree.root());
+    } else if (!oldTree.empty()) {
+        differ.emitChildren(ChangeType::Removed, oldTree, oldTree.root());
+    }
+}
+
+std::vector<FileChange>
+FileTreeDiff::diff(const CompactFileTree& oldTree, const CompactFileTree& newTree) {
     std::vector<FileChange> changes;
+    diff(oldTree, newTree, [&changes](const FileChange& change) {
+        changes.push_back(change);
+    });
+    return changes;
+}
 
-    // Removed / Modified
-    for (const auto& kv : oldMap) {
-        const auto& path = kv.first;
-        const auto& oldNode = kv.second;
+void FileTreeDiff::detectRenames(std::vector<FileChange>& changes,
+                                 const RenameOptions& options) {
+    using Identity = std::pair<uint64_t, uint64_t>;
 
-        auto it = newMap.find(path);
-        if (it == newMap.end()) {
-            changes.push_back(
-                {ChangeType::Removed, path, oldNode, nullptr});
-        } else if (oldNode->isFile() &&
-                   !isSameFile(*oldNode, *it->second)) {
-            changes.push_back(
-                {ChangeType::Modified, path, oldNode, it->second});
+    // a Removed/Added node's descendants follow it contiguously, so each
+    // subtree is the index range [i, subtreeEnd[i])
+    std::vector<size_t> subtreeEnd(changes.size());
+    std::vector<size_t> open;
+    std::unordered_set<std::string> removedPaths, addedPaths;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        const auto& c = changes[i];
+        while (!open.empty() && !(changes[open.back()].type == c.type &&
+                                  isUnder(c.relativePath, changes[open.back()].relativePath))) {
+            subtreeEnd[open.back()] = i;
+            open.pop_back();
         }
+        subtreeEnd[i] = i + 1;
+        if (c.type == ChangeType::Removed) {
+            removedPaths.insert(c.relativePath);
+            open.push_back(i);
+        } else if (c.type == ChangeType::Added) {
+            addedPaths.insert(c.relativePath);
+            open.push_back(i);
+        }
+    }
+    for (size_t i : open) {
+        subtreeEnd[i] = changes.size();
     }
 
-    // Added
-    for (const auto& kv : newMap) {
-        const auto& path = kv.first;
-        if (oldMap.find(path) == oldMap.end()) {
-            changes.push_back(
-                {ChangeType::Added, path, nullptr, kv.second});
+    std::unordered_map<Identity, size_t, IdentityHash> byInode;
+    std::map<std::pair<uintmax_t, int64_t>, std::vector<size_t>> byStat;
+    for (size_t r = 0; r < changes.size(); ++r) {
+        if (changes[r].type != ChangeType::Removed ||
+            addedPaths.count(changes[r].relativePath)) {
+            continue; // type changes are never paired
+        }
+        const auto& node = *changes[r].oldNode;
+        if (options.matchInode && node.getInode() != 0) {
+            byInode.emplace(Identity{node.getDevice(), node.getInode()}, r);
+        }
+        // empty files all share one fingerprint; pairing them saves nothing
+        if (options.matchFingerprint && node.isFile() && node.getSize() > 0) {
+            byStat[{node.getSize(), node.getMTime().time_since_epoch().count()}]
+                .push_back(r);
         }
     }
 
-    std::sort(changes.begin(), changes.end(),
-              [](const FileChange& a, const FileChange& b) {
-                  return a.relativePath < b.relativePath;
-              });
+    // paired Removed subtrees must not nest, or one rename would carry
+    // the other's source along
+    std::map<size_t, size_t> taken;   // first -> last of each used range
+    auto available = [&](size_t r) {
+        auto next = taken.upper_bound(r);
+        if (next != taken.end() && next->first < subtreeEnd[r]) {
+            return false;   // a used range lies inside r's subtree
+        }
+        return next == taken.begin() || std::prev(next)->second <= r;
+    };
 
-    return changes;
-}
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t a = 0; a < changes.size();) {
+        if (changes[a].type != ChangeType::Added ||
+            removedPaths.count(changes[a].relativePath)) {
+            ++a;
+            continue;
+        }
+        auto& node = *changes[a].newNode;
 
-FileTreeDiff::NodeMap
-FileTreeDiff::flatten(const FileTree& tree) {
-    NodeMap map;
+        size_t match = changes.size();
+        if (options.matchInode && node.getInode() != 0) {
+            auto it = byInode.find({node.getDevice(), node.getInode()});
+            if (it != byInode.end() && available(it->second) &&
+                changes[it->second].oldNode->isDirectory() == node.isDirectory()) {
+                match = it->second;
+            }
+        }
+        if (match == changes.size() && options.matchFingerprint &&
+            node.isFile() && node.getSize() > 0) {
+            auto it = byStat.find({node.getSize(), node.getMTime().time_since_epoch().count()});
+            const uint64_t fp = it == byStat.end()
+                                    ? 0 : fingerprintOf(node, options.newContentRoot);
+            if (fp != 0) {
+                for (size_t r : it->second) {
+                    if (available(r) &&
+                        fingerprintOf(*changes[r].oldNode, options.oldContentRoot) == fp) {
+                        match = r;
+                        break;
+                    }
+                }
+            }
+        }
 
-    auto root = tree.getRoot();
-    if (!root) return map;
+        if (match == changes.size()) {
+            ++a;
+            continue;
+        }
+        taken.emplace(match, subtreeEnd[match]);
+        pairs.emplace_back(match, a);
+        // the pair's sub-diff covers everything beneath it
+        a = subtreeEnd[a];
+    }
 
-    std::function<void(const std::shared_ptr<FileNode>&)> dfs;
-    dfs = [&](const std::shared_ptr<FileNode>& node) {
-        if (node->getRelativePath() != ".") {
-            map.emplace(node->getRelativePath(), node);
+    if (pairs.empty()) {
+        return;
+    }
+
+    std::vector<bool> replaced(changes.size(), false);
+    std::vector<FileChange> result;
+    for (const auto& [r, a] : pairs) {
+        std::fill(replaced.begin() + r, replaced.begin() + subtreeEnd[r], true);
+        std::fill(replaced.begin() + a, replaced.begin() + subtreeEnd[a], true);
+
+        const auto& oldNode = changes[r].oldNode;
+        const auto& newNode = changes[a].newNode;
+        const std::string& oldPath = changes[r].relativePath;
+        const std::string& newPath = changes[a].relativePath;
+
+        result.push_back({parentOf(oldPath) == parentOf(newPath) ? ChangeType::Renamed
+                                                                 : ChangeType::Moved,
+                          newPath, oldNode, newNode, oldPath});
+
+        if (newNode->isFile()) {
+            if (!isSameFile(*oldNode, *newNode)) {
+                result.push_back({ChangeType::Modified, newPath, oldNode, newNode});
+            } else if (newNode->getHash() == 0) {
+                newNode->setHash(oldNode->getHash());
+            }
+            continue;
         }
-        if (node->isDirectory()) {
-            for (const auto& c : node->getChildren()) {
-                dfs(c);
+
+        inheritHashes(*oldNode, *newNode, &FileTreeDiff::isSameFile);
+
+        // contents are compared in place; what the old subtree loses is
+        // removed from where it now lives
+        const ChangeVisitor relocate = [&](const FileChange& change) {
+            FileChange moved = change;
+            if (moved.type == ChangeType::Removed) {
+                moved.relativePath = newPath + moved.relativePath.substr(oldPath.size());
             }
+            result.push_back(std::move(moved));
+        };
+        NodeDiffer differ(relocate, &FileTreeDiff::isSameFile);
+        differ.compareChildren(*oldNode, *newNode);
+    }
+
+    for (size_t i = 0; i < changes.size(); ++i) {
+        if (!replaced[i]) {
+            result.push_back(std::move(changes[i]));
         }
-    };
+    }
+
+    std::stable_sort(result.begin(), result.end(),
+                     [](const FileChange& x, const FileChange& y) {
+                         return pathLess(x.relativePath, y.relativePath);
+                     });
+    changes = std::move(result);
+}
 
-    dfs(root);
-    return map;
+void FileTreeDiff::inheritFingerprints(const FileTree& oldTree, const FileTree& newTree) {
+    if (oldTree.getRoot() && newTree.getRoot()) {
+        inheritHashes(*oldTree.getRoot(), *newTree.getRoot(), &FileTreeDiff::isSameFile);
+    }
+}
+
+bool FileTreeDiff::pathLess(const std::string& a, const std::string& b) {
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size()) {
+        size_t ie = a.find('/', i);
+        size_t je = b.find('/', j);
+        if (ie == std::string::npos) ie = a.size();
+        if (je == std::string::npos) je = b.size();
+
+        int cmp = a.compare(i, ie - i, b, j, je - j);
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+        i = ie + 1;
+        j = je + 1;
+    }
+    // a parent sorts before everything beneath it
+    return i >= a.size() && j < b.size();
 }
 
 bool FileTreeDiff::isSameFile(const FileNode& a, const FileNode& b) {
@@ -1,35 +1,93 @@
 #pragma once
-#include <unordered_map>
+#include <functional>
 #include <vector>
 #include <string>
 #include <memory>
 #include "FileTree.h"
+#include "CompactFileTree.h"
 
 namespace backup::filesystem {
 
 enum class ChangeType {
     Added,
     Removed,
-    Modified
+    Modified,
+    Renamed,   // same parent directory, new name
+    Moved      // different parent directory
 };
 
 struct FileChange {
     ChangeType type;
-    std::string relativePath;
+    std::string relativePath;        // new location for Renamed/Moved
     std::shared_ptr<FileNode> oldNode;
     std::shared_ptr<FileNode> newNode;
+    std::string oldRelativePath{};   // Renamed/Moved only
 };
 
+/*
+ *   RenameOptions controls how FileTreeDiff::detectRenames pairs a removed
+ *   path with an added one.
+ */
+struct RenameOptions {
+    // same (dev, ino) on both sides
+    bool matchInode = true;
+    // files with equal size, mtime and content fingerprint; catches moves
+    // that changed the inode (across filesystems, copy + delete)
+    bool matchFingerprint = true;
+    // where fingerprints missing from the nodes may be computed from file
+    // content; empty means that side is never read
+    std::filesystem::path oldContentRoot;
+    std::filesystem::path newContentRoot;
+};
+
+/*
+ *   FileTreeDiff merge-joins two trees whose children are sorted by name
+ *   (as FileTree::build and BackupMetadata::buildTree produce). Both trees
+ *   are walked in lockstep, so memory is O(depth). Directories whose
+ *   subtree hashes (FileTree::computeSubtreeHashes) are equal and nonzero
+ *   are skipped without looking inside.
+ *
+ *   Changes come out in pre-order: a directory before its contents,
+ *   siblings by name (see pathLess). A path whose type changed yields a
+ *   Removed subtree followed by an Added subtree.
+ */
 class FileTreeDiff {
 public:
+    using ChangeVisitor = std::function<void(const FileChange&)>;
+
+    static void diff(const FileTree& oldTree, const FileTree& newTree,
+                     const ChangeVisitor& visitor);
+
     static std::vector<FileChange>
     diff(const FileTree& oldTree, const FileTree& newTree);
 
-private:
-    using NodeMap =
-        std::unordered_map<std::string, std::shared_ptr<FileNode>>;
+    // same result for flat trees; nodes in FileChange are detached copies
+    static void diff(const CompactFileTree& oldTree, const CompactFileTree& newTree,
+                     const ChangeVisitor& visitor);
 
-    static NodeMap flatten(const FileTree& tree);
+    static std::vector<FileChange>
+    diff(const CompactFileTree& oldTree, const CompactFileTree& newTree);
+
+    // Post-pass over a diff result: a Removed node and an Added node that
+    // are the same file or directory become a single Renamed/Moved change
+    // followed by the diff between the two subtrees (with Removed paths
+    // reported under the new location). Paired subtrees never nest and
+    // paths whose type changed are never paired, so the renames can be
+    // applied in any order, before every other change. The result stays
+    // in pathLess order.
+    static void detectRenames(std::vector<FileChange>& changes,
+                              const RenameOptions& options = {});
+
+    // Unchanged files keep the content fingerprint recorded for them last
+    // time. Walks every path present in both trees, including subtrees
+    // that diff() skips.
+    static void inheritFingerprints(const FileTree& oldTree, const FileTree& newTree);
+
+    // order in which changes are emitted: component-wise comparison of
+    // relative paths, i.e. pre-order over name-sorted children
+    static bool pathLess(const std::string& a, const std::string& b);
+
+private:
     static bool isSameFile(const FileNode& a, const FileNode& b);
 };
 
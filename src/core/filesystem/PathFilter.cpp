@@ -0,0 +1,232 @@
+#include "PathFilter.h"
+#include <algorithm>
+
+namespace backup::filesystem {
+
+namespace {
+
+bool hasWildcard(std::string_view s) {
+    return s.find_first_of("*?[\\") != std::string_view::npos;
+}
+
+// matches one character against the pattern element at pat[p], advancing p
+bool matchChar(std::string_view pat, size_t& p, char c) {
+    if (pat[p] == '?') {
+        ++p;
+        return true;
+    }
+    if (pat[p] == '\\' && p + 1 < pat.size()) {
+        p += 2;
+        return pat[p - 1] == c;
+    }
+    if (pat[p] == '[') {
+        size_t q = p + 1;
+        const bool negate = q < pat.size() && (pat[q] == '!' || pat[q] == '^');
+        if (negate) ++q;
+        const size_t first = q;
+        bool found = false;
+        // a ']' right after the opening bracket is a literal
+        while (q < pat.size() && (pat[q] != ']' || q == first)) {
+            if (q + 2 < pat.size() && pat[q + 1] == '-' && pat[q + 2] != ']') {
+                found |= pat[q] <= c && c <= pat[q + 2];
+                q += 3;
+            } else {
+                found |= pat[q] == c;
+                ++q;
+            }
+        }
+        if (q < pat.size()) {
+            p = q + 1;
+            return found != negate;
+        }
+        // no closing bracket: '[' is an ordinary character
+    }
+    ++p;
+    return pat[p - 1] == c;
+}
+
+// glob match of one path component; '*' never crosses a '/'
+bool matchSegment(std::string_view pat, std::string_view str) {
+    size_t p = 0, s = 0;
+    size_t starP = std::string_view::npos, starS = 0;
+    while (s < str.size()) {
+        if (p < pat.size() && pat[p] == '*') {
+            starP = p++;
+            starS = s;
+            continue;
+        }
+        size_t next = p;
+        if (p < pat.size() && matchChar(pat, next, str[s])) {
+            p = next;
+            ++s;
+            continue;
+        }
+        if (starP == std::string_view::npos) {
+            return false;
+        }
+        // let the last '*' swallow one more character
+        p = starP + 1;
+        s = ++starS;
+    }
+    while (p < pat.size() && pat[p] == '*') ++p;
+    return p == pat.size();
+}
+
+// "**" spans zero or more components. As with '*' in matchSegment, only the
+// last "**" seen is ever retried, so this is O(segments * components) however
+// many "**" the pattern has.
+bool matchSegments(const std::vector<std::string>& segs,
+                   const std::vector<std::string_view>& comps) {
+    size_t si = 0, ci = 0;
+    size_t starSi = std::string::npos, starCi = 0;
+    while (ci < comps.size()) {
+        if (si < segs.size() && segs[si] == "**") {
+            starSi = si++;
+            starCi = ci;
+            continue;
+        }
+        if (si < segs.size() && matchSegment(segs[si], comps[ci])) {
+            ++si;
+            ++ci;
+            continue;
+        }
+        if (starSi == std::string::npos) {
+            return false;
+        }
+        // let the last "**" swallow one more component
+        si = starSi + 1;
+        ci = ++starCi;
+    }
+    while (si < segs.size() && segs[si] == "**") ++si;
+    return si == segs.size();
+}
+
+std::vector<std::string_view> splitPath(std::string_view path) {
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t end = path.find('/', start);
+        if (end == std::string_view::npos) end = path.size();
+        if (end > start) parts.push_back(path.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+} // namespace
+
+void PathFilter::RuleSet::add(std::string pattern) {
+    Glob glob;
+    if (!pattern.empty() && pattern.back() == '/') {
+        glob.directoryOnly = true;
+        pattern.pop_back();
+    }
+    if (!pattern.empty() && pattern.front() == '/') {
+        glob.anchored = true;
+        pattern.erase(0, 1);
+    }
+    if (pattern.empty()) {
+        return;
+    }
+    if (pattern.find('/') != std::string::npos) {
+        glob.anchored = true;
+    }
+
+    if (!glob.anchored) {
+        if (!hasWildcard(pattern)) {
+            (glob.directoryOnly ? directoryNames : names).insert(pattern);
+            return;
+        }
+        if (!glob.directoryOnly && pattern[0] == '*' && !hasWildcard(pattern.substr(1)) &&
+            pattern.size() > 1) {
+            const std::string suffix = pattern.substr(1);
+            if (suffixes.count(suffix)) {
+                return;
+            }
+            suffixes.insert(suffixText.emplace_back(suffix));
+            if (std::find(suffixLengths.begin(), suffixLengths.end(), suffix.size()) ==
+                suffixLengths.end()) {
+                suffixLengths.push_back(suffix.size());
+                std::sort(suffixLengths.begin(), suffixLengths.end());
+            }
+            return;
+        }
+    }
+
+    for (auto part : splitPath(pattern)) {
+        glob.segments.emplace_back(part);
+    }
+    if (glob.segments.empty()) {
+        return;
+    }
+    // a trailing "**" is everything below the directory but not the directory
+    // itself: one component of any name, then zero or more
+    if (glob.segments.back() == "**") {
+        while (!glob.segments.empty() && glob.segments.back() == "**") {
+            glob.segments.pop_back();
+        }
+        glob.segments.emplace_back("*");
+        glob.segments.emplace_back("**");
+    }
+    globs.push_back(std::move(glob));
+}
+
+bool PathFilter::RuleSet::empty() const noexcept {
+    return names.empty() && directoryNames.empty() && suffixes.empty() && globs.empty();
+}
+
+bool PathFilter::RuleSet::matches(std::string_view relPath, const std::string& name,
+                                  bool isDirectory) const {
+    if (names.count(name) || (isDirectory && directoryNames.count(name))) {
+        return true;
+    }
+
+    const std::string_view nameView = name;
+    for (size_t len : suffixLengths) {
+        if (len > nameView.size()) break;
+        if (suffixes.count(nameView.substr(nameView.size() - len))) {
+            return true;
+        }
+    }
+
+    std::vector<std::string_view> comps;
+    for (const auto& glob : globs) {
+        if (glob.directoryOnly && !isDirectory) {
+            continue;
+        }
+        if (!glob.anchored) {
+            if (matchSegment(glob.segments[0], name)) return true;
+            continue;
+        }
+        if (comps.empty()) {
+            comps = splitPath(relPath);
+        }
+        if (matchSegments(glob.segments, comps)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+PathFilter::PathFilter(const std::vector<std::string>& includes,
+                       const std::vector<std::string>& excludes) {
+    for (const auto& p : includes) includes_.add(p);
+    for (const auto& p : excludes) excludes_.add(p);
+}
+
+bool PathFilter::empty() const noexcept {
+    return includes_.empty() && excludes_.empty();
+}
+
+bool PathFilter::accepts(std::string_view relPath, const std::string& name,
+                         bool isDirectory) const {
+    if (excludes_.matches(relPath, name, isDirectory)) {
+        return false;
+    }
+    if (!isDirectory && !includes_.empty()) {
+        return includes_.matches(relPath, name, false);
+    }
+    return true;
+}
+
+} // namespace backup::filesystem
@@ -0,0 +1,75 @@
+#pragma once
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace backup::filesystem {
+
+/*
+ *   PathFilter decides which scanned entries are kept, from glob rules.
+ *
+ *   Pattern syntax (a subset of .gitignore):
+ *   - "*" and "?" match within one path component, "[a-z]" / "[!a-z]"
+ *     match one character of a class, "\" escapes the next character
+ *   - a pattern without "/" matches the entry name at any depth
+ *     ("node_modules", "*.tmp")
+ *   - a pattern with "/" matches the whole path relative to the scan root
+ *     ("build/out", "src/main.cpp"); a "**" component spans any number of
+ *     components and a leading "/" only anchors the pattern
+ *   - a trailing "/" restricts the rule to directories
+ *
+ *   An entry is dropped when it matches an exclude rule. When include rules
+ *   exist, files must also match one of them; directories are always
+ *   descended unless excluded, so "*.cpp" finds sources at any depth.
+ *
+ *   Rules are compiled once: plain names go to a hash set, "*suffix"
+ *   patterns to a suffix table keyed by length, and only the rest are
+ *   matched as globs.
+ */
+class PathFilter {
+public:
+    PathFilter() = default;
+    PathFilter(const std::vector<std::string>& includes,
+               const std::vector<std::string>& excludes);
+
+    bool empty() const noexcept;
+
+    // relPath is relative to the scan root, name is its last component
+    bool accepts(std::string_view relPath, const std::string& name,
+                 bool isDirectory) const;
+
+private:
+    struct Glob {
+        std::vector<std::string> segments;   // one per path component
+        bool anchored = false;               // matched against relPath
+        bool directoryOnly = false;
+    };
+
+    struct RuleSet {
+        RuleSet() = default;
+        RuleSet(RuleSet&&) = default;
+        RuleSet& operator=(RuleSet&&) = default;
+        // suffixes views into suffixText; moving keeps the strings in place
+        RuleSet(const RuleSet&) = delete;
+        RuleSet& operator=(const RuleSet&) = delete;
+
+        std::unordered_set<std::string> names;
+        std::unordered_set<std::string> directoryNames;
+        std::deque<std::string> suffixText;
+        std::unordered_set<std::string_view> suffixes;   // probed without allocating
+        std::vector<size_t> suffixLengths;   // distinct, ascending
+        std::vector<Glob> globs;
+
+        void add(std::string pattern);
+        bool empty() const noexcept;
+        bool matches(std::string_view relPath, const std::string& name,
+                     bool isDirectory) const;
+    };
+
+    RuleSet includes_;
+    RuleSet excludes_;
+};
+
+} // namespace backup::filesystem
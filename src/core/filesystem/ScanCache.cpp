@@ -0,0 +1,184 @@
+#include "ScanCache.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+namespace backup::filesystem {
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr const char* kCacheHeader = "scancache=2";
+
+// directories touched this recently may still change within the same tick
+constexpr int64_t kRacyWindowNs = 2'000'000'000;
+
+int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+bool statDirectory(const fs::path& absPath, DirIdentity& out) {
+#if defined(_WIN32)
+    (void)absPath;
+    (void)out;
+    return false;
+#else
+    struct stat st {};
+    if (::stat(absPath.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return false;
+    }
+    out.dev = static_cast<uint64_t>(st.st_dev);
+    out.ino = static_cast<uint64_t>(st.st_ino);
+#if defined(__APPLE__)
+    out.mtimeNs = st.st_mtimespec.tv_sec * 1'000'000'000LL + st.st_mtimespec.tv_nsec;
+    out.ctimeNs = st.st_ctimespec.tv_sec * 1'000'000'000LL + st.st_ctimespec.tv_nsec;
+#else
+    out.mtimeNs = st.st_mtim.tv_sec * 1'000'000'000LL + st.st_mtim.tv_nsec;
+    out.ctimeNs = st.st_ctim.tv_sec * 1'000'000'000LL + st.st_ctim.tv_nsec;
+#endif
+    return true;
+#endif
+}
+
+ScanCache::ScanCache(fs::path sourceRoot)
+    : sourceRoot_(std::move(sourceRoot)) {}
+
+bool ScanCache::load(const fs::path& cacheFile) {
+    previous_.clear();
+
+    std::ifstream in(cacheFile, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(in, line) || line != kCacheHeader) {
+        return false;
+    }
+    if (!std::getline(in, line) || line != "root=" + sourceRoot_.string()) {
+        return false;
+    }
+
+    // D|dev|ino|mtime|ctime|count|relPath, followed by count lines of
+    // f|dev|ino|name or d|dev|ino|name
+    std::unordered_map<std::string, Directory> loaded;
+    try {
+        while (std::getline(in, line)) {
+            if (line.size() < 2 || line[0] != 'D' || line[1] != '|') {
+                return false;
+            }
+            std::istringstream ss(line.substr(2));
+            std::string field;
+            uint64_t values[5];
+            for (auto& v : values) {
+                if (!std::getline(ss, field, '|')) return false;
+                v = static_cast<uint64_t>(std::stoll(field));
+            }
+            std::string relPath;
+            std::getline(ss, relPath);
+
+            Directory dir;
+            dir.identity = {values[0], values[1],
+                            static_cast<int64_t>(values[2]),
+                            static_cast<int64_t>(values[3])};
+            dir.entries.reserve(values[4]);
+            for (uint64_t i = 0; i < values[4]; ++i) {
+                if (!std::getline(in, line) || line.size() < 2 || line[1] != '|') {
+                    return false;
+                }
+                const size_t devEnd = line.find('|', 2);
+                const size_t inoEnd = devEnd == std::string::npos
+                                          ? std::string::npos
+                                          : line.find('|', devEnd + 1);
+                if (inoEnd == std::string::npos) {
+                    return false;
+                }
+                dir.entries.push_back({line.substr(inoEnd + 1),
+                                       line[0] == 'd' ? FileType::Directory
+                                                      : FileType::File,
+                                       std::stoull(line.substr(2, devEnd - 2)),
+                                       std::stoull(line.substr(devEnd + 1,
+                                                               inoEnd - devEnd - 1))});
+            }
+            loaded.emplace(std::move(relPath), std::move(dir));
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    previous_ = std::move(loaded);
+    return true;
+}
+
+void ScanCache::save(const fs::path& cacheFile) const {
+    std::ofstream out(cacheFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open scan cache for writing");
+    }
+
+    out << kCacheHeader << "\n";
+    out << "root=" << sourceRoot_.string() << "\n";
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& kv : current_) {
+        const auto& id = kv.second.identity;
+        out << "D|" << id.dev << "|" << id.ino << "|" << id.mtimeNs << "|"
+            << id.ctimeNs << "|" << kv.second.entries.size() << "|"
+            << kv.first << "\n";
+        for (const auto& e : kv.second.entries) {
+            out << (e.type == FileType::Directory ? "d|" : "f|") << e.dev << "|"
+                << e.ino << "|" << e.name << "\n";
+        }
+    }
+
+    out.flush();
+    if (!out.good()) {
+        throw std::runtime_error("Failed to write scan cache");
+    }
+}
+
+const std::vector<ScanCache::Entry>*
+ScanCache::lookup(const std::string& relPath, const DirIdentity& identity) const {
+    auto it = previous_.find(relPath);
+    if (it == previous_.end() || it->second.identity != identity) {
+        return nullptr;
+    }
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return &it->second.entries;
+}
+
+void ScanCache::record(const std::string& relPath,
+                       const DirIdentity& identity,
+                       std::vector<Entry> entries) {
+    // only mtime matters here: once it is old, any later entry change moves
+    // it to a new value, even if ctime was bumped recently by chmod/utime
+    if (identity.mtimeNs > nowNs() - kRacyWindowNs) {
+        return;
+    }
+    // names with line breaks cannot be stored in the line-based format
+    if (relPath.find('\n') != std::string::npos) {
+        return;
+    }
+    for (const auto& e : entries) {
+        if (e.name.find('\n') != std::string::npos) {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    current_[relPath] = {identity, std::move(entries)};
+}
+
+size_t ScanCache::hits() const noexcept {
+    return hits_.load(std::memory_order_relaxed);
+}
+
+} // namespace backup::filesystem
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FileNode.h"
+
+namespace backup::filesystem {
+
+/*
+ *   Identity of a directory as seen by stat(). Creating, deleting or
+ *   renaming an entry bumps the directory's mtime/ctime, so an unchanged
+ *   identity means the child listing is unchanged as well.
+ */
+struct DirIdentity {
+    uint64_t dev = 0;
+    uint64_t ino = 0;
+    int64_t mtimeNs = 0;
+    int64_t ctimeNs = 0;
+
+    bool operator==(const DirIdentity& other) const noexcept {
+        return dev == other.dev && ino == other.ino &&
+               mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs;
+    }
+    bool operator!=(const DirIdentity& other) const noexcept {
+        return !(*this == other);
+    }
+};
+
+// false when the platform has no dev/inode or the directory cannot be stat'ed
+bool statDirectory(const std::filesystem::path& absPath, DirIdentity& out);
+
+/*
+ *   ScanCache remembers, per directory, its identity and the names/types of
+ *   its children. During a scan a directory whose identity is unchanged is
+ *   listed from the cache instead of readdir; only its files are re-stat'ed
+ *   for size and mtime.
+ *
+ *   Directories modified within the last couple of seconds are not cached,
+ *   because a later change in the same timestamp tick would go unnoticed.
+ *   A symlink that is re-pointed without touching its parent keeps its old
+ *   type (file/directory) until the parent changes.
+ *
+ *   lookup() reads the loaded snapshot and record() fills the next one, so
+ *   both may be called concurrently from parallel scan workers.
+ */
+class ScanCache {
+public:
+    struct Entry {
+        std::string name;
+        FileType type;
+        uint64_t dev = 0;   // 0 when the scan did not collect identity
+        uint64_t ino = 0;
+    };
+
+    explicit ScanCache(std::filesystem::path sourceRoot);
+
+    // missing, corrupt or foreign (other source root) files load as empty
+    bool load(const std::filesystem::path& cacheFile);
+    void save(const std::filesystem::path& cacheFile) const;
+
+    const std::vector<Entry>* lookup(const std::string& relPath,
+                                     const DirIdentity& identity) const;
+
+    void record(const std::string& relPath,
+                const DirIdentity& identity,
+                std::vector<Entry> entries);
+
+    size_t hits() const noexcept;
+
+private:
+    struct Directory {
+        DirIdentity identity;
+        std::vector<Entry> entries;
+    };
+
+    std::filesystem::path sourceRoot_;
+    std::unordered_map<std::string, Directory> previous_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Directory> current_;
+    mutable std::atomic<size_t> hits_{0};
+};
+
+} // namespace backup::filesystem
@@ -0,0 +1,68 @@
+#include "TreeWalker.h"
+#include <stdexcept>
+
+namespace backup::filesystem {
+namespace fs = std::filesystem;
+
+TreeWalker::TreeWalker(fs::path rootPath, ScanOptions options)
+    : rootPath_(std::move(rootPath)), options_(options) {}
+
+bool TreeWalker::next(WalkEntry& entry) {
+    if (!started_) {
+        started_ = true;
+        if (!fs::exists(rootPath_) || !fs::is_directory(rootPath_)) {
+            throw std::runtime_error("Root path must be an existing directory");
+        }
+        stack_.push_back({".", listDirectory(rootPath_, ".", options_)});
+    }
+
+    while (!stack_.empty()) {
+        auto& top = stack_.back();
+        if (top.next == top.entries.size()) {
+            stack_.pop_back();
+            continue;
+        }
+
+        DirEntry& e = top.entries[top.next++];
+        entry.relativePath = top.relPath == "." ? e.name : top.relPath + "/" + e.name;
+        entry.type = e.type;
+        entry.size = e.size;
+        entry.mtime = e.mtime;
+        entry.dev = e.dev;
+        entry.ino = e.ino;
+
+        if (entry.isDirectory()) {
+            // invalidates top; the entry is already copied out
+            stack_.push_back({entry.relativePath,
+                              listDirectory(rootPath_ / entry.relativePath,
+                                            entry.relativePath, options_)});
+        }
+        return true;
+    }
+    return false;
+}
+
+const fs::path& TreeWalker::getRootPath() const noexcept {
+    return rootPath_;
+}
+
+TreeWalker::iterator::iterator(TreeWalker* walker) : walker_(walker) {
+    ++*this;
+}
+
+TreeWalker::iterator& TreeWalker::iterator::operator++() {
+    if (walker_ && !walker_->next(entry_)) {
+        walker_ = nullptr;
+    }
+    return *this;
+}
+
+TreeWalker::iterator TreeWalker::begin() {
+    return iterator(this);
+}
+
+TreeWalker::iterator TreeWalker::end() {
+    return iterator();
+}
+
+} // namespace backup::filesystem
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "FileNode.h"
+#include "DirectoryLister.h"
+
+namespace backup::filesystem {
+
+/*
+ *   WalkEntry is one entry produced by TreeWalker: what a FileNode holds,
+ *   without children.
+ */
+struct WalkEntry {
+    std::string relativePath;
+    FileType type = FileType::File;
+    uintmax_t size = 0;              // valid only for file
+    FileNode::FileTime mtime{};      // valid only for file
+    uint64_t dev = 0;                // 0 when unknown
+    uint64_t ino = 0;
+
+    bool isFile() const noexcept { return type == FileType::File; }
+    bool isDirectory() const noexcept { return type == FileType::Directory; }
+};
+
+/*
+ *   TreeWalker streams a directory tree without building it.
+ *
+ *   Entries come out in the order of FileTree::traverseDFS (pre-order,
+ *   children by name; see FileTreeDiff::pathLess), root excluded. Only the
+ *   listings of the directories on the current path are held, so memory is
+ *   bounded by depth times fan-out rather than by the size of the tree.
+ *   A directory is listed when its own entry is produced.
+ *
+ *   options.threads is ignored: the walk is single-threaded.
+ */
+class TreeWalker {
+public:
+    explicit TreeWalker(std::filesystem::path rootPath, ScanOptions options = {});
+
+    TreeWalker(const TreeWalker&) = delete;
+    TreeWalker& operator=(const TreeWalker&) = delete;
+
+    // false once the walk is over; throws if the root is not a directory
+    bool next(WalkEntry& entry);
+
+    const std::filesystem::path& getRootPath() const noexcept;
+
+    // single-pass input range: for (const WalkEntry& e : walker)
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = WalkEntry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const WalkEntry*;
+        using reference = const WalkEntry&;
+
+        iterator() = default;
+        explicit iterator(TreeWalker* walker);
+
+        reference operator*() const noexcept { return entry_; }
+        pointer operator->() const noexcept { return &entry_; }
+        iterator& operator++();
+        bool operator==(const iterator& other) const noexcept { return walker_ == other.walker_; }
+        bool operator!=(const iterator& other) const noexcept { return walker_ != other.walker_; }
+
+    private:
+        TreeWalker* walker_ = nullptr;
+        WalkEntry entry_;
+    };
+
+    iterator begin();
+    iterator end();
+
+private:
+    struct Frame {
+        std::string relPath;
+        std::vector<DirEntry> entries;
+        size_t next = 0;
+    };
+
+    std::filesystem::path rootPath_;
+    ScanOptions options_;
+    std::vector<Frame> stack_;
+    bool started_ = false;
+};
+
+} // namespace backup::filesystem
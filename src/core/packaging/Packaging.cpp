@@ -1,6 +1,393 @@
 #include "Packaging.h"
+#include "compression/BlockFormat.h"
+#include "util/ByteSink.h"
+#include "util/FileCopy.h"
+#include "util/Hash.h"
+#include "util/TimeUtils.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
 
 namespace backup::core::packaging
 {
-    // 待实现
-}
\ No newline at end of file
+
+    namespace
+    {
+        constexpr const char kPackMagic[] = "SDPACK01";
+        constexpr size_t kPackMagicSize = sizeof(kPackMagic) - 1;
+        constexpr const char *kIndexMagic = "SDPACKIDX1";
+        constexpr const char *kPackPrefix = "pack-";
+
+        bool isUnder(const std::string &path, const std::string &root)
+        {
+            return path.size() > root.size() && path[root.size()] == '/' &&
+                   path.compare(0, root.size(), root) == 0;
+        }
+    }
+
+    PackStore::PackStore(const fs::path &directory, const fs::path &indexPath, Options options)
+        : directory_(directory),
+          options_(std::move(options))
+    {
+        if (options_.encrypt && options_.encryptionKey.empty())
+        {
+            throw std::invalid_argument("加密的打包存储需要密钥");
+        }
+        loadIndex(indexPath);
+
+        // 接着写最后一个未满的包，否则开始新的包
+        const auto packs = listPacks();
+        currentPack_ = packs.empty() ? 1 : packs.back();
+        std::error_code ec;
+        currentSize_ = packs.empty() ? 0 : fs::file_size(packPath(currentPack_), ec);
+        if (ec || currentSize_ >= options_.maxPackSize)
+        {
+            ++currentPack_;
+            currentSize_ = 0;
+        }
+    }
+
+    fs::path PackStore::packPath(uint32_t pack) const
+    {
+        return directory_ / (kPackPrefix + std::to_string(pack));
+    }
+
+    std::vector<uint32_t> PackStore::listPacks() const
+    {
+        std::vector<uint32_t> packs;
+        std::error_code ec;
+        for (fs::directory_iterator it(directory_, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const std::string name = it->path().filename().string();
+            if (it->is_regular_file() && name.rfind(kPackPrefix, 0) == 0 &&
+                name.size() > std::char_traits<char>::length(kPackPrefix) &&
+                std::all_of(name.begin() + std::char_traits<char>::length(kPackPrefix), name.end(),
+                            [](char c)
+                            { return c >= '0' && c <= '9'; }))
+            {
+                packs.push_back(static_cast<uint32_t>(
+                    std::stoul(name.substr(std::char_traits<char>::length(kPackPrefix)))));
+            }
+        }
+        std::sort(packs.begin(), packs.end());
+        return packs;
+    }
+
+    void PackStore::loadIndex(const fs::path &indexPath)
+    {
+        std::ifstream in(indexPath);
+        if (!in.is_open())
+        {
+            return;
+        }
+
+        std::string line;
+        if (!std::getline(in, line) || line != kIndexMagic)
+        {
+            throw std::runtime_error("包索引格式无效: " + indexPath.string());
+        }
+        while (std::getline(in, line))
+        {
+            if (line.empty())
+            {
+                continue;
+            }
+            std::istringstream ss(line);
+            PackEntry entry;
+            std::string path;
+            ss >> entry.pack >> entry.offset >> entry.length >> entry.hash >> entry.mtimeNs >> std::oct >>
+                entry.permissions;
+            // 路径可能含空格，取分隔的一个空格之后的全部内容
+            if (!ss || ss.get() != ' ' || !std::getline(ss, path) || path.empty())
+            {
+                throw std::runtime_error("包索引已损坏: " + indexPath.string());
+            }
+            index_[path] = entry;
+        }
+    }
+
+    PackEntry PackStore::appendLocked(const std::vector<uint8_t> &stored)
+    {
+        if (!current_.is_open())
+        {
+            fs::create_directories(directory_);
+            current_.open(packPath(currentPack_), std::ios::binary | std::ios::app);
+            if (!current_.is_open())
+            {
+                throw std::runtime_error("无法写入包文件: " + packPath(currentPack_).string());
+            }
+            if (currentSize_ == 0)
+            {
+                current_.write(kPackMagic, kPackMagicSize);
+                currentSize_ = kPackMagicSize;
+            }
+        }
+
+        PackEntry entry;
+        entry.pack = currentPack_;
+        entry.offset = currentSize_;
+        entry.length = stored.size();
+        entry.hash = util::xxhash64(stored.data(), stored.size());
+        current_.write(reinterpret_cast<const char *>(stored.data()), static_cast<std::streamsize>(stored.size()));
+        if (!current_.good())
+        {
+            throw std::runtime_error("写入包文件失败: " + packPath(currentPack_).string());
+        }
+        currentSize_ += stored.size();
+        unsynced_.insert(currentPack_);
+
+        if (currentSize_ >= options_.maxPackSize)
+        {
+            current_.close();
+            if (current_.fail())
+            {
+                throw std::runtime_error("写入包文件失败: " + packPath(currentPack_).string());
+            }
+            ++currentPack_;
+            currentSize_ = 0;
+        }
+        return entry;
+    }
+
+    std::vector<uint8_t> PackStore::readRecord(const PackEntry &entry) const
+    {
+        std::ifstream in(packPath(entry.pack), std::ios::binary);
+        std::vector<uint8_t> stored(entry.length);
+        in.seekg(static_cast<std::streamoff>(entry.offset));
+        in.read(reinterpret_cast<char *>(stored.data()), static_cast<std::streamsize>(stored.size()));
+        if (!in || util::xxhash64(stored.data(), stored.size()) != entry.hash)
+        {
+            throw std::runtime_error("包中的记录已损坏: " + packPath(entry.pack).string() + " @" +
+                                     std::to_string(entry.offset));
+        }
+        return stored;
+    }
+
+    uint64_t PackStore::storeFile(const fs::path &source, const std::string &relativePath)
+    {
+        // 先取属性再读内容，读取期间被修改的文件在下次备份时会被发现
+        const int64_t mtimeNs = util::fileTimeToInt64(fs::last_write_time(source));
+        const auto permissions = static_cast<uint32_t>(fs::status(source).permissions() & fs::perms::mask);
+
+        std::vector<uint8_t> stored = util::readWholeFile(source);
+        util::XxHash64 hash;
+        hash.update(stored.data(), stored.size());
+        if (options_.compress)
+        {
+            stored = compression::compressBuffer(options_.compressionType, stored);
+        }
+        if (options_.encrypt)
+        {
+            auto encryptor = encryption::createEncryptor(options_.encryptionType);
+            encryptor->setKey(options_.encryptionKey);
+            std::vector<uint8_t> cipherText;
+            util::BufferSink sink(cipherText);
+            auto cipher = encryptor->encryptTo(sink);
+            cipher->write(stored.data(), stored.size());
+            cipher->finish();
+            stored = std::move(cipherText);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        PackEntry entry = appendLocked(stored);
+        entry.mtimeNs = mtimeNs;
+        entry.permissions = permissions;
+        index_[relativePath] = entry;
+        ++stats_.files;
+        stats_.storedBytes += stored.size();
+        return util::fingerprintOf(hash);
+    }
+
+    bool PackStore::loadFile(const std::string &relativePath, const fs::path &target) const
+    {
+        PackEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            const auto it = index_.find(relativePath);
+            if (it == index_.end())
+            {
+                return false;
+            }
+            entry = it->second;
+        }
+
+        std::vector<uint8_t> data = readRecord(entry);
+        if (options_.encrypt)
+        {
+            auto decryptor = encryption::createEncryptor(options_.encryptionType);
+            decryptor->setKey(options_.encryptionKey);
+            std::vector<uint8_t> plain;
+            util::BufferSink sink(plain);
+            auto cipher = decryptor->decryptTo(sink);
+            cipher->write(data.data(), data.size());
+            cipher->finish();
+            data = std::move(plain);
+        }
+        if (options_.compress)
+        {
+            data = compression::decompressBuffer(options_.compressionType, data);
+        }
+
+        try
+        {
+            util::FileSink file(target);
+            file.write(data.data(), data.size());
+            file.finish();
+            fs::permissions(target, static_cast<fs::perms>(entry.permissions));
+            fs::last_write_time(target, util::int64ToFileTime(entry.mtimeNs));
+        }
+        catch (...)
+        {
+            std::error_code ec;
+            fs::remove(target, ec);
+            throw;
+        }
+        return true;
+    }
+
+    bool PackStore::contains(const std::string &relativePath) const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return index_.count(relativePath) != 0;
+    }
+
+    void PackStore::erase(const std::string &relativePath)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        index_.erase(relativePath);
+        // 以 "<路径>/" 为前缀的条目在有序的索引中连续排列
+        auto it = index_.lower_bound(relativePath + "/");
+        while (it != index_.end() && isUnder(it->first, relativePath))
+        {
+            it = index_.erase(it);
+        }
+    }
+
+    void PackStore::rename(const std::string &from, const std::string &to, bool keepSource)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::pair<std::string, PackEntry>> moved;
+        if (const auto it = index_.find(from); it != index_.end())
+        {
+            moved.emplace_back(to, it->second);
+            if (!keepSource)
+            {
+                index_.erase(it);
+            }
+        }
+        auto it = index_.lower_bound(from + "/");
+        while (it != index_.end() && isUnder(it->first, from))
+        {
+            moved.emplace_back(to + it->first.substr(from.size()), it->second);
+            it = keepSource ? std::next(it) : index_.erase(it);
+        }
+        for (auto &kv : moved)
+        {
+            index_[std::move(kv.first)] = kv.second;
+        }
+    }
+
+    void PackStore::compact()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<uint32_t, uint64_t> live;
+        for (const auto &kv : index_)
+        {
+            live[kv.second.pack] += kv.second.length;
+        }
+
+        std::set<uint32_t> sparse;
+        for (const uint32_t pack : listPacks())
+        {
+            std::error_code ec;
+            const uint64_t size = fs::file_size(packPath(pack), ec);
+            if (pack != currentPack_ && !ec && live[pack] * 2 < size)
+            {
+                sparse.insert(pack);
+            }
+        }
+        if (sparse.empty())
+        {
+            return;
+        }
+
+        for (auto &kv : index_)
+        {
+            if (!sparse.count(kv.second.pack))
+            {
+                continue;
+            }
+            PackEntry entry = appendLocked(readRecord(kv.second));
+            entry.mtimeNs = kv.second.mtimeNs;
+            entry.permissions = kv.second.permissions;
+            stats_.repackedBytes += entry.length;
+            kv.second = entry;
+        }
+        obsolete_.insert(sparse.begin(), sparse.end());
+    }
+
+    void PackStore::commit(const fs::path &indexPath)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_.is_open())
+        {
+            current_.close();
+            if (current_.fail())
+            {
+                throw std::runtime_error("写入包文件失败: " + packPath(currentPack_).string());
+            }
+        }
+
+        const fs::path temp = indexPath.string() + ".tmp";
+        {
+            std::ofstream out(temp, std::ios::trunc);
+            if (!out.is_open())
+            {
+                throw std::runtime_error("无法写入包索引: " + temp.string());
+            }
+            out << kIndexMagic << "\n";
+            for (const auto &[path, entry] : index_)
+            {
+                out << entry.pack << ' ' << entry.offset << ' ' << entry.length << ' ' << entry.hash << ' '
+                    << entry.mtimeNs << ' ' << std::oct << entry.permissions << std::dec << ' ' << path << "\n";
+            }
+            out.close();
+            if (out.fail())
+            {
+                throw std::runtime_error("写入包索引失败: " + temp.string());
+            }
+        }
+        // 索引引用的数据先落盘再替换索引，断电后索引中的偏移不会超出包的实际内容
+        if (!unsynced_.empty())
+        {
+            for (const uint32_t pack : unsynced_)
+            {
+                util::syncToDisk(packPath(pack));
+            }
+            util::syncToDisk(directory_);
+            unsynced_.clear();
+        }
+        util::syncToDisk(temp);
+        // 索引替换之后，搬空的包不再被引用
+        fs::rename(temp, indexPath);
+        util::syncToDisk(indexPath.parent_path());
+
+        for (const uint32_t pack : obsolete_)
+        {
+            std::error_code ec;
+            if (fs::remove(packPath(pack), ec))
+            {
+                ++stats_.removedPacks;
+            }
+        }
+        obsolete_.clear();
+    }
+
+    PackStore::Stats PackStore::stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+} // namespace backup::core::packaging
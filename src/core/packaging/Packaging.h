@@ -1,6 +1,115 @@
 #pragma once
 
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "compression/Compression.h"
+#include "encryption/Encryption.h"
+
 namespace backup::core::packaging
 {
-    // 待实现
-}
\ No newline at end of file
+
+    namespace fs = std::filesystem;
+
+    // 一个文件在包中的位置与还原所需的属性
+    struct PackEntry
+    {
+        uint32_t pack = 0;        // 包编号，对应 <目录>/pack-<编号>
+        uint64_t offset = 0;      // 记录在包中的起始位置
+        uint64_t length = 0;      // 存储长度（压缩/加密后）
+        uint64_t hash = 0;        // 存储内容的 XXH64，读取时校验
+        int64_t mtimeNs = 0;      // 源文件的 mtime
+        uint32_t permissions = 0; // 源文件的权限位
+    };
+
+    /*
+     * PackStore: 把大量小文件合并保存在少数几个只追加的包文件中
+     *  - 包文件以魔数 SDPACK01 开头，之后是首尾相接的记录（每个文件单独压缩、加密），
+     *    写满 maxPackSize 后换下一个包；已写入的字节不再改动，多个快照可以共用
+     *  - 索引按相对路径记录各文件的位置（PackEntry），为文本文件，
+     *    每行 "<包> <偏移> <长度> <哈希> <mtime> <权限> <相对路径>"，commit() 时整体替换
+     *  - 被更新或删除的文件留下的无用记录由 compact() 回收
+     */
+    class PackStore
+    {
+    public:
+        struct Options
+        {
+            bool compress = false;
+            compression::CompressionType compressionType = compression::CompressionType::Lz77;
+            bool encrypt = false;
+            encryption::EncryptionType encryptionType = encryption::EncryptionType::AES;
+            std::string encryptionKey;
+            uint64_t maxPackSize = 64ull << 20; // 当前包达到此大小后写入新的包
+        };
+
+        struct Stats
+        {
+            uint64_t files = 0;         // 写入包中的文件数
+            uint64_t storedBytes = 0;   // 其中写入的字节数（压缩/加密后）
+            uint64_t repackedBytes = 0; // compact() 搬移的字节数
+            uint64_t removedPacks = 0;  // compact() 删除的包数
+        };
+
+        // 包文件位于 directory，从 indexPath 载入索引（不存在时为空）；索引格式不对时抛出 std::runtime_error
+        PackStore(const fs::path &directory, const fs::path &indexPath, Options options);
+
+        PackStore(const PackStore &) = delete;
+        PackStore &operator=(const PackStore &) = delete;
+
+        // 读入 source 追加到当前的包，索引中 relativePath 指向新记录；可被多个线程同时调用。
+        // 返回 source 的内容指纹（同 util::fingerprintFile）
+        uint64_t storeFile(const fs::path &source, const std::string &relativePath);
+
+        // relativePath 不在包中时返回 false；否则还原内容、权限与 mtime 到 target，失败时抛出异常并删除 target
+        bool loadFile(const std::string &relativePath, const fs::path &target) const;
+
+        bool contains(const std::string &relativePath) const;
+
+        // 删除 relativePath 及其下的全部条目（目录）
+        void erase(const std::string &relativePath);
+
+        // from 及其下的条目移到 to 之下；keepSource 时保留原条目（两者指向同一记录）
+        void rename(const std::string &from, const std::string &to, bool keepSource);
+
+        // 有效内容不足一半的包：其中仍被引用的记录原样搬到当前的包，包本身在 commit() 后删除
+        void compact();
+
+        // 写出当前的包，把索引写入 indexPath（先写临时文件再改名），再删除 compact() 腾空的包
+        void commit(const fs::path &indexPath);
+
+        Stats stats() const;
+
+        static constexpr const char *kDirectory = ".packs";
+        static constexpr const char *kIndexFile = ".packindex";
+
+    private:
+        fs::path directory_;
+        Options options_;
+
+        mutable std::mutex mutex_;
+        std::map<std::string, PackEntry> index_; // 按路径排序，目录下的条目连续
+        std::ofstream current_;
+        uint32_t currentPack_ = 0;
+        uint64_t currentSize_ = 0;
+        std::set<uint32_t> obsolete_;
+        std::set<uint32_t> unsynced_; // 上次提交后写入过的包，提交索引前 fsync
+        Stats stats_;
+
+        fs::path packPath(uint32_t pack) const;
+        std::vector<uint32_t> listPacks() const;
+        void loadIndex(const fs::path &indexPath);
+
+        // 调用方持有 mutex_
+        PackEntry appendLocked(const std::vector<uint8_t> &stored);
+        // 读取一条记录并校验哈希
+        std::vector<uint8_t> readRecord(const PackEntry &entry) const;
+    };
+
+} // namespace backup::core::packaging
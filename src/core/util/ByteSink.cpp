@@ -0,0 +1,143 @@
+#include "ByteSink.h"
+
+#include <stdexcept>
+
+namespace backup::util {
+
+namespace {
+
+constexpr size_t kChunkSize = 1 << 16;
+
+std::ifstream openInput(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open input file: " + path.string());
+    }
+    return in;
+}
+
+} // namespace
+
+FileSink::FileSink(const std::filesystem::path& path)
+    : path_(path), out_(path, std::ios::binary | std::ios::trunc) {
+    if (!out_.is_open()) {
+        throw std::runtime_error("Failed to open output file: " + path.string());
+    }
+}
+
+void FileSink::write(const uint8_t* data, size_t size) {
+    out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    if (!out_) {
+        throw std::runtime_error("Failed to write output file: " + path_.string());
+    }
+}
+
+void FileSink::finish() {
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Failed to write output file: " + path_.string());
+    }
+}
+
+void BufferSink::write(const uint8_t* data, size_t size) {
+    buffer_.insert(buffer_.end(), data, data + size);
+}
+
+AsyncSink::AsyncSink(ByteSink& output, size_t maxPending)
+    : output_(output), maxPending_(maxPending == 0 ? 1 : maxPending), writer_([this] { run(); }) {}
+
+AsyncSink::~AsyncSink() {
+    close();
+}
+
+void AsyncSink::write(const uint8_t* data, size_t size) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    changed_.wait(lock, [this] { return error_ || pending_.size() < maxPending_; });
+    if (error_) {
+        lock.unlock();
+        rethrow();
+    }
+    pending_.emplace_back(data, data + size);
+    changed_.notify_all();
+}
+
+void AsyncSink::finish() {
+    close();
+    rethrow();
+    output_.finish();
+}
+
+void AsyncSink::run() {
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this] { return closed_ || !pending_.empty(); });
+        if (pending_.empty()) {
+            return;
+        }
+        std::vector<uint8_t> chunk = std::move(pending_.front());
+        pending_.pop_front();
+        changed_.notify_all();
+        lock.unlock();
+        try {
+            output_.write(chunk.data(), chunk.size());
+        } catch (...) {
+            lock.lock();
+            error_ = std::current_exception();
+            pending_.clear();
+            changed_.notify_all();
+            return;
+        }
+    }
+}
+
+void AsyncSink::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        changed_.notify_all();
+    }
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void AsyncSink::rethrow() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_) {
+        std::rethrow_exception(error_);
+    }
+}
+
+uint64_t pumpFile(const std::filesystem::path& path, ByteSink& sink) {
+    std::ifstream in = openInput(path);
+    std::vector<uint8_t> chunk(kChunkSize);
+    uint64_t total = 0;
+    while (in) {
+        in.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+        const auto got = static_cast<size_t>(in.gcount());
+        if (got == 0) {
+            break;
+        }
+        sink.write(chunk.data(), got);
+        total += got;
+    }
+    if (in.bad()) {
+        throw std::runtime_error("Failed to read input file: " + path.string());
+    }
+    return total;
+}
+
+std::vector<uint8_t> readWholeFile(const std::filesystem::path& path) {
+    std::ifstream in = openInput(path);
+    in.seekg(0, std::ios::end);
+    const auto size = static_cast<size_t>(in.tellg());
+    in.seekg(0, std::ios::beg);
+    std::vector<uint8_t> data(size);
+    in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size));
+    if (static_cast<size_t>(in.gcount()) != size) {
+        throw std::runtime_error("Failed to read input file: " + path.string());
+    }
+    return data;
+}
+
+} // namespace backup::util
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace backup::util {
+
+/**
+ * 字节流的接收端：数据按顺序分块 write()，最后调用一次 finish()
+ * 变换型的 sink（加密、解密等）在 finish() 中写出缓存的尾部，再 finish() 下游
+ * 出错时抛出 std::runtime_error
+ */
+class ByteSink {
+public:
+    virtual ~ByteSink() = default;
+
+    virtual void write(const uint8_t* data, size_t size) = 0;
+    virtual void finish() {}
+};
+
+/**
+ * 写入文件（截断已有内容）；finish() 刷新并关闭，写入失败时抛出异常
+ */
+class FileSink : public ByteSink {
+public:
+    explicit FileSink(const std::filesystem::path& path);
+
+    void write(const uint8_t* data, size_t size) override;
+    void finish() override;
+
+private:
+    std::filesystem::path path_;
+    std::ofstream out_;
+};
+
+/**
+ * 追加到内存缓冲区
+ */
+class BufferSink : public ByteSink {
+public:
+    explicit BufferSink(std::vector<uint8_t>& buffer) : buffer_(buffer) {}
+
+    void write(const uint8_t* data, size_t size) override;
+
+private:
+    std::vector<uint8_t>& buffer_;
+};
+
+/**
+ * 在后台线程中写入下游 sink，使调用方的计算与写盘重叠
+ * 缓存的块数达到 maxPending 时 write() 阻塞；下游的异常在之后的 write()/finish() 中抛出
+ * finish() 等待全部写完后调用下游的 finish()
+ */
+class AsyncSink : public ByteSink {
+public:
+    explicit AsyncSink(ByteSink& output, size_t maxPending = 8);
+    ~AsyncSink() override;
+
+    AsyncSink(const AsyncSink&) = delete;
+    AsyncSink& operator=(const AsyncSink&) = delete;
+
+    void write(const uint8_t* data, size_t size) override;
+    void finish() override;
+
+private:
+    ByteSink& output_;
+    size_t maxPending_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<std::vector<uint8_t>> pending_;
+    bool closed_ = false;
+    std::exception_ptr error_;
+    std::thread writer_;
+
+    void run();
+    void close();
+    void rethrow();
+};
+
+/**
+ * 按块读取文件写入 sink（不调用 finish()），返回读取的字节数
+ */
+uint64_t pumpFile(const std::filesystem::path& path, ByteSink& sink);
+
+/**
+ * 读取整个文件
+ */
+std::vector<uint8_t> readWholeFile(const std::filesystem::path& path);
+
+} // namespace backup::util
@@ -0,0 +1,80 @@
+#include "Chunker.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace backup::util {
+
+namespace {
+
+// 每个字节值对应一个固定的伪随机 64 位数（splitmix64），切点因此与平台无关
+std::array<uint64_t, 256> makeGearTable() {
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x5344424b43444331ULL; // "SDBKCDC1"
+    for (auto& entry : table) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        entry = z ^ (z >> 31);
+    }
+    return table;
+}
+
+const std::array<uint64_t, 256>& gearTable() {
+    static const std::array<uint64_t, 256> table = makeGearTable();
+    return table;
+}
+
+// 左移的哈希中高位受更多字节影响，掩码取高 bits 位
+uint64_t highMask(unsigned bits) {
+    return bits == 0 ? 0 : ~uint64_t{0} << (64 - bits);
+}
+
+unsigned log2Of(size_t value) {
+    unsigned bits = 0;
+    while ((size_t{1} << (bits + 1)) <= value) {
+        ++bits;
+    }
+    return bits;
+}
+
+} // namespace
+
+Chunker::Chunker(const ChunkerOptions& options) : options_(options) {
+    if (options_.minSize == 0 || options_.minSize > options_.averageSize ||
+        options_.averageSize > options_.maxSize ||
+        (options_.averageSize & (options_.averageSize - 1)) != 0) {
+        throw std::invalid_argument("Invalid chunker options");
+    }
+    const unsigned bits = log2Of(options_.averageSize);
+    maskSmall_ = highMask(std::min(bits + 2, 63u));
+    maskLarge_ = highMask(bits > 2 ? bits - 2 : 1);
+}
+
+size_t Chunker::cut(const uint8_t* data, size_t size) const {
+    if (size <= options_.minSize) {
+        return size;
+    }
+    const size_t limit = std::min(size, options_.maxSize);
+    const size_t normal = std::min(limit, options_.averageSize);
+    const auto& gear = gearTable();
+
+    uint64_t hash = 0;
+    size_t i = options_.minSize;
+    for (; i < normal; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash & maskSmall_) == 0) {
+            return i + 1;
+        }
+    }
+    for (; i < limit; ++i) {
+        hash = (hash << 1) + gear[data[i]];
+        if ((hash & maskLarge_) == 0) {
+            return i + 1;
+        }
+    }
+    return limit;
+}
+
+} // namespace backup::util
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace backup::util {
+
+/**
+ * 内容定义分块的参数；块大小在 [minSize, maxSize] 内，平均约为 averageSize
+ * averageSize 须为 2 的幂
+ */
+struct ChunkerOptions {
+    size_t minSize = 16 * 1024;
+    size_t averageSize = 64 * 1024;
+    size_t maxSize = 256 * 1024;
+};
+
+/**
+ * FastCDC 风格的分块器：gear 滚动哈希逐字节更新，低于平均大小时用更严格的掩码、
+ * 超过后用更宽松的掩码（归一化分块），使块大小集中在平均值附近
+ * 切点只取决于附近的内容，文件中间插入或删除数据只影响相邻的块
+ */
+class Chunker {
+public:
+    explicit Chunker(const ChunkerOptions& options = {});
+
+    const ChunkerOptions& options() const noexcept { return options_; }
+
+    /**
+     * data 从一个块的开头开始；返回该块的长度（1..min(size, maxSize)）
+     * 除文件末尾外，调用方须提供至少 maxSize 字节，否则切点会与整体读取时不同
+     */
+    size_t cut(const uint8_t* data, size_t size) const;
+
+private:
+    ChunkerOptions options_;
+    uint64_t maskSmall_;
+    uint64_t maskLarge_;
+};
+
+} // namespace backup::util
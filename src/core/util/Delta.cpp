@@ -0,0 +1,179 @@
+#include "Delta.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+
+namespace backup::util {
+
+namespace {
+
+constexpr char kMagic[8] = {'S', 'D', 'S', 'I', 'G', '0', '0', '1'};
+constexpr uint32_t kMinBlockSize = 4 * 1024;
+constexpr uint32_t kMaxBlockSize = 1024 * 1024;
+constexpr uint64_t kStrongSeed = 0x5344534947ULL;
+
+template <typename T>
+void put(std::ofstream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool get(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+FileSignature::Block signBlock(const uint8_t* data, size_t size) {
+    return {weakChecksum(data, size), xxhash64(data, size, kStrongSeed)};
+}
+
+// 读满 size 字节，文件末尾时可能更少
+size_t readBlock(std::ifstream& in, std::vector<uint8_t>& buffer, const std::filesystem::path& path) {
+    in.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    if (in.bad()) {
+        throw std::runtime_error("Failed to read file: " + path.string());
+    }
+    return static_cast<size_t>(in.gcount());
+}
+
+} // namespace
+
+uint32_t weakChecksum(const uint8_t* data, size_t size) {
+    uint32_t a = 0;
+    uint32_t b = 0;
+    for (size_t i = 0; i < size; ++i) {
+        a += data[i];
+        b += static_cast<uint32_t>(size - i) * data[i];
+    }
+    return (a & 0xffff) | (b << 16);
+}
+
+bool FileSignature::load(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    char magic[sizeof(kMagic)];
+    uint32_t count = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !get(in, fileSize) || !get(in, mtimeNs) || !get(in, blockSize) || !get(in, count) ||
+        blockSize == 0 || count != (fileSize + blockSize - 1) / blockSize) {
+        return false;
+    }
+    blocks.resize(count);
+    for (auto& block : blocks) {
+        if (!get(in, block.weak) || !get(in, block.strong)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FileSignature::save(const std::filesystem::path& path) const {
+    const std::filesystem::path temp = path.string() + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error("Failed to open signature file: " + temp.string());
+        }
+        out.write(kMagic, sizeof(kMagic));
+        put(out, fileSize);
+        put(out, mtimeNs);
+        put(out, blockSize);
+        put(out, static_cast<uint32_t>(blocks.size()));
+        for (const auto& block : blocks) {
+            put(out, block.weak);
+            put(out, block.strong);
+        }
+        out.close();
+        if (!out) {
+            std::error_code ec;
+            std::filesystem::remove(temp, ec);
+            throw std::runtime_error("Failed to write signature file: " + temp.string());
+        }
+    }
+    std::filesystem::rename(temp, path);
+}
+
+uint32_t chooseBlockSize(uint64_t fileSize) {
+    const auto root = static_cast<uint64_t>(std::sqrt(static_cast<double>(fileSize)));
+    uint32_t blockSize = kMinBlockSize;
+    while (blockSize < root && blockSize < kMaxBlockSize) {
+        blockSize <<= 1;
+    }
+    return blockSize;
+}
+
+FileSignature signFile(const std::filesystem::path& path, uint32_t blockSize) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+    FileSignature signature;
+    signature.blockSize = blockSize != 0 ? blockSize : chooseBlockSize(std::filesystem::file_size(path));
+
+    std::vector<uint8_t> buffer(signature.blockSize);
+    while (const size_t n = readBlock(in, buffer, path)) {
+        signature.blocks.push_back(signBlock(buffer.data(), n));
+        signature.fileSize += n;
+    }
+    return signature;
+}
+
+PatchResult patchFile(const std::filesystem::path& source,
+                      const std::filesystem::path& target,
+                      const FileSignature& old) {
+    if (old.blockSize == 0) {
+        throw std::invalid_argument("Invalid signature");
+    }
+    std::ifstream in(source, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open file: " + source.string());
+    }
+    std::fstream out(target, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to open file for patching: " + target.string());
+    }
+
+    PatchResult result;
+    FileSignature& signature = result.signature;
+    signature.blockSize = old.blockSize;
+
+    std::vector<uint8_t> buffer(old.blockSize);
+    for (size_t index = 0;; ++index) {
+        const size_t n = readBlock(in, buffer, source);
+        if (n == 0) {
+            break;
+        }
+        const auto block = signBlock(buffer.data(), n);
+        signature.blocks.push_back(block);
+
+        const uint64_t offset = signature.fileSize;
+        signature.fileSize += n;
+        if (index < old.blocks.size()) {
+            const uint64_t oldLength = std::min<uint64_t>(old.blockSize, old.fileSize - offset);
+            const auto& previous = old.blocks[index];
+            if (oldLength == n && previous.weak == block.weak && previous.strong == block.strong) {
+                continue;
+            }
+        }
+        out.seekp(static_cast<std::streamoff>(offset));
+        out.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(n));
+        if (!out) {
+            throw std::runtime_error("Failed to write file: " + target.string());
+        }
+        result.bytesWritten += n;
+    }
+
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Failed to write file: " + target.string());
+    }
+    if (signature.fileSize < old.fileSize) {
+        std::filesystem::resize_file(target, signature.fileSize);
+    }
+    return result;
+}
+
+} // namespace backup::util
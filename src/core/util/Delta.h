@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace backup::util {
+
+/**
+ * rsync 的弱校验（checksum1）：a = Σ字节，b = Σ(len - i)·字节，各取低 16 位
+ */
+uint32_t weakChecksum(const uint8_t* data, size_t size);
+
+/**
+ * 文件的块签名：按 blockSize 切分，每块一个弱校验与 XXH64 强校验
+ * fileSize/mtimeNs 记录签名对应的文件状态，用来判断签名是否仍然有效
+ */
+struct FileSignature {
+    struct Block {
+        uint32_t weak = 0;
+        uint64_t strong = 0;
+    };
+
+    uint64_t fileSize = 0;
+    int64_t mtimeNs = 0;
+    uint32_t blockSize = 0;
+    std::vector<Block> blocks;
+
+    /**
+     * 读取签名文件；不存在或格式不对时返回 false
+     */
+    bool load(const std::filesystem::path& path);
+
+    /**
+     * 写入签名文件（先写临时文件再改名），失败时抛出 std::runtime_error
+     */
+    void save(const std::filesystem::path& path) const;
+};
+
+/**
+ * 按文件大小选择块大小：约为 sqrt(size)，取 2 的幂，限制在 4 KiB–1 MiB
+ */
+uint32_t chooseBlockSize(uint64_t fileSize);
+
+/**
+ * 计算文件的签名；blockSize 为 0 时由 chooseBlockSize() 决定，mtimeNs 留给调用方填写
+ * 文件无法读取时抛出 std::runtime_error
+ */
+FileSignature signFile(const std::filesystem::path& path, uint32_t blockSize = 0);
+
+struct PatchResult {
+    FileSignature signature; // source 的新签名（块大小沿用旧签名）
+    uint64_t bytesWritten = 0;
+};
+
+/**
+ * 原地修补 target，使其内容与 source 相同：target 当前的内容须与 old 描述的一致
+ * 逐块比较 source 与 old 中同一位置的块，两种校验都相同时跳过，否则只写入该块，
+ * 最后截断到 source 的长度；追加写入或原地改写的大文件只需写入变化的部分
+ * 出错时抛出 std::runtime_error，此时 target 可能只修补了一部分
+ */
+PatchResult patchFile(const std::filesystem::path& source,
+                      const std::filesystem::path& target,
+                      const FileSignature& old);
+
+} // namespace backup::util
@@ -0,0 +1,159 @@
+#include "FileCopy.h"
+
+#include <cerrno>
+#include <system_error>
+#include <vector>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace backup::util {
+
+const char* copyMethodName(CopyMethod method) {
+    switch (method) {
+    case CopyMethod::Reflink:
+        return "reflink";
+    case CopyMethod::CopyFileRange:
+        return "copy_file_range";
+    case CopyMethod::Sendfile:
+        return "sendfile";
+    case CopyMethod::Userspace:
+        return "userspace";
+    case CopyMethod::IoUring:
+        return "io_uring";
+    }
+    return "unknown";
+}
+
+#if defined(__linux__)
+
+namespace {
+
+constexpr size_t kUserspaceBufferSize = 1 << 20;
+constexpr size_t kKernelChunk = 1 << 30;
+
+[[noreturn]] void fail(const std::string& what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+class Fd {
+public:
+    explicit Fd(int fd) : fd_(fd) {}
+    ~Fd() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+    Fd(const Fd&) = delete;
+    Fd& operator=(const Fd&) = delete;
+
+    int get() const { return fd_; }
+
+    void close(const std::string& what) {
+        const int fd = fd_;
+        fd_ = -1;
+        if (::close(fd) != 0) fail(what);
+    }
+
+private:
+    int fd_;
+};
+
+// 这些错误表示当前文件系统/内核不支持该方式，换下一种
+bool unsupported(int error) {
+    return error == ENOSYS || error == EOPNOTSUPP || error == ENOTTY || error == EXDEV ||
+           error == EINVAL || error == EPERM || error == ENOTSUP;
+}
+
+// 返回 false 表示一个字节都没复制且不支持该方式
+template <typename Step>
+bool copyLoop(Step step, const std::string& what) {
+    bool copiedAny = false;
+    for (;;) {
+        const ssize_t n = step();
+        if (n > 0) {
+            copiedAny = true;
+            continue;
+        }
+        if (n == 0) {
+            return true;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (!copiedAny && unsupported(errno)) {
+            return false;
+        }
+        fail(what);
+    }
+}
+
+} // namespace
+
+CopyMethod copyFileFast(const std::filesystem::path& source, const std::filesystem::path& target) {
+    Fd in(::open(source.c_str(), O_RDONLY | O_CLOEXEC));
+    if (in.get() < 0) fail("open " + source.string());
+    Fd out(::open(target.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600));
+    if (out.get() < 0) fail("open " + target.string());
+
+    const std::string what = "copy " + source.string();
+    CopyMethod method = CopyMethod::Userspace;
+    if (::ioctl(out.get(), FICLONE, in.get()) == 0) {
+        method = CopyMethod::Reflink;
+    } else if (copyLoop([&] { return ::copy_file_range(in.get(), nullptr, out.get(), nullptr, kKernelChunk, 0); }, what)) {
+        method = CopyMethod::CopyFileRange;
+    } else if (copyLoop([&] { return ::sendfile(out.get(), in.get(), nullptr, kKernelChunk); }, what)) {
+        method = CopyMethod::Sendfile;
+    } else {
+        std::vector<char> buffer(kUserspaceBufferSize);
+        for (;;) {
+            const ssize_t n = ::read(in.get(), buffer.data(), buffer.size());
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail(what);
+            }
+            for (ssize_t done = 0; done < n;) {
+                const ssize_t w = ::write(out.get(), buffer.data() + done, static_cast<size_t>(n - done));
+                if (w < 0) {
+                    if (errno == EINTR) continue;
+                    fail("write " + target.string());
+                }
+                done += w;
+            }
+        }
+    }
+
+    out.close("close " + target.string());
+    return method;
+}
+
+void syncToDisk(const std::filesystem::path& path) {
+    Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd.get() < 0) fail("open " + path.string());
+    if (::fsync(fd.get()) != 0) fail("fsync " + path.string());
+    fd.close("close " + path.string());
+}
+
+#else
+
+CopyMethod copyFileFast(const std::filesystem::path& source, const std::filesystem::path& target) {
+    std::error_code ec;
+    std::filesystem::copy_file(source, target, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        throw std::system_error(ec, "copy " + source.string());
+    }
+    return CopyMethod::Userspace;
+}
+
+void syncToDisk(const std::filesystem::path&) {
+    // 没有可移植的 fsync，依赖系统回写
+}
+
+#endif
+
+} // namespace backup::util
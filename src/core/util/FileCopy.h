@@ -0,0 +1,34 @@
+#pragma once
+
+#include <filesystem>
+
+namespace backup::util {
+
+/**
+ * 文件复制的实际方式，按尝试顺序排列
+ */
+enum class CopyMethod {
+    Reflink,       // FICLONE：共享数据块（btrfs / XFS 等），不复制数据
+    CopyFileRange, // copy_file_range：内核内复制，部分文件系统可在服务端/存储端完成
+    Sendfile,      // sendfile：内核内复制
+    Userspace,     // 大缓冲区 read/write
+    IoUring,       // 经由 io_uring 批量复制（见 IoUring.h）
+};
+
+constexpr size_t kCopyMethodCount = 5;
+
+const char* copyMethodName(CopyMethod method);
+
+/**
+ * 复制 source 到 target（截断重写，新建时权限为 0600，由调用方设置权限与时间戳），
+ * 依次尝试 FICLONE、copy_file_range、sendfile，均不支持时退回用户态复制
+ * 返回实际使用的方式；出错时抛出 std::system_error
+ */
+CopyMethod copyFileFast(const std::filesystem::path& source, const std::filesystem::path& target);
+
+/**
+ * fsync 文件或目录（目录用于使其中的新建、改名落盘）；出错时抛出 std::system_error
+ */
+void syncToDisk(const std::filesystem::path& path);
+
+} // namespace backup::util
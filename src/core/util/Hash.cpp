@@ -0,0 +1,149 @@
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace backup::util {
+
+namespace {
+
+constexpr uint64_t P1 = 11400714785074694791ULL;
+constexpr uint64_t P2 = 14029467366897019727ULL;
+constexpr uint64_t P3 = 1609587929392839161ULL;
+constexpr uint64_t P4 = 9650029242287828579ULL;
+constexpr uint64_t P5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const uint8_t* p) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v; // little-endian hosts only, like the rest of the on-disk formats
+}
+
+inline uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+    acc += input * P2;
+    acc = rotl(acc, 31);
+    return acc * P1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t val) {
+    acc ^= round(0, val);
+    return acc * P1 + P4;
+}
+
+} // namespace
+
+XxHash64::XxHash64(uint64_t seed) : seed_(seed) {
+    v_[0] = seed + P1 + P2;
+    v_[1] = seed + P2;
+    v_[2] = seed;
+    v_[3] = seed - P1;
+}
+
+void XxHash64::update(const void* data, size_t length) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    const uint8_t* end = p + length;
+    totalLength_ += length;
+
+    if (bufferSize_ + length < 32) {
+        std::memcpy(buffer_ + bufferSize_, p, length);
+        bufferSize_ += length;
+        return;
+    }
+
+    if (bufferSize_ > 0) {
+        const size_t fill = 32 - bufferSize_;
+        std::memcpy(buffer_ + bufferSize_, p, fill);
+        for (int i = 0; i < 4; ++i) {
+            v_[i] = round(v_[i], read64(buffer_ + i * 8));
+        }
+        p += fill;
+        bufferSize_ = 0;
+    }
+
+    for (; p + 32 <= end; p += 32) {
+        v_[0] = round(v_[0], read64(p));
+        v_[1] = round(v_[1], read64(p + 8));
+        v_[2] = round(v_[2], read64(p + 16));
+        v_[3] = round(v_[3], read64(p + 24));
+    }
+
+    bufferSize_ = static_cast<size_t>(end - p);
+    std::memcpy(buffer_, p, bufferSize_);
+}
+
+uint64_t XxHash64::digest() const {
+    uint64_t h;
+    if (totalLength_ >= 32) {
+        h = rotl(v_[0], 1) + rotl(v_[1], 7) + rotl(v_[2], 12) + rotl(v_[3], 18);
+        for (int i = 0; i < 4; ++i) {
+            h = mergeRound(h, v_[i]);
+        }
+    } else {
+        h = seed_ + P5;
+    }
+    h += totalLength_;
+
+    const uint8_t* p = buffer_;
+    const uint8_t* end = buffer_ + bufferSize_;
+    for (; p + 8 <= end; p += 8) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * P1 + P4;
+    }
+    if (p + 4 <= end) {
+        h ^= static_cast<uint64_t>(read32(p)) * P1;
+        h = rotl(h, 23) * P2 + P3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * P5;
+        h = rotl(h, 11) * P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t xxhash64(const void* data, size_t length, uint64_t seed) {
+    XxHash64 hasher(seed);
+    hasher.update(data, length);
+    return hasher.digest();
+}
+
+uint64_t fingerprintFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open file for fingerprint: " + path.string());
+    }
+
+    XxHash64 hasher;
+    std::vector<char> buffer(1 << 20);
+    while (in) {
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hasher.update(buffer.data(), static_cast<size_t>(in.gcount()));
+    }
+
+    return fingerprintOf(hasher);
+}
+
+uint64_t fingerprintOf(const XxHash64& hasher) {
+    const uint64_t h = hasher.digest();
+    return h == 0 ? 1 : h;
+}
+
+} // namespace backup::util
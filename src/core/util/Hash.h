@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+namespace backup::util {
+
+/**
+ * XXH64 流式哈希，用于快速内容指纹（非加密用途）
+ */
+class XxHash64 {
+public:
+    explicit XxHash64(uint64_t seed = 0);
+
+    void update(const void* data, size_t length);
+    uint64_t digest() const;
+
+private:
+    uint64_t v_[4];
+    uint64_t totalLength_ = 0;
+    uint8_t buffer_[32];
+    size_t bufferSize_ = 0;
+    uint64_t seed_;
+};
+
+/**
+ * 一次性计算 XXH64
+ */
+uint64_t xxhash64(const void* data, size_t length, uint64_t seed = 0);
+
+/**
+ * 文件内容指纹；0 保留为"未知"，因此结果永不为 0
+ * 文件无法读取时抛出 std::runtime_error
+ */
+uint64_t fingerprintFile(const std::filesystem::path& path);
+
+/**
+ * 由对文件全部内容流式计算的 XXH64 得到指纹，与 fingerprintFile 的结果相同；
+ * 供复制、压缩等本来就要读取文件的路径顺带计算，不必再读一遍
+ */
+uint64_t fingerprintOf(const XxHash64& hasher);
+
+} // namespace backup::util
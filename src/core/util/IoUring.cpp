@@ -0,0 +1,438 @@
+#include "IoUring.h"
+
+#if defined(__linux__)
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <system_error>
+#include <unistd.h>
+#endif
+
+namespace backup::util {
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+
+namespace {
+
+constexpr size_t kBufferSize = 256 * 1024;
+
+// 直接使用系统调用的最小 io_uring 封装（不依赖 liburing）
+class Ring {
+public:
+    explicit Ring(unsigned entries) {
+        io_uring_params params{};
+        fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_setup");
+        }
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMmap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+
+        sqRing_ = map(sqRingSize_, IORING_OFF_SQ_RING);
+        cqRing_ = singleMmap ? sqRing_ : map(cqRingSize_, IORING_OFF_CQ_RING);
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(map(sqesSize_, IORING_OFF_SQES));
+
+        auto* sq = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqEntries_ = params.sq_entries;
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        localTail_ = *sqTail_;
+
+        auto* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~Ring() {
+        if (sqes_) ::munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_) ::munmap(cqRing_, cqRingSize_);
+        if (sqRing_) ::munmap(sqRing_, sqRingSize_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    bool supports(std::initializer_list<int> ops) {
+        std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            return false;
+        }
+        for (int op : ops) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void registerBuffers(const std::vector<iovec>& buffers) {
+        if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS,
+                      buffers.data(), static_cast<unsigned>(buffers.size())) < 0) {
+            throw std::system_error(errno, std::generic_category(), "io_uring_register");
+        }
+    }
+
+    // 取一个空闲 SQE；队列已满时先提交再取
+    io_uring_sqe* next() {
+        if (localTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+            submit(0);
+        }
+        const unsigned index = localTail_ & sqMask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqArray_[index] = index;
+        ++localTail_;
+        ++unsubmitted_;
+        return sqe;
+    }
+
+    // 提交所有新 SQE，并等待至少 waitFor 个完成事件
+    void submit(unsigned waitFor) {
+        __atomic_store_n(sqTail_, localTail_, __ATOMIC_RELEASE);
+        const unsigned flags = waitFor > 0 ? IORING_ENTER_GETEVENTS : 0;
+        for (;;) {
+            const long r = ::syscall(__NR_io_uring_enter, fd_, unsubmitted_, waitFor, flags, nullptr, 0);
+            if (r >= 0) {
+                unsubmitted_ -= std::min<unsigned>(unsubmitted_, static_cast<unsigned>(r));
+                if (unsubmitted_ == 0) {
+                    return;
+                }
+                continue;
+            }
+            if (errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "io_uring_enter");
+            }
+        }
+    }
+
+    bool pop(io_uring_cqe& out) {
+        const unsigned head = *cqHead_;
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        out = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned localTail_ = 0;
+    unsigned unsubmitted_ = 0;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+
+    void* map(size_t size, off_t offset) {
+        void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+        if (p == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "io_uring mmap");
+        }
+        return p;
+    }
+};
+
+bool supportsCopyOps(Ring& ring) {
+    return ring.supports({IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ_FIXED,
+                          IORING_OP_WRITE_FIXED, IORING_OP_CLOSE});
+}
+
+enum Op : uint64_t { OpenSource, Stat, OpenTarget, Read, Write, CloseSource, CloseTarget };
+
+// 每个在途文件占一个槽位和一块注册缓冲区：
+// 打开两端并 statx → 读/写循环 → 设置权限与 mtime → 关闭两端
+struct Slot {
+    CopyJob* job = nullptr;
+    std::string source;
+    std::string target;
+    struct statx stx {};
+    int sourceFd = -1;
+    int targetFd = -1;
+    int error = 0;
+    unsigned outstanding = 0;
+    uint64_t offset = 0;   // 已写出的字节数
+    uint32_t length = 0;   // 缓冲区中的有效字节
+    uint32_t written = 0;  // 其中已写出的部分
+};
+
+class Copier {
+public:
+    Copier(Ring& ring, unsigned slots) : ring_(ring), slots_(slots), storage_(slots * kBufferSize) {
+        std::vector<iovec> buffers(slots);
+        for (unsigned i = 0; i < slots; ++i) {
+            buffers[i] = {buffer(i), kBufferSize};
+        }
+        ring_.registerBuffers(buffers);
+    }
+
+    void run(std::vector<CopyJob>& jobs) {
+        size_t nextJob = 0;
+        std::vector<unsigned> idle;
+        for (unsigned i = slots_.size(); i-- > 0;) {
+            idle.push_back(i);
+        }
+
+        size_t active = 0;
+        for (;;) {
+            while (!idle.empty() && nextJob < jobs.size()) {
+                start(idle.back(), jobs[nextJob++]);
+                idle.pop_back();
+                ++active;
+            }
+            if (active == 0) {
+                return;
+            }
+            ring_.submit(1);
+
+            io_uring_cqe cqe;
+            while (ring_.pop(cqe)) {
+                const unsigned index = static_cast<unsigned>(cqe.user_data >> 3);
+                if (complete(index, static_cast<Op>(cqe.user_data & 7), cqe.res)) {
+                    idle.push_back(index);
+                    --active;
+                }
+            }
+        }
+    }
+
+private:
+    Ring& ring_;
+    std::vector<Slot> slots_;
+    std::vector<char> storage_;
+
+    char* buffer(unsigned index) { return storage_.data() + index * kBufferSize; }
+
+    io_uring_sqe* prepare(unsigned index, Op op, uint8_t opcode) {
+        io_uring_sqe* sqe = ring_.next();
+        sqe->opcode = opcode;
+        sqe->user_data = (static_cast<uint64_t>(index) << 3) | op;
+        ++slots_[index].outstanding;
+        return sqe;
+    }
+
+    void start(unsigned index, CopyJob& job) {
+        Slot& slot = slots_[index];
+        slot = Slot{};
+        slot.job = &job;
+        slot.source = job.source.string();
+        slot.target = job.target.string();
+
+        io_uring_sqe* sqe = prepare(index, OpenSource, IORING_OP_OPENAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.source.c_str());
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+        sqe = prepare(index, Stat, IORING_OP_STATX);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.source.c_str());
+        sqe->len = STATX_MODE | STATX_MTIME;
+        sqe->off = reinterpret_cast<uint64_t>(&slot.stx);
+
+        sqe = prepare(index, OpenTarget, IORING_OP_OPENAT);
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(slot.target.c_str());
+        sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        sqe->len = 0600;
+    }
+
+    void read(unsigned index) {
+        Slot& slot = slots_[index];
+        io_uring_sqe* sqe = prepare(index, Read, IORING_OP_READ_FIXED);
+        sqe->fd = slot.sourceFd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer(index));
+        sqe->len = kBufferSize;
+        sqe->off = slot.offset;
+        sqe->buf_index = static_cast<uint16_t>(index);
+    }
+
+    void write(unsigned index) {
+        Slot& slot = slots_[index];
+        io_uring_sqe* sqe = prepare(index, Write, IORING_OP_WRITE_FIXED);
+        sqe->fd = slot.targetFd;
+        sqe->addr = reinterpret_cast<uint64_t>(buffer(index) + slot.written);
+        sqe->len = slot.length - slot.written;
+        sqe->off = slot.offset + slot.written;
+        sqe->buf_index = static_cast<uint16_t>(index);
+    }
+
+    // 返回 true 表示槽位已空闲
+    bool close(unsigned index) {
+        Slot& slot = slots_[index];
+        if (slot.sourceFd >= 0) {
+            prepare(index, CloseSource, IORING_OP_CLOSE)->fd = slot.sourceFd;
+        }
+        if (slot.targetFd >= 0) {
+            prepare(index, CloseTarget, IORING_OP_CLOSE)->fd = slot.targetFd;
+        }
+        return slot.outstanding == 0 && finish(index);
+    }
+
+    bool finish(unsigned index) {
+        slots_[index].job->error = slots_[index].error;
+        return true;
+    }
+
+    void fail(Slot& slot, int res) {
+        if (slot.error == 0) {
+            slot.error = -res;
+        }
+    }
+
+    bool complete(unsigned index, Op op, int res) {
+        Slot& slot = slots_[index];
+        --slot.outstanding;
+        switch (op) {
+        case OpenSource:
+        case OpenTarget:
+            if (res < 0) {
+                fail(slot, res);
+            } else {
+                (op == OpenSource ? slot.sourceFd : slot.targetFd) = res;
+            }
+            break;
+        case Stat:
+            if (res < 0) {
+                fail(slot, res);
+            }
+            break;
+        case Read:
+            if (res < 0) {
+                fail(slot, res);
+                return close(index);
+            }
+            if (res == 0) {
+                return finishData(index);
+            }
+            slot.length = static_cast<uint32_t>(res);
+            slot.written = 0;
+            write(index);
+            return false;
+        case Write:
+            if (res <= 0) {
+                fail(slot, res == 0 ? -EIO : res);
+                return close(index);
+            }
+            slot.written += static_cast<uint32_t>(res);
+            if (slot.written < slot.length) {
+                write(index);
+            } else {
+                slot.offset += slot.length;
+                read(index);
+            }
+            return false;
+        case CloseSource:
+        case CloseTarget:
+            (op == CloseSource ? slot.sourceFd : slot.targetFd) = -1;
+            if (res < 0) {
+                fail(slot, res);
+            }
+            return slot.outstanding == 0 && finish(index);
+        }
+
+        // 打开阶段：三个请求都完成后开始读，或直接关闭已打开的一端
+        if (slot.outstanding > 0) {
+            return false;
+        }
+        if (slot.error != 0) {
+            return close(index);
+        }
+        read(index);
+        return false;
+    }
+
+    bool finishData(unsigned index) {
+        Slot& slot = slots_[index];
+        struct timespec times[2];
+        times[0].tv_sec = 0;
+        times[0].tv_nsec = UTIME_OMIT;
+        times[1].tv_sec = slot.stx.stx_mtime.tv_sec;
+        times[1].tv_nsec = slot.stx.stx_mtime.tv_nsec;
+        if (::fchmod(slot.targetFd, slot.stx.stx_mode & 07777) != 0 ||
+            ::futimens(slot.targetFd, times) != 0) {
+            fail(slot, -errno);
+        }
+        return close(index);
+    }
+};
+
+} // namespace
+
+bool ioUringAvailable() {
+    static const bool available = [] {
+        try {
+            Ring ring(4);
+            return supportsCopyOps(ring);
+        } catch (const std::system_error&) {
+            return false;
+        }
+    }();
+    return available;
+}
+
+bool copyFilesWithIoUring(std::vector<CopyJob>& jobs, unsigned filesInFlight) {
+    if (!ioUringAvailable()) {
+        return false;
+    }
+    const unsigned slots = std::clamp<unsigned>(filesInFlight, 1, 256);
+    // 每个槽位同时最多 3 个请求（打开两端与 statx）
+    // ring 先于 copier 析构：出错退出时内核不再写入槽位的缓冲区
+    std::unique_ptr<Copier> copier;
+    std::unique_ptr<Ring> ring;
+    try {
+        ring = std::make_unique<Ring>(slots * 4);
+        copier = std::make_unique<Copier>(*ring, slots);
+    } catch (const std::system_error&) {
+        // 例如注册缓冲区超出 RLIMIT_MEMLOCK
+        return false;
+    }
+    copier->run(jobs);
+    return true;
+}
+
+#else
+
+bool ioUringAvailable() {
+    return false;
+}
+
+bool copyFilesWithIoUring(std::vector<CopyJob>&, unsigned) {
+    return false;
+}
+
+#endif
+
+} // namespace backup::util
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace backup::util {
+
+/**
+ * 一个文件复制任务；error 为 0 表示成功，否则为 errno
+ */
+struct CopyJob {
+    std::filesystem::path source;
+    std::filesystem::path target;
+    int error = 0;
+};
+
+/**
+ * 当前内核是否支持 io_uring 及复制所需的操作
+ * （openat / statx / read_fixed / write_fixed / close）；非 Linux 平台恒为 false
+ */
+bool ioUringAvailable();
+
+/**
+ * 用 io_uring 批量复制文件：filesInFlight 个文件同时在途，openat/statx/close 也经由
+ * io_uring 批量提交，读写使用注册缓冲区；目标文件被截断重写，权限与 mtime 取自源文件
+ * 目标所在目录须已存在
+ * io_uring 不可用时返回 false 且不处理任何任务；否则返回 true，各任务的结果写入 error
+ */
+bool copyFilesWithIoUring(std::vector<CopyJob>& jobs, unsigned filesInFlight = 32);
+
+} // namespace backup::util
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace backup::util {
+
+/**
+ * 用至多 threads 个工作线程对 [0, count) 中的每个下标调用一次 body，
+ * 各线程从共享计数器领取下一个下标，返回时所有调用均已结束
+ * threads <= 1 或 count <= 1 时在调用线程中顺序执行
+ * body 抛出异常后不再领取新的下标，第一个异常在所有线程结束后重新抛出
+ */
+void parallelFor(size_t count, unsigned threads,
+                 const std::function<void(size_t)>& body);
+
+} // namespace backup::util
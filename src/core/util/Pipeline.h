@@ -0,0 +1,132 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace backup::util {
+
+/**
+ * 有序并行流水线：
+ *  - produce 在独立的读取线程中运行，通过 emit 依次交出输入项
+ *  - workers 个线程并行执行 transform
+ *  - 结果在调用线程中按输入顺序交给 consume
+ * 已读取但尚未 consume 的项不超过 window 个，超出时 emit 阻塞（反压），内存有界
+ * 任一阶段抛出异常后流水线停止，所有线程结束后在调用线程中重新抛出第一个异常
+ */
+template <typename In, typename Out>
+void runOrderedPipeline(unsigned workers, size_t window,
+                        const std::function<void(const std::function<void(In)>&)>& produce,
+                        const std::function<Out(In&)>& transform,
+                        const std::function<void(Out&)>& consume) {
+    struct Stopped {};
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<std::pair<uint64_t, In>> pending; // 待 transform，按序号升序
+    std::map<uint64_t, Out> done;                 // 已 transform，等待按序 consume
+    uint64_t produced = 0;
+    uint64_t consumed = 0;
+    bool producerDone = false;
+    bool failed = false;
+    std::exception_ptr error;
+
+    workers = workers == 0 ? 1 : workers;
+    window = window == 0 ? 1 : window;
+
+    auto fail = [&](std::exception_ptr e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) error = e;
+        failed = true;
+        changed.notify_all();
+    };
+
+    auto emit = [&](In item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return failed || produced - consumed < window; });
+        if (failed) {
+            throw Stopped{};
+        }
+        pending.emplace_back(produced++, std::move(item));
+        changed.notify_all();
+    };
+
+    std::thread reader([&] {
+        try {
+            produce(emit);
+        } catch (const Stopped&) {
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        producerDone = true;
+        changed.notify_all();
+    });
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i) {
+        pool.emplace_back([&] {
+            for (;;) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&] {
+                    return failed || !pending.empty() || producerDone;
+                });
+                if (failed || pending.empty()) {
+                    return;
+                }
+                auto task = std::move(pending.front());
+                pending.pop_front();
+                lock.unlock();
+                try {
+                    Out out = transform(task.second);
+                    lock.lock();
+                    done.emplace(task.first, std::move(out));
+                    changed.notify_all();
+                } catch (...) {
+                    fail(std::current_exception());
+                    return;
+                }
+            }
+        });
+    }
+
+    for (;;) {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] {
+            return failed || done.count(consumed) != 0 || (producerDone && consumed == produced);
+        });
+        if (failed || done.count(consumed) == 0) {
+            break;
+        }
+        auto node = done.extract(consumed);
+        lock.unlock();
+        try {
+            consume(node.mapped());
+        } catch (...) {
+            fail(std::current_exception());
+            break;
+        }
+        lock.lock();
+        ++consumed;
+        changed.notify_all();
+    }
+
+    reader.join();
+    for (auto& t : pool) {
+        t.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace backup::util
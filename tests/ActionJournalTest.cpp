@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "backup/ActionJournal.h"
+
+using namespace backup::core;
+namespace fs = std::filesystem;
+
+class ActionJournalTest : public ::testing::Test
+{
+protected:
+    fs::path root;
+    fs::path path;
+
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / "journal_test";
+        fs::create_directories(root);
+        path = root / ActionJournal::kFile;
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+};
+
+TEST_F(ActionJournalTest, ReopenedJournalContainsRecordedEntries)
+{
+    {
+        ActionJournal journal(path, "none|none|files|/src");
+        EXPECT_FALSE(journal.resumed());
+        journal.record("F|a.txt|3|100");
+        journal.record("X|old");
+    }
+
+    ActionJournal journal(path, "none|none|files|/src");
+    EXPECT_TRUE(journal.resumed());
+    EXPECT_TRUE(journal.contains("F|a.txt|3|100"));
+    EXPECT_TRUE(journal.contains("X|old"));
+    EXPECT_FALSE(journal.contains("F|a.txt|3|101"));
+
+    journal.remove();
+    EXPECT_FALSE(fs::exists(path));
+}
+
+// 达到批量条数时写入磁盘，不必等到析构
+TEST_F(ActionJournalTest, SyncsAfterBatch)
+{
+    ActionJournal::Options options;
+    options.syncEntries = 2;
+    options.syncInterval = std::chrono::hours(1);
+    ActionJournal journal(path, "h", options);
+    journal.record("one");
+    const auto headerOnly = fs::file_size(path);
+    journal.record("two");
+    EXPECT_GT(fs::file_size(path), headerOnly);
+}
+
+// 条目所指的数据先落盘，之后才写入条目
+TEST_F(ActionJournalTest, SyncsDataBeforeWritingEntries)
+{
+    auto journalText = [&]
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    };
+
+    std::vector<std::string> seenAtSync;
+    ActionJournal::Options options;
+    options.syncEntries = 1;
+    options.syncData = [&]
+    { seenAtSync.push_back(journalText()); };
+    ActionJournal journal(path, "h", options);
+
+    std::ofstream(root / "a.txt") << "abc";
+    journal.record("F|a.txt|3|100");
+
+    ASSERT_EQ(seenAtSync.size(), 1u);
+    EXPECT_EQ(seenAtSync[0].find("F|a.txt"), std::string::npos);
+    EXPECT_NE(journalText().find("F|a.txt|3|100\n"), std::string::npos);
+}
+
+TEST_F(ActionJournalTest, DifferentHeaderDiscardsEntries)
+{
+    {
+        ActionJournal journal(path, "none|none|files|/src");
+        journal.record("F|a.txt|3|100");
+    }
+
+    ActionJournal journal(path, "lz77|aes|files|/src");
+    EXPECT_FALSE(journal.resumed());
+    EXPECT_FALSE(journal.contains("F|a.txt|3|100"));
+}
+
+// 写到一半的最后一行被截掉，之后追加的条目从新的一行开始
+TEST_F(ActionJournalTest, TornLastLineIsDropped)
+{
+    {
+        ActionJournal journal(path, "h");
+        journal.record("F|a.txt|3|100");
+    }
+    std::ofstream(path, std::ios::binary | std::ios::app) << "F|b.txt|3|1";
+
+    {
+        ActionJournal journal(path, "h");
+        EXPECT_TRUE(journal.contains("F|a.txt|3|100"));
+        EXPECT_FALSE(journal.contains("F|b.txt|3|1"));
+        journal.record("F|b.txt|3|100");
+    }
+
+    ActionJournal journal(path, "h");
+    EXPECT_TRUE(journal.contains("F|a.txt|3|100"));
+    EXPECT_TRUE(journal.contains("F|b.txt|3|100"));
+    EXPECT_FALSE(journal.contains("F|b.txt|3|1F|b.txt|3|100"));
+}
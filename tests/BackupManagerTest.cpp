@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <fstream>
+#include <set>
 #include <string>
 #include "backup/BackupManager.h"
 
@@ -263,6 +264,596 @@ TEST_F(BackupManagerTest, RestoreFromAesEncryptedBackupWithWrongPassword)
     }
 }
 
+// 大文件分块，由多个线程压缩/解压
+TEST_F(BackupManagerTest, MultiBlockFilesUseCompressionThreads)
+{
+    std::string big;
+    for (int i = 0; big.size() < (5u << 19); ++i)
+        big += "record " + std::to_string(i % 97) + ";";
+    writeFile(sourceRoot / "big.log", big);
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Huffman;
+    config.enableEncryption = true;
+    config.encryptionKey = "blocks";
+    config.compressionThreads = 4;
+    BackupManager mgr(config);
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+    EXPECT_LT(fs::file_size(backupRoot / "big.log"), big.size());
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.encryptionKey = "blocks";
+    restoreCfg.compressionThreads = 4;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "big.log"), big);
+}
+
+// io_uring 不可用时自动回退，结果与阻塞复制一致
+TEST_F(BackupManagerTest, IoUringBackupAndRestore)
+{
+    for (int i = 0; i < 30; ++i)
+        writeFile(sourceRoot / ("d" + std::to_string(i % 3)) / ("f" + std::to_string(i)), std::string(i * 10, 'x'));
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.useIoUring = true;
+    BackupManager mgr(config);
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.useIoUring = true;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    for (int i = 0; i < 30; ++i)
+    {
+        const fs::path rel = fs::path("d" + std::to_string(i % 3)) / ("f" + std::to_string(i));
+        EXPECT_EQ(readFile(restoreRoot / rel), std::string(i * 10, 'x'));
+        EXPECT_EQ(fs::last_write_time(restoreRoot / rel), fs::last_write_time(sourceRoot / rel));
+    }
+}
+
+// 不压缩不加密时走内核复制路径，并记录每种方式复制的文件数
+TEST_F(BackupManagerTest, PlainCopiesReportCopyMethod)
+{
+    writeFile(sourceRoot / "a.txt", std::string(200000, 'a'));
+    writeFile(sourceRoot / "sub/b.txt", "plain");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    BackupManager mgr(config);
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+    uint64_t copied = 0;
+    for (const auto &entry : mgr.copyMethodCounts())
+        copied += entry.second;
+    EXPECT_EQ(copied, 2u);
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), std::string(200000, 'a'));
+    EXPECT_EQ(readFile(restoreRoot / "sub/b.txt"), "plain");
+    EXPECT_EQ(fs::last_write_time(restoreRoot / "a.txt"), fs::last_write_time(sourceRoot / "a.txt"));
+    copied = 0;
+    for (const auto &entry : restoreMgr.copyMethodCounts())
+        copied += entry.second;
+    EXPECT_EQ(copied, 2u);
+}
+
+// 块存储：修改大文件中的少量字节只写入附近的块，删除后无用的块被清理
+TEST_F(BackupManagerTest, ChunkedStorageWritesOnlyChangedChunks)
+{
+    std::string big(3 << 20, '\0');
+    uint32_t state = 12345;
+    for (auto &c : big)
+    {
+        state = state * 1103515245u + 12345u;
+        c = static_cast<char>(state >> 24);
+    }
+    writeFile(sourceRoot / "vm.img", big);
+    writeFile(sourceRoot / "copy/vm.img", big);
+    writeFile(sourceRoot / "small.txt", "small");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.deleteRemoved = true;
+    config.chunkedStorage = true;
+    config.enableEncryption = true;
+    config.encryptionKey = "chunks";
+    config.compressionThreads = 2;
+    {
+        BackupManager mgr(config);
+        mgr.scan();
+        ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+        const auto stats = mgr.chunkStats();
+        EXPECT_GT(stats.chunks, 2 * stats.newChunks - 2); // 两份相同的大文件只存一份
+    }
+    EXPECT_EQ(readMetaValue(backupRoot / ".backupmeta", "storage"), "chunks");
+
+    big[1 << 20] ^= 0x5a;
+    writeFile(sourceRoot / "vm.img", big);
+    fs::remove_all(sourceRoot / "copy");
+    {
+        BackupManager mgr(config);
+        mgr.scan();
+        ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+        EXPECT_LE(mgr.chunkStats().newChunks, 2u);
+    }
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.encryptionKey = "chunks";
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "vm.img"), big);
+    EXPECT_EQ(readFile(restoreRoot / "small.txt"), "small");
+    EXPECT_FALSE(fs::exists(restoreRoot / "copy"));
+    EXPECT_EQ(fs::last_write_time(restoreRoot / "vm.img"), fs::last_write_time(sourceRoot / "vm.img"));
+
+    // 被替换的块已清理：剩余块数与清单引用的块数一致
+    size_t stored = 0;
+    for (const auto &entry : fs::recursive_directory_iterator(backupRoot / ".chunks"))
+        stored += entry.is_regular_file();
+    EXPECT_EQ(stored, ChunkStore::readManifest(backupRoot / "vm.img").size() + 1);
+
+    // 改回逐文件存储时全部重写，块存储被删除
+    config.chunkedStorage = false;
+    BackupManager plain(config);
+    plain.scan();
+    ASSERT_TRUE(plain.executePlan(plain.buildPlan()));
+    EXPECT_FALSE(fs::exists(backupRoot / ".chunks"));
+}
+
+// 增量修补：更新大文件时只写入变化的块；备份文件被改动过时整体重写
+TEST_F(BackupManagerTest, DeltaUpdatesPatchChangedBlocks)
+{
+    std::string data(4 << 20, '\0');
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>((i * 131) ^ (i >> 13));
+    writeFile(sourceRoot / "db/app.sqlite", data);
+    writeFile(sourceRoot / "small.txt", "small");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.deleteRemoved = true;
+    config.deltaUpdates = true;
+    auto backupOnce = [&]
+    {
+        BackupManager mgr(config);
+        mgr.scan();
+        EXPECT_TRUE(mgr.executePlan(mgr.buildPlan()));
+        return mgr.deltaStats();
+    };
+
+    EXPECT_EQ(backupOnce().files, 0u);
+    EXPECT_TRUE(fs::exists(backupRoot / ".signatures/db/app.sqlite"));
+    EXPECT_FALSE(fs::exists(backupRoot / ".signatures/small.txt"));
+
+    data[(1 << 20) + 3] ^= 0x11;
+    data += "appended";
+    writeFile(sourceRoot / "db/app.sqlite", data);
+    auto stats = backupOnce();
+    EXPECT_EQ(stats.files, 1u);
+    EXPECT_EQ(stats.bytesTotal, data.size());
+    EXPECT_LT(stats.bytesWritten, data.size() / 8);
+    EXPECT_EQ(readFile(backupRoot / "db/app.sqlite"), data);
+
+    // 备份文件被外部改动，签名失效
+    writeFile(backupRoot / "db/app.sqlite", "tampered");
+    data[5] ^= 0x22;
+    writeFile(sourceRoot / "db/app.sqlite", data);
+    EXPECT_EQ(backupOnce().files, 0u);
+    EXPECT_EQ(readFile(backupRoot / "db/app.sqlite"), data);
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "db/app.sqlite"), data);
+    EXPECT_FALSE(fs::exists(restoreRoot / ".signatures"));
+
+    // 删除文件时签名一起删除；关闭 delta 后签名目录被清理
+    fs::remove_all(sourceRoot / "db");
+    backupOnce();
+    EXPECT_FALSE(fs::exists(backupRoot / ".signatures/db"));
+    config.deltaUpdates = false;
+    backupOnce();
+    EXPECT_FALSE(fs::exists(backupRoot / ".signatures"));
+}
+
+// 快照：未变化的文件硬链接到上一个快照，旧快照的内容不受新备份影响
+TEST_F(BackupManagerTest, SnapshotsHardlinkUnchangedFiles)
+{
+    writeFile(sourceRoot / "a.txt", "version one");
+    writeFile(sourceRoot / "sub/b.txt", "removed later");
+    writeFile(sourceRoot / "sub/d.txt", "unchanged");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.snapshots = true;
+    BackupManager first(config);
+    first.scan();
+    ASSERT_TRUE(first.executePlan(first.buildPlan()));
+    const std::string firstId = first.snapshotId();
+    EXPECT_FALSE(firstId.empty());
+
+    writeFile(sourceRoot / "a.txt", "version two, longer");
+    fs::remove(sourceRoot / "sub/b.txt");
+    writeFile(sourceRoot / "c.txt", "new");
+    for (bool streaming : {false, true})
+    {
+        config.streamingPlan = streaming;
+        BackupManager next(config);
+        next.scan();
+        ASSERT_TRUE(next.executePlan(next.buildPlan()));
+    }
+
+    const auto snapshots = BackupManager::listSnapshots(backupRoot);
+    ASSERT_EQ(snapshots.size(), 3u);
+    EXPECT_EQ(snapshots.front(), firstId);
+    const fs::path oldSnap = backupRoot / "snapshots" / firstId;
+    const fs::path newSnap = backupRoot / "snapshots" / snapshots.back();
+    EXPECT_TRUE(fs::equivalent(oldSnap / "sub/d.txt", newSnap / "sub/d.txt"));
+    EXPECT_FALSE(fs::equivalent(oldSnap / "a.txt", newSnap / "a.txt"));
+    EXPECT_EQ(readFile(oldSnap / "a.txt"), "version one");
+    EXPECT_TRUE(fs::exists(oldSnap / "sub/b.txt"));
+    EXPECT_FALSE(fs::exists(newSnap / "sub/b.txt"));
+    EXPECT_TRUE(fs::exists(newSnap / ".backupmeta"));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager latest(restoreCfg);
+    latest.restore(restoreRoot);
+    EXPECT_EQ(latest.snapshotId(), snapshots.back());
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), "version two, longer");
+    EXPECT_EQ(readFile(restoreRoot / "c.txt"), "new");
+    EXPECT_FALSE(fs::exists(restoreRoot / "sub/b.txt"));
+
+    fs::remove_all(restoreRoot);
+    BackupManager older(restoreCfg);
+    older.restore(restoreRoot, firstId);
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), "version one");
+    EXPECT_EQ(readFile(restoreRoot / "sub/b.txt"), "removed later");
+    EXPECT_FALSE(fs::exists(restoreRoot / "c.txt"));
+
+    BackupManager missing(restoreCfg);
+    EXPECT_THROW(missing.restore(restoreRoot, "19700101T000000Z"), std::runtime_error);
+}
+
+// snapshots/ 下名字不是快照 ID 的目录被忽略，不影响备份与还原
+TEST_F(BackupManagerTest, SnapshotsIgnoreForeignDirectories)
+{
+    writeFile(sourceRoot / "a.txt", "one");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.snapshots = true;
+    BackupManager first(config);
+    first.scan();
+    ASSERT_TRUE(first.executePlan(first.buildPlan()));
+    fs::copy(backupRoot / "snapshots" / first.snapshotId(), backupRoot / "snapshots/old_copy",
+             fs::copy_options::recursive);
+    fs::create_directories(backupRoot / "snapshots/99999999T999999Z_x");
+
+    writeFile(sourceRoot / "a.txt", "two");
+    BackupManager second(config);
+    second.scan();
+    ASSERT_TRUE(second.executePlan(second.buildPlan()));
+
+    const auto snapshots = BackupManager::listSnapshots(backupRoot);
+    EXPECT_EQ(snapshots, (std::vector<std::string>{first.snapshotId(), second.snapshotId()}));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager latest(restoreCfg);
+    latest.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), "two");
+}
+
+// 块存储的快照共用一个 .chunks，更新文件时不会改写旧快照中的清单
+TEST_F(BackupManagerTest, ChunkedSnapshotsShareChunkStore)
+{
+    writeFile(sourceRoot / "data.bin", std::string(100000, 'd'));
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.snapshots = true;
+    config.chunkedStorage = true;
+    BackupManager first(config);
+    first.scan();
+    ASSERT_TRUE(first.executePlan(first.buildPlan()));
+
+    writeFile(sourceRoot / "data.bin", std::string(100000, 'e'));
+    BackupManager second(config);
+    second.scan();
+    ASSERT_TRUE(second.executePlan(second.buildPlan()));
+    EXPECT_TRUE(fs::is_directory(backupRoot / ".chunks"));
+    EXPECT_FALSE(fs::exists(backupRoot / "snapshots" / second.snapshotId() / ".chunks"));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager older(restoreCfg);
+    older.restore(restoreRoot, first.snapshotId());
+    EXPECT_EQ(readFile(restoreRoot / "data.bin"), std::string(100000, 'd'));
+}
+
+// 块存储改用压缩后重写全部块：旧格式的块不会被当作新格式沿用
+TEST_F(BackupManagerTest, ChunkedStorageRewritesChunksWhenCompressionChanges)
+{
+    const std::string data(100000, 'c');
+    writeFile(sourceRoot / "data.bin", data);
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.deleteRemoved = true;
+    config.chunkedStorage = true;
+    {
+        BackupManager plain(config);
+        plain.scan();
+        ASSERT_TRUE(plain.executePlan(plain.buildPlan()));
+    }
+
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Lz77;
+    {
+        BackupManager compressed(config);
+        compressed.scan();
+        ASSERT_TRUE(compressed.executePlan(compressed.buildPlan()));
+        EXPECT_GT(compressed.chunkStats().newChunks, 0u);
+    }
+    EXPECT_EQ(readMetaValue(backupRoot / ".backupmeta", "compression"), "lz77");
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "data.bin"), data);
+}
+
+// 小文件写入包文件，备份目录中只有大文件；更新、删除、改名后仍能完整还原
+TEST_F(BackupManagerTest, PackedSmallFilesRoundTrip)
+{
+    writeFile(sourceRoot / "small1.txt", "one");
+    writeFile(sourceRoot / "dir/small2.txt", "two");
+    writeFile(sourceRoot / "dir/small3.txt", "three");
+    writeFile(sourceRoot / "large.bin", std::string(5000, 'L'));
+    const auto mtime = fs::last_write_time(sourceRoot / "dir/small2.txt") - std::chrono::hours(2);
+    fs::last_write_time(sourceRoot / "dir/small2.txt", mtime);
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.packSmallFiles = true;
+    config.packThreshold = 1024;
+    config.detectRenames = true;
+    BackupManager first(config);
+    first.scan();
+    ASSERT_TRUE(first.executePlan(first.buildPlan()));
+    EXPECT_EQ(first.packStats().files, 3u);
+    EXPECT_TRUE(fs::exists(backupRoot / "large.bin"));
+    EXPECT_FALSE(fs::exists(backupRoot / "small1.txt"));
+    EXPECT_FALSE(fs::exists(backupRoot / "dir/small2.txt"));
+    EXPECT_TRUE(fs::exists(backupRoot / ".packindex"));
+    EXPECT_EQ(readMetaValue(backupRoot / ".backupmeta", "storage"), "packs");
+
+    writeFile(sourceRoot / "small1.txt", "one, updated");
+    fs::remove(sourceRoot / "dir/small3.txt");
+    fs::rename(sourceRoot / "dir", sourceRoot / "renamed");
+    writeFile(sourceRoot / "large.bin", "now small");
+    BackupManager second(config);
+    second.scan();
+    ASSERT_TRUE(second.executePlan(second.buildPlan()));
+    EXPECT_FALSE(fs::exists(backupRoot / "large.bin"));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restorer(restoreCfg);
+    restorer.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "small1.txt"), "one, updated");
+    EXPECT_EQ(readFile(restoreRoot / "renamed/small2.txt"), "two");
+    EXPECT_EQ(fs::last_write_time(restoreRoot / "renamed/small2.txt"), mtime);
+    EXPECT_EQ(readFile(restoreRoot / "large.bin"), "now small");
+    EXPECT_FALSE(fs::exists(restoreRoot / "renamed/small3.txt"));
+    EXPECT_FALSE(fs::exists(restoreRoot / "dir"));
+
+    // 改回逐文件存储后全部重写，包文件不再需要
+    config.packSmallFiles = false;
+    BackupManager plain(config);
+    plain.scan();
+    ASSERT_TRUE(plain.executePlan(plain.buildPlan()));
+    EXPECT_EQ(readFile(backupRoot / "small1.txt"), "one, updated");
+    EXPECT_FALSE(fs::exists(backupRoot / ".packs"));
+    EXPECT_FALSE(fs::exists(backupRoot / ".packindex"));
+}
+
+// 中断的执行留下操作日志，再次执行时跳过已完成且源文件未变的操作
+TEST_F(BackupManagerTest, InterruptedBackupResumesFromJournal)
+{
+    writeFile(sourceRoot / "a.txt", "alpha");
+    writeFile(sourceRoot / "b.txt", "beta");
+    writeFile(sourceRoot / "c.txt", "gamma");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.deleteRemoved = false;
+    config.enableEncryption = true;
+    config.encryptionKey = "journal-key";
+
+    // 计划生成后源文件消失，执行失败，元数据不会写入
+    BackupManager first(config);
+    first.scan();
+    auto plan = first.buildPlan();
+    fs::remove(sourceRoot / "c.txt");
+    EXPECT_FALSE(first.executePlan(plan));
+    EXPECT_TRUE(fs::exists(backupRoot / ".journal"));
+    EXPECT_FALSE(fs::exists(backupRoot / ".backupmeta"));
+
+    // 已完成的 a.txt 被跳过（用标记内容检验），变化的 b.txt 重做
+    writeFile(backupRoot / "a.txt", "sentinel");
+    writeFile(backupRoot / "sub/stale.tmp_compress", "partial");
+    writeFile(sourceRoot / "b.txt", "beta, changed");
+    writeFile(sourceRoot / "c.txt", "gamma");
+
+    BackupManager second(config);
+    second.scan();
+    ASSERT_TRUE(second.executePlan(second.buildPlan()));
+    EXPECT_EQ(second.resumedActions(), 1u);
+    EXPECT_EQ(readFile(backupRoot / "a.txt"), "sentinel");
+    EXPECT_FALSE(fs::exists(backupRoot / "sub/stale.tmp_compress"));
+    EXPECT_FALSE(fs::exists(backupRoot / ".journal"));
+    EXPECT_TRUE(fs::exists(backupRoot / ".backupmeta"));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.encryptionKey = "journal-key";
+    BackupManager restorer(restoreCfg);
+    restorer.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "b.txt"), "beta, changed");
+    EXPECT_EQ(readFile(restoreRoot / "c.txt"), "gamma");
+}
+
+// 中断的快照在原目录中接续，不重新创建快照
+TEST_F(BackupManagerTest, InterruptedSnapshotResumesInPlace)
+{
+    writeFile(sourceRoot / "a.txt", "version one");
+    writeFile(sourceRoot / "b.txt", "unchanged");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.snapshots = true;
+    BackupManager first(config);
+    first.scan();
+    ASSERT_TRUE(first.executePlan(first.buildPlan()));
+
+    writeFile(sourceRoot / "a.txt", "version two");
+    writeFile(sourceRoot / "c.txt", "new");
+    BackupManager second(config);
+    second.scan();
+    auto plan = second.buildPlan();
+    fs::rename(sourceRoot / "c.txt", sourceRoot / "c.bak");
+    EXPECT_FALSE(second.executePlan(plan));
+    const fs::path snap = backupRoot / "snapshots" / second.snapshotId();
+    writeFile(snap / "a.txt", "sentinel");
+    fs::rename(sourceRoot / "c.bak", sourceRoot / "c.txt");
+
+    BackupManager third(config);
+    third.scan();
+    ASSERT_TRUE(third.executePlan(third.buildPlan()));
+    EXPECT_EQ(third.snapshotId(), second.snapshotId());
+    EXPECT_EQ(third.resumedActions(), 1u);
+    EXPECT_EQ(readFile(snap / "a.txt"), "sentinel");
+    EXPECT_EQ(readFile(snap / "c.txt"), "new");
+    EXPECT_TRUE(fs::equivalent(snap / "b.txt", backupRoot / "snapshots" / first.snapshotId() / "b.txt"));
+    EXPECT_EQ(readFile(backupRoot / "snapshots" / first.snapshotId() / "a.txt"), "version one");
+    EXPECT_EQ(BackupManager::listSnapshots(backupRoot).size(), 2u);
+}
+
+// 中断后换了压缩方式：不在中断的快照中接续，上一个快照中共用硬链接的文件不被改写
+TEST_F(BackupManagerTest, InterruptedSnapshotWithChangedConfigLeavesBaseIntact)
+{
+    writeFile(sourceRoot / "a.txt", "version one");
+    writeFile(sourceRoot / "b.txt", "unchanged");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.snapshots = true;
+    BackupManager first(config);
+    first.scan();
+    ASSERT_TRUE(first.executePlan(first.buildPlan()));
+    const fs::path base = backupRoot / "snapshots" / first.snapshotId();
+
+    writeFile(sourceRoot / "a.txt", "version two");
+    writeFile(sourceRoot / "c.txt", "new");
+    BackupManager second(config);
+    second.scan();
+    auto plan = second.buildPlan();
+    fs::rename(sourceRoot / "c.txt", sourceRoot / "c.bak");
+    EXPECT_FALSE(second.executePlan(plan));
+    fs::rename(sourceRoot / "c.bak", sourceRoot / "c.txt");
+    ASSERT_TRUE(fs::equivalent(backupRoot / "snapshots" / second.snapshotId() / "b.txt", base / "b.txt"));
+
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Lz77;
+    BackupManager third(config);
+    third.scan();
+    ASSERT_TRUE(third.executePlan(third.buildPlan()));
+    EXPECT_EQ(third.resumedActions(), 0u);
+    EXPECT_EQ(BackupManager::listSnapshots(backupRoot).size(), 2u);
+    EXPECT_EQ(std::distance(fs::directory_iterator(backupRoot / "snapshots"), fs::directory_iterator()), 2);
+    EXPECT_EQ(readFile(base / "a.txt"), "version one");
+    EXPECT_EQ(readFile(base / "b.txt"), "unchanged");
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restorer(restoreCfg);
+    restorer.restore(restoreRoot, first.snapshotId());
+    EXPECT_EQ(readFile(restoreRoot / "b.txt"), "unchanged");
+    fs::remove_all(restoreRoot);
+    restorer.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), "version two");
+    EXPECT_EQ(readFile(restoreRoot / "b.txt"), "unchanged");
+    EXPECT_EQ(readFile(restoreRoot / "c.txt"), "new");
+}
+
+// 压缩与加密直接串联写入目标文件，不产生中间文件
+TEST_F(BackupManagerTest, PipelineLeavesNoTemporaryFiles)
+{
+    writeFile(sourceRoot / "a.txt", std::string(5000, 'a'));
+    writeFile(sourceRoot / "sub/b.txt", "pipeline");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Lz77;
+    config.enableEncryption = true;
+    config.encryptionKey = "pipeline";
+    BackupManager mgr(config);
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.encryptionKey = "pipeline";
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), std::string(5000, 'a'));
+    EXPECT_EQ(readFile(restoreRoot / "sub/b.txt"), "pipeline");
+
+    for (const auto &root : {backupRoot, restoreRoot})
+        for (const auto &entry : fs::recursive_directory_iterator(root))
+            EXPECT_EQ(entry.path().filename().string().find(".tmp_"), std::string::npos) << entry.path();
+
+    // 解密失败时不留下写了一半的文件
+    fs::remove_all(restoreRoot);
+    restoreCfg.encryptionKey = "wrong";
+    BackupManager wrongMgr(restoreCfg);
+    wrongMgr.restore(restoreRoot);
+    EXPECT_FALSE(fs::exists(restoreRoot / "a.txt"));
+}
+
 // 测试压缩加密结合使用
 TEST_F(BackupManagerTest, BackupAndRestoreWithCompressionAndEncryption)
 {
@@ -293,4 +884,360 @@ TEST_F(BackupManagerTest, BackupAndRestoreWithCompressionAndEncryption)
     restoreMgr.restore(restoreRoot);
 
     EXPECT_EQ(readFile(restoreRoot / "large_file.txt"), std::string(2048, 'z'));
-}
\ No newline at end of file
+}
+TEST_F(BackupManagerTest, ScanCacheIsPersistedNextToMetadata)
+{
+    writeFile(sourceRoot / "file.txt", "cached");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.deleteRemoved = true;
+    config.useScanCache = true;
+
+    BackupManager mgr(config);
+    mgr.scan();
+    mgr.executePlan(mgr.buildPlan());
+    EXPECT_TRUE(fs::exists(backupRoot / ".scancache"));
+
+    writeFile(sourceRoot / "file.txt", "cached, then changed");
+    mgr.scan();
+    auto plan = mgr.buildPlan();
+    mgr.executePlan(plan);
+
+    EXPECT_EQ(readFile(backupRoot / "file.txt"), "cached, then changed");
+    EXPECT_TRUE(fs::exists(backupRoot / ".scancache"));
+}
+
+TEST_F(BackupManagerTest, CompressedIncrementalSkipsUnchangedFiles)
+{
+    writeFile(sourceRoot / "same.txt", std::string(512, 's'));
+    writeFile(sourceRoot / "sub/edit.txt", "before");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Huffman;
+    config.enableEncryption = true;
+    config.encryptionKey = "incremental";
+
+    BackupManager mgr(config);
+    mgr.scan();
+    mgr.executePlan(mgr.buildPlan());
+
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+
+    writeFile(sourceRoot / "sub/edit.txt", "after the edit");
+    mgr.scan();
+    auto plan = mgr.buildPlan();
+    ASSERT_EQ(plan.size(), 1u);
+    EXPECT_EQ(plan[0].type, BackupManager::ActionType::UpdateFile);
+    EXPECT_EQ(plan[0].targetPath, backupRoot / "sub/edit.txt");
+}
+
+TEST_F(BackupManagerTest, ChangedStorageFormatRewritesEverything)
+{
+    writeFile(sourceRoot / "a.txt", std::string(300, 'a'));
+    writeFile(sourceRoot / "sub/b.txt", std::string(300, 'b'));
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    BackupManager plain(config);
+    plain.scan();
+    plain.executePlan(plain.buildPlan());
+
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Lz77;
+    BackupManager compressed(config);
+    compressed.scan();
+    auto plan = compressed.buildPlan();
+    EXPECT_EQ(plan.size(), 2u);
+    compressed.executePlan(plan);
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "a.txt"), std::string(300, 'a'));
+    EXPECT_EQ(readFile(restoreRoot / "sub/b.txt"), std::string(300, 'b'));
+}
+
+TEST_F(BackupManagerTest, DetectRenamesMovesDirectoryInsideBackup)
+{
+    writeFile(sourceRoot / "dir/a.txt", std::string(400, 'a'));
+    writeFile(sourceRoot / "dir/b.txt", "b");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Lz77;
+    config.enableEncryption = true;
+    config.encryptionKey = "renames";
+    config.detectRenames = true;
+
+    BackupManager mgr(config);
+    mgr.scan();
+    mgr.executePlan(mgr.buildPlan());
+
+    fs::create_directories(sourceRoot / "moved");
+    fs::rename(sourceRoot / "dir", sourceRoot / "moved/dir2");
+    mgr.scan();
+    auto plan = mgr.buildPlan();
+    ASSERT_EQ(plan.size(), 2u);
+    EXPECT_EQ(plan[0].type, BackupManager::ActionType::RenamePath);
+    EXPECT_EQ(plan[0].sourcePath, backupRoot / "dir");
+    EXPECT_EQ(plan[0].targetPath, backupRoot / "moved/dir2");
+    EXPECT_EQ(plan[1].type, BackupManager::ActionType::CreateDirectory);
+    ASSERT_TRUE(mgr.executePlan(plan));
+    EXPECT_FALSE(fs::exists(backupRoot / "dir"));
+
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.encryptionKey = "renames";
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "moved/dir2/a.txt"), std::string(400, 'a'));
+    EXPECT_EQ(readFile(restoreRoot / "moved/dir2/b.txt"), "b");
+}
+
+TEST_F(BackupManagerTest, DetectRenamesUsesFingerprintFromMetadata)
+{
+    writeFile(sourceRoot / "a.txt", std::string(300, 'x'));
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Huffman;
+    config.detectRenames = true;
+
+    BackupManager mgr(config);
+    mgr.scan();
+    mgr.executePlan(mgr.buildPlan());
+    // an unchanged run must carry the fingerprint into the new metadata
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+    mgr.executePlan({});
+
+    // a copy has a new inode; only the recorded fingerprint can pair it
+    const auto mtime = fs::last_write_time(sourceRoot / "a.txt");
+    fs::create_directories(sourceRoot / "sub");
+    fs::copy_file(sourceRoot / "a.txt", sourceRoot / "sub/a.txt");
+    fs::last_write_time(sourceRoot / "sub/a.txt", mtime);
+    fs::remove(sourceRoot / "a.txt");
+
+    mgr.scan();
+    auto plan = mgr.buildPlan();
+    ASSERT_EQ(plan.size(), 2u);
+    EXPECT_EQ(plan[0].type, BackupManager::ActionType::RenamePath);
+    EXPECT_EQ(plan[0].targetPath, backupRoot / "sub/a.txt");
+    ASSERT_TRUE(mgr.executePlan(plan));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "sub/a.txt"), std::string(300, 'x'));
+}
+
+TEST_F(BackupManagerTest, MetadataRecordsSubtreeHashes)
+{
+    writeFile(sourceRoot / "a.txt", "a");
+    writeFile(sourceRoot / "sub/b.txt", "b");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    BackupManager mgr(config);
+    mgr.scan();
+    mgr.executePlan(mgr.buildPlan());
+
+    backup::filesystem::FileTree source(sourceRoot);
+    source.build();
+    auto metadata = BackupMetadata::readMetadata(backupRoot);
+    EXPECT_EQ(metadata.rootHash, source.getRoot()->getHash());
+    auto rebuilt = BackupMetadata::buildTree(metadata, backupRoot);
+    ASSERT_EQ(rebuilt->getRoot()->getChildren().size(), 2u);
+    EXPECT_EQ(rebuilt->getRoot()->getChildren()[1]->getHash(),
+              source.getRoot()->getChildren()[1]->getHash());
+    EXPECT_TRUE(backup::filesystem::FileTreeDiff::diff(*rebuilt, source).empty());
+}
+
+// 路径中含有字段分隔符 '|' 时元数据仍能完整读回
+TEST_F(BackupManagerTest, MetadataKeepsPathsContainingSeparator)
+{
+    writeFile(sourceRoot / "a|b.txt", "pipe");
+    writeFile(sourceRoot / "x|1|2/c.txt", "nested");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    BackupManager mgr(config);
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+
+    auto metadata = BackupMetadata::readMetadata(backupRoot);
+    std::set<std::string> paths;
+    for (const auto &entry : metadata.files)
+    {
+        paths.insert(entry.relativePath);
+    }
+    EXPECT_EQ(paths, (std::set<std::string>{"a|b.txt", "x|1|2", "x|1|2/c.txt"}));
+
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "a|b.txt"), "pipe");
+    EXPECT_EQ(readFile(restoreRoot / "x|1|2/c.txt"), "nested");
+}
+
+TEST_F(BackupManagerTest, ExcludedPathsAreNotBackedUp)
+{
+    writeFile(sourceRoot / "keep.txt", "keep");
+    writeFile(sourceRoot / "build/out.bin", "artifact");
+    writeFile(sourceRoot / "sub/note.tmp", "scratch");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.excludePatterns = {"build/", "*.tmp"};
+    BackupManager mgr(config);
+    mgr.scan();
+    mgr.executePlan(mgr.buildPlan());
+
+    EXPECT_TRUE(fs::exists(backupRoot / "keep.txt"));
+    EXPECT_TRUE(fs::exists(backupRoot / "sub"));
+    EXPECT_FALSE(fs::exists(backupRoot / "build"));
+    EXPECT_FALSE(fs::exists(backupRoot / "sub/note.tmp"));
+
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+}
+
+TEST_F(BackupManagerTest, StreamingPlanMatchesTreePlan)
+{
+    writeFile(sourceRoot / "keep.txt", "keep");
+    writeFile(sourceRoot / "edit.txt", "before");
+    writeFile(sourceRoot / "gone/inner.txt", "gone");
+    writeFile(sourceRoot / "flip", "file for now");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.deleteRemoved = true;
+    config.streamingPlan = true;
+    BackupManager streaming(config);
+    streaming.scan();
+    EXPECT_TRUE(streaming.executePlan(streaming.buildPlan()));
+    EXPECT_FALSE(fs::exists(backupRoot / ".backupmeta.tmp"));
+
+    streaming.scan();
+    EXPECT_TRUE(streaming.buildPlan().empty());
+
+    writeFile(sourceRoot / "edit.txt", "after the edit");
+    fs::remove_all(sourceRoot / "gone");
+    fs::remove(sourceRoot / "flip");
+    writeFile(sourceRoot / "flip/now.txt", "a directory");
+    writeFile(sourceRoot / "new/added.txt", "added");
+
+    // 流式计划对整棵被删除的子树只生成一个 RemovePath
+    auto describe = [](const std::vector<BackupManager::BackupAction> &plan)
+    {
+        std::vector<std::pair<int, std::string>> out;
+        std::string removedRoot;
+        for (const auto &action : plan)
+        {
+            const std::string target = action.targetPath.string();
+            if (action.type == BackupManager::ActionType::RemovePath)
+            {
+                if (!removedRoot.empty() && target.rfind(removedRoot + "/", 0) == 0)
+                    continue;
+                removedRoot = target;
+            }
+            out.emplace_back(static_cast<int>(action.type), target);
+        }
+        return out;
+    };
+
+    config.streamingPlan = false;
+    BackupManager tree(config);
+    tree.scan();
+    auto expected = describe(tree.buildPlan());
+
+    // 旧条目来自 .backupmeta，也可以来自备份目录本身
+    for (bool fromMetadata : {true, false})
+    {
+        config.streamingPlan = true;
+        config.diffAgainstMetadata = fromMetadata;
+        BackupManager mgr(config);
+        mgr.scan();
+        EXPECT_EQ(describe(mgr.buildPlan()), expected);
+    }
+
+    config.diffAgainstMetadata = true;
+    BackupManager mgr(config);
+    mgr.scan();
+    EXPECT_TRUE(mgr.executePlan(mgr.buildPlan()));
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    EXPECT_EQ(readFile(restoreRoot / "edit.txt"), "after the edit");
+    EXPECT_EQ(readFile(restoreRoot / "flip/now.txt"), "a directory");
+    EXPECT_EQ(readFile(restoreRoot / "new/added.txt"), "added");
+    EXPECT_FALSE(fs::exists(restoreRoot / "gone"));
+}
+
+TEST_F(BackupManagerTest, ParallelExecutionMatchesSerial)
+{
+    for (int i = 0; i < 40; ++i)
+        writeFile(sourceRoot / ("d" + std::to_string(i % 5)) / ("f" + std::to_string(i) + ".txt"),
+                  std::string(200 + i, static_cast<char>('a' + i % 26)));
+    writeFile(sourceRoot / "flip", "file for now");
+
+    BackupManager::BackupConfig config{};
+    config.sourceRoot = sourceRoot;
+    config.backupRoot = backupRoot;
+    config.enableCompression = true;
+    config.compressionType = BackupManager::CompressionType::Huffman;
+    config.executeThreads = 8;
+    BackupManager mgr(config);
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+
+    // 删除整个目录、同一路径由文件变为目录
+    fs::remove_all(sourceRoot / "d3");
+    fs::remove(sourceRoot / "flip");
+    writeFile(sourceRoot / "flip/inner.txt", "now a directory");
+    mgr.scan();
+    ASSERT_TRUE(mgr.executePlan(mgr.buildPlan()));
+    mgr.scan();
+    EXPECT_TRUE(mgr.buildPlan().empty());
+
+    BackupManager::BackupConfig restoreCfg{};
+    restoreCfg.backupRoot = backupRoot;
+    restoreCfg.executeThreads = 8;
+    BackupManager restoreMgr(restoreCfg);
+    restoreMgr.restore(restoreRoot);
+    for (int i = 0; i < 40; ++i)
+    {
+        const fs::path rel = fs::path("d" + std::to_string(i % 5)) / ("f" + std::to_string(i) + ".txt");
+        if (i % 5 == 3)
+            EXPECT_FALSE(fs::exists(restoreRoot / rel));
+        else
+            EXPECT_EQ(readFile(restoreRoot / rel), std::string(200 + i, static_cast<char>('a' + i % 26)));
+    }
+    EXPECT_EQ(readFile(restoreRoot / "flip/inner.txt"), "now a directory");
+}
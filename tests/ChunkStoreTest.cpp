@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include "backup/ChunkStore.h"
+#include "util/Chunker.h"
+
+using namespace backup::core;
+using backup::util::Chunker;
+namespace fs = std::filesystem;
+
+namespace
+{
+    std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> data(size);
+        for (auto &b : data)
+            b = static_cast<uint8_t>(rng());
+        return data;
+    }
+
+    std::vector<size_t> cutAll(const Chunker &chunker, const std::vector<uint8_t> &data)
+    {
+        std::vector<size_t> cuts;
+        size_t offset = 0;
+        while (offset < data.size())
+        {
+            offset += chunker.cut(data.data() + offset, data.size() - offset);
+            cuts.push_back(offset);
+        }
+        return cuts;
+    }
+
+    void writeFile(const fs::path &p, const std::vector<uint8_t> &data)
+    {
+        std::ofstream(p, std::ios::binary).write(reinterpret_cast<const char *>(data.data()),
+                                                 static_cast<std::streamsize>(data.size()));
+    }
+
+    std::vector<uint8_t> readFile(const fs::path &p)
+    {
+        std::ifstream in(p, std::ios::binary);
+        return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+}
+
+TEST(ChunkerTest, ChunkSizesStayWithinBounds)
+{
+    Chunker chunker;
+    const auto data = randomBytes(4 << 20, 1);
+    const auto cuts = cutAll(chunker, data);
+    size_t previous = 0;
+    for (size_t i = 0; i < cuts.size(); ++i)
+    {
+        const size_t length = cuts[i] - previous;
+        EXPECT_LE(length, chunker.options().maxSize);
+        if (i + 1 < cuts.size())
+        {
+            EXPECT_GE(length, chunker.options().minSize);
+        }
+        previous = cuts[i];
+    }
+    EXPECT_EQ(cuts.back(), data.size());
+    // 归一化分块使平均大小接近配置值
+    const size_t average = data.size() / cuts.size();
+    EXPECT_GT(average, chunker.options().averageSize / 2);
+    EXPECT_LT(average, chunker.options().averageSize * 2);
+}
+
+TEST(ChunkerTest, InsertionOnlyMovesNearbyBoundaries)
+{
+    Chunker chunker;
+    const auto original = randomBytes(4 << 20, 2);
+    auto edited = original;
+    const size_t at = 2 << 20;
+    edited.insert(edited.begin() + at, {'x', 'y', 'z'});
+
+    const auto before = cutAll(chunker, original);
+    std::unordered_set<size_t> shifted;
+    for (size_t cut : cutAll(chunker, edited))
+        shifted.insert(cut > at ? cut - 3 : cut);
+    size_t kept = 0;
+    for (size_t cut : before)
+        kept += shifted.count(cut);
+    EXPECT_GE(kept + 2, before.size());
+}
+
+class ChunkStoreTest : public ::testing::Test
+{
+protected:
+    fs::path root;
+
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / "chunk_store_test";
+        fs::create_directories(root / "backup");
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+};
+
+TEST_F(ChunkStoreTest, StoresUniqueChunksOnceAndRestores)
+{
+    ChunkStore::Options options;
+    options.compress = true;
+    options.compressionType = backup::core::compression::CompressionType::Huffman;
+    options.encrypt = true;
+    options.encryptionKey = "chunks";
+    options.threads = 3;
+    ChunkStore store(root / "backup", options);
+
+    auto data = randomBytes(200000, 3);
+    const std::vector<uint8_t> text(400000, 'a');
+    data.insert(data.end(), text.begin(), text.end());
+    writeFile(root / "a.bin", data);
+    store.storeFile(root / "a.bin", root / "backup" / "a.manifest");
+    const auto first = store.stats();
+    EXPECT_EQ(first.chunks, ChunkStore::readManifest(root / "backup" / "a.manifest").size());
+    EXPECT_LE(first.newChunks, first.chunks);
+    EXPECT_LT(first.storedBytes, data.size()); // 重复的 'a' 块只存一份且可压缩
+
+    store.resetStats();
+    writeFile(root / "b.bin", data);
+    store.storeFile(root / "b.bin", root / "backup" / "b.manifest");
+    EXPECT_EQ(store.stats().newChunks, 0u);
+
+    store.loadFile(root / "backup" / "b.manifest", root / "restored.bin");
+    EXPECT_EQ(readFile(root / "restored.bin"), data);
+
+    ChunkStore wrongKey(root / "backup", [&]
+                        { auto o = options; o.encryptionKey = "other"; return o; }());
+    EXPECT_ANY_THROW(wrongKey.loadFile(root / "backup" / "b.manifest", root / "bad.bin"));
+    EXPECT_FALSE(fs::exists(root / "bad.bin"));
+}
+
+TEST_F(ChunkStoreTest, EmptyFileAndCorruptManifest)
+{
+    ChunkStore store(root / "backup", {});
+    writeFile(root / "empty", {});
+    store.storeFile(root / "empty", root / "backup" / "empty.manifest");
+    EXPECT_TRUE(ChunkStore::readManifest(root / "backup" / "empty.manifest").empty());
+    store.loadFile(root / "backup" / "empty.manifest", root / "empty.out");
+    EXPECT_TRUE(fs::exists(root / "empty.out"));
+    EXPECT_EQ(fs::file_size(root / "empty.out"), 0u);
+
+    std::ofstream(root / "backup" / "truncated") << "SDCHUNKS1\n";
+    EXPECT_THROW(ChunkStore::readManifest(root / "backup" / "truncated"), std::runtime_error);
+    std::ofstream(root / "backup" / "plain") << "hello";
+    EXPECT_THROW(ChunkStore::readManifest(root / "backup" / "plain"), std::runtime_error);
+}
+
+TEST_F(ChunkStoreTest, SweepRemovesUnreferencedChunks)
+{
+    ChunkStore store(root / "backup", {});
+    writeFile(root / "a.bin", randomBytes(600000, 4));
+    writeFile(root / "b.bin", randomBytes(600000, 5));
+    store.storeFile(root / "a.bin", root / "backup" / "a.manifest");
+    store.storeFile(root / "b.bin", root / "backup" / "b.manifest");
+
+    std::unordered_set<std::string> live;
+    for (const auto &ref : ChunkStore::readManifest(root / "backup" / "a.manifest"))
+        live.insert(ref.id);
+    const auto bRefs = ChunkStore::readManifest(root / "backup" / "b.manifest");
+    EXPECT_EQ(store.sweep(live), bRefs.size());
+
+    store.loadFile(root / "backup" / "a.manifest", root / "a.out");
+    EXPECT_EQ(readFile(root / "a.out"), readFile(root / "a.bin"));
+    EXPECT_ANY_THROW(store.loadFile(root / "backup" / "b.manifest", root / "b.out"));
+}
+
+// 断电后留下的长度不对的块不会被沿用，再次写入同样的内容时重写
+TEST_F(ChunkStoreTest, TornChunkIsRewritten)
+{
+    ChunkStore::Options options;
+    options.compress = true;
+    options.compressionType = backup::core::compression::CompressionType::Lz77;
+    ChunkStore store(root / "backup", options);
+    const auto data = randomBytes(100000, 6);
+    writeFile(root / "a.bin", data);
+    store.storeFile(root / "a.bin", root / "backup" / "a.manifest");
+
+    const auto refs = ChunkStore::readManifest(root / "backup" / "a.manifest");
+    ASSERT_FALSE(refs.empty());
+    const fs::path torn = root / "backup" / ChunkStore::kDirectory / refs[0].id.substr(0, 2) / refs[0].id;
+    fs::resize_file(torn, 0);
+
+    store.resetStats();
+    store.storeFile(root / "a.bin", root / "backup" / "b.manifest");
+    EXPECT_EQ(store.stats().newChunks, 1u);
+    EXPECT_GT(fs::file_size(torn), 0u);
+    store.loadFile(root / "backup" / "b.manifest", root / "a.out");
+    EXPECT_EQ(readFile(root / "a.out"), data);
+}
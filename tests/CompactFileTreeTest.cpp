@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "filesystem/CompactFileTree.h"
+#include "filesystem/FileTreeDiff.h"
+#include "backup/BackupMetadata.h"
+using namespace backup::filesystem;
+using namespace std::filesystem;
+class CompactFileTreeTest : public ::testing::Test {
+protected:
+    path oldRoot;
+    path newRoot;
+    void SetUp() override {
+        oldRoot = temp_directory_path() / "compact_old";
+        newRoot = temp_directory_path() / "compact_new";
+        create_directories(oldRoot / "a" / "deep");
+        create_directories(oldRoot / "b");
+        std::ofstream(oldRoot / "top.txt") << "top";
+        std::ofstream(oldRoot / "a" / "x.txt") << "x";
+        std::ofstream(oldRoot / "a" / "deep" / "y.txt") << "y";
+        std::ofstream(oldRoot / "b" / "z.txt") << "z";
+        copy(oldRoot, newRoot, copy_options::recursive);
+        for (const auto& entry : recursive_directory_iterator(oldRoot)) {
+            if (entry.is_regular_file()) {
+                last_write_time(newRoot / relative(entry.path(), oldRoot),
+                                last_write_time(entry.path()));
+            }
+        }
+    }
+    void TearDown() override {
+        remove_all(oldRoot);
+        remove_all(newRoot);
+    }
+};
+TEST_F(CompactFileTreeTest, MatchesFileTreeTraversal) {
+    FileTree tree(oldRoot);
+    tree.build();
+    std::vector<std::string> expected;
+    tree.traverseDFS([&expected](const FileNode& node) {
+        expected.push_back(node.getRelativePath());
+    });
+
+    CompactFileTree compact(oldRoot);
+    compact.build();
+    std::vector<std::string> scanned;
+    compact.traverseDFS([&](CompactFileTree::Index i) {
+        scanned.push_back(compact.relativePath(i));
+    });
+    EXPECT_EQ(scanned, expected);
+
+    auto converted = CompactFileTree::fromFileTree(tree);
+    std::vector<std::string> flattened;
+    converted.traverseDFS([&](CompactFileTree::Index i) {
+        flattened.push_back(converted.relativePath(i));
+    });
+    EXPECT_EQ(flattened, expected);
+    EXPECT_EQ(converted.size(), compact.size());
+}
+TEST_F(CompactFileTreeTest, ChildrenAreContiguousRanges) {
+    CompactFileTree compact(oldRoot);
+    compact.build();
+    const auto& root = compact.node(compact.root());
+    ASSERT_EQ(root.childCount, 3u);
+    EXPECT_EQ(compact.name(root.firstChild), "a");
+    EXPECT_EQ(compact.name(root.firstChild + 1), "b");
+    EXPECT_EQ(compact.name(root.firstChild + 2), "top.txt");
+    EXPECT_EQ(compact.node(root.firstChild + 2).size, 3u);
+    EXPECT_EQ(compact.node(root.firstChild).parent, compact.root());
+}
+TEST_F(CompactFileTreeTest, DiffMatchesFileTreeDiff) {
+    remove_all(newRoot / "b");
+    std::ofstream(newRoot / "a" / "x.txt") << "changed";
+    std::ofstream(newRoot / "new.txt") << "new";
+    create_directories(newRoot / "c");
+
+    FileTree oldTree(oldRoot), newTree(newRoot);
+    oldTree.build();
+    newTree.build();
+    auto expected = FileTreeDiff::diff(oldTree, newTree);
+
+    CompactFileTree oldCompact(oldRoot), newCompact(newRoot);
+    oldCompact.build();
+    newCompact.build();
+    auto changes = FileTreeDiff::diff(oldCompact, newCompact);
+
+    ASSERT_EQ(changes.size(), expected.size());
+    EXPECT_EQ(changes.size(), 5u);
+    for (size_t i = 0; i < changes.size(); ++i) {
+        EXPECT_EQ(changes[i].type, expected[i].type);
+        EXPECT_EQ(changes[i].relativePath, expected[i].relativePath);
+    }
+}
+TEST_F(CompactFileTreeTest, MetadataIsIdentical) {
+    auto readList = [](const path& meta) {
+        std::ifstream in(meta);
+        std::string line, list;
+        bool inList = false;
+        while (std::getline(in, line)) {
+            if (inList) list += line + "\n";
+            if (line == "[filelist]") inList = true;
+        }
+        return list;
+    };
+
+    FileTree tree(oldRoot);
+    tree.build();
+    backup::core::BackupMetadata::writeMetadata(tree, newRoot);
+    auto expected = readList(newRoot / ".backupmeta");
+
+    CompactFileTree compact(oldRoot);
+    compact.build();
+    backup::core::BackupMetadata::writeMetadata(compact, newRoot);
+    EXPECT_EQ(readList(newRoot / ".backupmeta"), expected);
+    EXPECT_FALSE(expected.empty());
+}
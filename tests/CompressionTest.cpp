@@ -1,13 +1,81 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <map>
 #include <random>
 #include <sstream>
+#include "compression/BlockFormat.h"
 #include "compression/Compression.h"
+#include "compression/Huffman.h"
+#include "compression/LZ77.h"
 
 using namespace backup::core::compression;
 namespace fs = std::filesystem;
 
+namespace {
+
+// 逐个比较整个窗口的原始实现，用来核对匹配查找的输出
+std::vector<uint8_t> referenceLz77(const std::vector<uint8_t>& data) {
+    std::vector<uint8_t> out;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t bestOffset = 0, bestLength = 0;
+        uint8_t nextByte = data[pos];
+        const size_t windowStart = pos > 4095 ? pos - 4095 : 0;
+        const size_t lookaheadEnd = std::min(pos + 15, data.size());
+        for (size_t i = windowStart; i < pos; ++i) {
+            size_t length = 0;
+            while (pos + length < lookaheadEnd && data[i + length] == data[pos + length]) ++length;
+            if (length > bestLength) {
+                bestLength = length;
+                bestOffset = pos - i;
+                nextByte = pos + length < data.size() ? data[pos + length] : 0;
+                if (bestLength == 15) break;
+            }
+        }
+        const uint16_t code = static_cast<uint16_t>((bestOffset << 4) | (bestLength & 0x0F));
+        out.push_back(static_cast<uint8_t>(code >> 8));
+        out.push_back(static_cast<uint8_t>(code & 0xFF));
+        out.push_back(nextByte);
+        pos += bestLength + 1;
+    }
+    return out;
+}
+
+// 原来的字符串实现：按输出中保存的树（前序，0 为内部结点，1 + 字节为叶子）生成 "0"/"1" 编码，
+// 拼成一个位串后每 8 位一个字节，末尾补 0，最后一个字节为位数除以 8 的余数
+std::vector<uint8_t> referenceHuffmanBits(const std::vector<uint8_t>& data, const std::vector<uint8_t>& stored) {
+    uint32_t treeSize = 0;
+    std::memcpy(&treeSize, stored.data(), sizeof(treeSize));
+    std::map<uint8_t, std::string> codes;
+    size_t pos = sizeof(treeSize);
+    std::function<void(const std::string&)> walk = [&](const std::string& code) {
+        if (stored[pos++] == 1) {
+            codes[stored[pos++]] = code.empty() ? "0" : code;
+            return;
+        }
+        walk(code + "0");
+        if (pos < sizeof(treeSize) + treeSize) walk(code + "1");
+    };
+    walk("");
+
+    std::string bits;
+    for (uint8_t byte : data) bits += codes.at(byte);
+    std::vector<uint8_t> out(stored.begin(), stored.begin() + sizeof(treeSize) + treeSize);
+    for (size_t i = 0; i < bits.size(); i += 8) {
+        std::string byte = bits.substr(i, 8);
+        byte.resize(8, '0');
+        out.push_back(static_cast<uint8_t>(std::stoi(byte, nullptr, 2)));
+    }
+    out.push_back(static_cast<uint8_t>(bits.size() % 8));
+    return out;
+}
+
+} // namespace
+
 class CompressionTest : public ::testing::Test {
 protected:
     fs::path root;
@@ -89,4 +157,225 @@ TEST_F(CompressionTest, TypeAndNameExposeAlgorithm) {
     EXPECT_EQ(h->getName(), "Huffman");
     EXPECT_EQ(l->getType(), CompressionType::Lz77);
     EXPECT_EQ(l->getName(), "Lz77");
-}
\ No newline at end of file
+}
+TEST_F(CompressionTest, SinkOutputMatchesFileOutput) {
+    for (auto type : {CompressionType::Huffman, CompressionType::Lz77}) {
+        auto c = createCompressor(type);
+        c->compress(inputFile, compressedFile);
+        std::vector<uint8_t> stored;
+        backup::util::BufferSink sink(stored);
+        c->compress(inputFile, sink);
+        EXPECT_EQ(stored, backup::util::readWholeFile(compressedFile));
+
+        std::vector<uint8_t> restored;
+        backup::util::BufferSink out(restored);
+        c->decompress(stored, out);
+        EXPECT_EQ(std::string(restored.begin(), restored.end()), textPayload);
+    }
+}
+
+TEST_F(CompressionTest, BlockFormatRoundTripsAcrossThreads) {
+    std::string payload;
+    std::mt19937 rng(7);
+    for (int i = 0; i < 20000; ++i) payload += "line " + std::to_string(rng() % 50) + "\n";
+    // 一段随机数据：压缩后不会变小，按原样存储
+    for (int i = 0; i < 3000; ++i) payload += static_cast<char>(rng());
+    std::ofstream(inputFile, std::ios::binary) << payload;
+
+    for (auto type : {CompressionType::Huffman, CompressionType::Lz77}) {
+        for (unsigned threads : {1u, 4u}) {
+            BlockOptions options;
+            options.blockSize = 4096;
+            options.threads = threads;
+            std::vector<uint8_t> stored;
+            backup::util::BufferSink sink(stored);
+            compressBlocks(type, inputFile, sink, options);
+            ASSERT_GE(stored.size(), 8u);
+            EXPECT_EQ(std::string(stored.begin(), stored.begin() + 8), "SDBLOCK1");
+
+            std::vector<uint8_t> restored;
+            backup::util::BufferSink out(restored);
+            decompressBlocks(type, [&stored](backup::util::ByteSink& blocks) {
+                // 以不规则的块送入解析器
+                for (size_t pos = 0, step = 1; pos < stored.size(); pos += step, step = step * 7 % 3001 + 1)
+                    blocks.write(stored.data() + pos, std::min(step, stored.size() - pos));
+            }, out, options);
+            EXPECT_EQ(std::string(restored.begin(), restored.end()), payload);
+
+            stored.resize(stored.size() - 3);
+            restored.clear();
+            EXPECT_THROW(decompressBlocks(type, [&stored](backup::util::ByteSink& blocks) {
+                blocks.write(stored.data(), stored.size());
+            }, out, options), std::runtime_error);
+        }
+    }
+}
+
+// 旧版本的整文件格式：8 字节原始大小 + 算法输出
+TEST_F(CompressionTest, BlockReaderAcceptsWholeFileFormat) {
+    const std::vector<uint8_t> data(textPayload.begin(), textPayload.end());
+    const std::vector<uint8_t> encoded = Huffman().compress(data);
+    std::vector<uint8_t> legacy(sizeof(size_t));
+    const size_t size = data.size();
+    std::memcpy(legacy.data(), &size, sizeof(size));
+    legacy.insert(legacy.end(), encoded.begin(), encoded.end());
+
+    std::vector<uint8_t> restored;
+    backup::util::BufferSink out(restored);
+    decompressBlocks(CompressionType::Huffman, [&legacy](backup::util::ByteSink& blocks) {
+        blocks.write(legacy.data(), legacy.size());
+    }, out);
+    EXPECT_EQ(std::string(restored.begin(), restored.end()), textPayload);
+
+    std::ofstream(compressedFile, std::ios::binary).write(reinterpret_cast<const char*>(legacy.data()), legacy.size());
+    createCompressor(CompressionType::Huffman)->decompress(compressedFile, decompressedFile);
+    EXPECT_EQ(backup::util::readWholeFile(decompressedFile), data);
+}
+
+// 按路径压缩写出分块容器，大于一块的文件也能还原
+TEST_F(CompressionTest, PathApiWritesBlockContainer) {
+    std::string payload;
+    std::mt19937 rng(3);
+    while (payload.size() < 1200000) payload += "entry " + std::to_string(rng() % 5000) + " ok\n";
+    std::ofstream(inputFile, std::ios::binary) << payload;
+
+    for (auto type : {CompressionType::Huffman, CompressionType::Lz77}) {
+        auto c = createCompressor(type);
+        c->compress(inputFile, compressedFile);
+        const auto stored = backup::util::readWholeFile(compressedFile);
+        ASSERT_GE(stored.size(), 8u);
+        EXPECT_EQ(std::string(stored.begin(), stored.begin() + 8), "SDBLOCK1");
+        EXPECT_LT(stored.size(), payload.size());
+
+        c->decompress(compressedFile, decompressedFile);
+        const auto restored = backup::util::readWholeFile(decompressedFile);
+        EXPECT_EQ(std::string(restored.begin(), restored.end()), payload);
+    }
+}
+
+// 默认的哈希链查找与逐个比较整个窗口的输出逐字节相同，旧备份的格式不变
+TEST_F(CompressionTest, Lz77HashChainsMatchExhaustiveSearch) {
+    std::mt19937 rng(7);
+    std::vector<std::vector<uint8_t>> inputs = {{}, {1}, {1, 1}, {1, 2, 1}, std::vector<uint8_t>(20000, 'x')};
+    for (int alphabet : {2, 4, 26, 256}) {
+        std::vector<uint8_t> data(12000);
+        for (auto& b : data) b = static_cast<uint8_t>(rng() % alphabet);
+        inputs.push_back(data);
+    }
+    std::string text;
+    while (text.size() < 30000) text += "the quick brown fox " + std::to_string(rng() % 50) + " jumps over the lazy dog\n";
+    inputs.emplace_back(text.begin(), text.end());
+
+    for (const auto& data : inputs) {
+        const auto stored = LZ77().compress(data);
+        EXPECT_EQ(stored, referenceLz77(data)) << "size " << data.size();
+
+        // 限制链长时输出可能不同，但解压方式不变
+        const auto fast = LZ77(4).compress(data);
+        EXPECT_EQ(LZ77().decompress(fast, data.size()), data);
+    }
+}
+
+TEST_F(CompressionTest, Lz77V2RoundTripsAndStoresIncompressibleData) {
+    std::mt19937 rng(11);
+    std::vector<uint8_t> random(100000);
+    for (auto& b : random) b = static_cast<uint8_t>(rng());
+    std::string text;
+    while (text.size() < 200000) text += "{\"id\": " + std::to_string(rng() % 1000) + ", \"level\": \"info\"}\n";
+    // 相同内容相隔 600 KiB，超出旧格式的窗口
+    std::vector<uint8_t> far(random);
+    far.resize(700000, 'x');
+    far.insert(far.end(), random.begin(), random.end());
+
+    std::vector<std::vector<uint8_t>> inputs = {{}, {1}, {1, 2, 3}, {7, 7, 7, 7, 7}, std::vector<uint8_t>(300000, 'z'),
+                                                random, std::vector<uint8_t>(text.begin(), text.end()), far};
+    for (const auto& data : inputs) {
+        for (size_t chain : {LZ77::kExhaustive, size_t(1)}) {
+            const auto stored = LZ77(chain).compressV2(data);
+            EXPECT_LE(stored.size(), data.size() + 1);
+            EXPECT_EQ(LZ77::decompressV2(stored, data.size()), data) << "size " << data.size();
+        }
+    }
+    EXPECT_EQ(LZ77().compressV2(random).size(), random.size() + 1);
+    EXPECT_LT(LZ77().compressV2(inputs[4]).size(), 16u);
+    EXPECT_LT(LZ77().compressV2(inputs[6]).size(), text.size() / 5);
+    EXPECT_LT(LZ77().compressV2(far).size(), 200000u);
+
+    auto stored = LZ77().compressV2(inputs[6]);
+    EXPECT_THROW(LZ77::decompressV2(stored, text.size() + 1), std::runtime_error);
+    stored.pop_back();
+    EXPECT_THROW(LZ77::decompressV2(stored, text.size()), std::runtime_error);
+    EXPECT_THROW(LZ77::decompressV2({9, 1, 2}, 2), std::runtime_error);
+}
+
+// 旧版本写入的整文件格式与不带版本标志的块仍按三字节记号解压
+TEST_F(CompressionTest, Lz77ReadsVersion1Data) {
+    const std::vector<uint8_t> data(textPayload.begin(), textPayload.end());
+    const std::vector<uint8_t> tokens = LZ77().compress(data);
+
+    std::vector<uint8_t> legacy(sizeof(size_t));
+    const size_t size = data.size();
+    std::memcpy(legacy.data(), &size, sizeof(size));
+    legacy.insert(legacy.end(), tokens.begin(), tokens.end());
+    std::vector<uint8_t> restored;
+    backup::util::BufferSink out(restored);
+    createCompressor(CompressionType::Lz77)->decompress(legacy, out);
+    EXPECT_EQ(restored, data);
+
+    std::vector<uint8_t> block = {'S', 'D', 'B', 'L', 'O', 'C', 'K', '1'};
+    for (uint32_t value : {static_cast<uint32_t>(data.size()), static_cast<uint32_t>(tokens.size())})
+        for (int i = 0; i < 4; ++i) block.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    block.push_back(0);
+    block.insert(block.end(), tokens.begin(), tokens.end());
+    block.insert(block.end(), 9, 0);
+    EXPECT_EQ(decompressBuffer(CompressionType::Lz77, block), data);
+
+    // 新写入的块带版本标志
+    const auto current = compressBuffer(CompressionType::Lz77, data);
+    ASSERT_GT(current.size(), 17u);
+    EXPECT_EQ(current[16], 2);
+    EXPECT_EQ(decompressBuffer(CompressionType::Lz77, current), data);
+}
+
+// 多线程压缩的输出与单线程逐字节相同，解压线程数也不影响结果
+TEST_F(CompressionTest, ThreadedPathApiMatchesSingleThread) {
+    std::string payload;
+    std::mt19937 rng(5);
+    while (payload.size() < 2200000) payload += "k" + std::to_string(rng() % 100000) + ",";
+    std::ofstream(inputFile, std::ios::binary) << payload;
+
+    auto c = createCompressor(CompressionType::Lz77);
+    c->compress(inputFile, compressedFile);
+    const auto single = backup::util::readWholeFile(compressedFile);
+
+    c->setThreads(4);
+    c->compress(inputFile, compressedFile);
+    EXPECT_EQ(backup::util::readWholeFile(compressedFile), single);
+    c->decompress(compressedFile, decompressedFile);
+    const auto restored = backup::util::readWholeFile(decompressedFile);
+    EXPECT_EQ(std::string(restored.begin(), restored.end()), payload);
+}
+
+// 按码表与 64 位累加器写出的结果与原来的位串实现逐字节相同
+TEST_F(CompressionTest, HuffmanEncoderMatchesBitStringReference) {
+    std::mt19937 rng(13);
+    std::vector<std::vector<uint8_t>> inputs = {{}, {42}, std::vector<uint8_t>(1000, 'q'), {1, 2}};
+    for (int alphabet : {2, 3, 17, 256}) {
+        for (size_t size : {size_t(7), size_t(1001), size_t(60000)}) {
+            std::vector<uint8_t> data(size);
+            for (auto& b : data) b = static_cast<uint8_t>(rng() % alphabet);
+            inputs.push_back(data);
+        }
+    }
+    // 频率按指数分布，码长差别很大
+    std::vector<uint8_t> skewed;
+    for (uint8_t symbol = 0; symbol < 18; ++symbol) skewed.insert(skewed.end(), size_t(1) << symbol, symbol);
+    std::shuffle(skewed.begin(), skewed.end(), rng);
+    inputs.push_back(skewed);
+
+    for (const auto& data : inputs) {
+        const auto stored = Huffman().compress(data);
+        EXPECT_EQ(stored, referenceHuffmanBits(data, stored)) << "size " << data.size();
+        EXPECT_EQ(Huffman().decompress(stored, data.size()), data);
+    }
+}
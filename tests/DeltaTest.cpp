@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "util/Delta.h"
+
+using namespace backup::util;
+namespace fs = std::filesystem;
+
+class DeltaTest : public ::testing::Test
+{
+protected:
+    fs::path root;
+
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / "delta_test";
+        fs::create_directories(root);
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    static std::string pattern(size_t size)
+    {
+        std::string data(size, '\0');
+        for (size_t i = 0; i < size; ++i)
+            data[i] = static_cast<char>((i * 7919) ^ (i >> 11));
+        return data;
+    }
+
+    static void writeFile(const fs::path &p, const std::string &content)
+    {
+        std::ofstream(p, std::ios::binary) << content;
+    }
+
+    static std::string readFile(const fs::path &p)
+    {
+        std::ifstream in(p, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(DeltaTest, WeakChecksumMatchesDefinition)
+{
+    const uint8_t data[] = {1, 2, 3};
+    // a = 6, b = 3*1 + 2*2 + 1*3 = 10
+    EXPECT_EQ(weakChecksum(data, 3), 6u | (10u << 16));
+    EXPECT_EQ(weakChecksum(data, 0), 0u);
+}
+
+TEST_F(DeltaTest, SignatureRoundTrip)
+{
+    writeFile(root / "file", pattern(100000));
+    FileSignature signature = signFile(root / "file", 4096);
+    signature.mtimeNs = 42;
+    EXPECT_EQ(signature.fileSize, 100000u);
+    EXPECT_EQ(signature.blocks.size(), 25u);
+    signature.save(root / "file.sig");
+
+    FileSignature loaded;
+    ASSERT_TRUE(loaded.load(root / "file.sig"));
+    EXPECT_EQ(loaded.mtimeNs, 42);
+    EXPECT_EQ(loaded.blockSize, 4096u);
+    ASSERT_EQ(loaded.blocks.size(), signature.blocks.size());
+    EXPECT_EQ(loaded.blocks[7].strong, signature.blocks[7].strong);
+
+    writeFile(root / "garbage.sig", "not a signature");
+    EXPECT_FALSE(loaded.load(root / "garbage.sig"));
+    EXPECT_FALSE(loaded.load(root / "missing.sig"));
+}
+
+TEST_F(DeltaTest, PatchWritesOnlyChangedBlocks)
+{
+    std::string data = pattern(64 * 4096 + 100);
+    writeFile(root / "source", data);
+    writeFile(root / "target", data);
+    const FileSignature old = signFile(root / "target", 4096);
+
+    // 原地改一个字节并追加
+    data[10 * 4096 + 5] ^= 1;
+    data += std::string(5000, 'x');
+    writeFile(root / "source", data);
+    auto result = patchFile(root / "source", root / "target", old);
+    EXPECT_EQ(readFile(root / "target"), data);
+    // 改动的块、原来不满的最后一块，以及追加的部分
+    EXPECT_EQ(result.bytesWritten, 4096u + 4096u + 1004u);
+    EXPECT_EQ(result.signature.fileSize, data.size());
+
+    // 截断
+    const FileSignature current = result.signature;
+    data.resize(3 * 4096);
+    writeFile(root / "source", data);
+    result = patchFile(root / "source", root / "target", current);
+    EXPECT_EQ(readFile(root / "target"), data);
+    EXPECT_EQ(result.bytesWritten, 0u);
+}
@@ -130,4 +130,37 @@ TEST_F(EncryptionTest, AesEncryptorReuse)
     std::string decrypted2_content((std::istreambuf_iterator<char>(decrypted2_file)), std::istreambuf_iterator<char>());
 
     EXPECT_EQ(decrypted1_content, decrypted2_content);
-}
\ No newline at end of file
+}
+// 测试流式接口与文件接口输出一致
+TEST_F(EncryptionTest, AesStreamingMatchesFileApi)
+{
+    auto enc = createEncryptor(EncryptionType::AES);
+    enc->setKey(test_password);
+
+    std::string payload(10000, '\0');
+    for (size_t i = 0; i < payload.size(); ++i)
+        payload[i] = static_cast<char>(i * 31);
+    std::ofstream(test_input, std::ios::binary) << payload;
+
+    fs::path encrypted = tmp_dir / "encrypted.bin";
+    enc->encrypt(test_input, encrypted);
+    std::ifstream encryptedFile(encrypted, std::ios::binary);
+    std::vector<uint8_t> expected((std::istreambuf_iterator<char>(encryptedFile)), std::istreambuf_iterator<char>());
+
+    // 分成大小不齐的块写入
+    std::vector<uint8_t> streamed;
+    backup::util::BufferSink buffer(streamed);
+    auto cipher = enc->encryptTo(buffer);
+    const auto *bytes = reinterpret_cast<const uint8_t *>(payload.data());
+    for (size_t pos = 0, step = 1; pos < payload.size(); pos += step, step = step * 3 % 4999 + 1)
+        cipher->write(bytes + pos, std::min(step, payload.size() - pos));
+    cipher->finish();
+    EXPECT_EQ(streamed, expected);
+
+    std::vector<uint8_t> decrypted;
+    backup::util::BufferSink plain(decrypted);
+    auto decipher = enc->decryptTo(plain);
+    decipher->write(streamed.data(), streamed.size());
+    decipher->finish();
+    EXPECT_EQ(std::string(decrypted.begin(), decrypted.end()), payload);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include "util/FileCopy.h"
+
+using namespace backup::util;
+namespace fs = std::filesystem;
+
+class FileCopyTest : public ::testing::Test
+{
+protected:
+    fs::path root;
+
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / "file_copy_test";
+        fs::create_directories(root);
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    static void writeFile(const fs::path &p, const std::string &content)
+    {
+        std::ofstream(p, std::ios::binary) << content;
+    }
+
+    static std::string readFile(const fs::path &p)
+    {
+        std::ifstream in(p, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(FileCopyTest, CopiesEmptySmallAndLargeFiles)
+{
+    std::string large(3 * 1024 * 1024 + 17, '\0');
+    for (size_t i = 0; i < large.size(); ++i)
+        large[i] = static_cast<char>((i * 131) ^ (i >> 9));
+
+    for (const std::string &content : {std::string(), std::string("small file"), large})
+    {
+        writeFile(root / "src", content);
+        const CopyMethod method = copyFileFast(root / "src", root / "dst");
+        EXPECT_NE(method, CopyMethod::IoUring);
+        EXPECT_EQ(readFile(root / "dst"), content);
+    }
+}
+
+TEST_F(FileCopyTest, TruncatesLongerTarget)
+{
+    writeFile(root / "src", "short");
+    writeFile(root / "dst", std::string(100000, 'x'));
+    copyFileFast(root / "src", root / "dst");
+    EXPECT_EQ(readFile(root / "dst"), "short");
+}
+
+TEST_F(FileCopyTest, MissingSourceThrows)
+{
+    EXPECT_THROW(copyFileFast(root / "missing", root / "dst"), std::system_error);
+    EXPECT_FALSE(fs::exists(root / "dst"));
+}
@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <filesystem>
 #include <fstream>
+#include <tuple>
 #include "filesystem/FileTreeDiff.h"
 using namespace backup::filesystem;
 using namespace std::filesystem;
@@ -83,6 +84,8 @@ TEST_F(FileTreeDiffTest, RemovedFiles) {
 }
 TEST_F(FileTreeDiffTest, ModifiedFiles) {
     copy(oldRoot, newRoot, copy_options::recursive);
+    last_write_time(newRoot / "subdir" / "file2.txt",
+                    last_write_time(oldRoot / "subdir" / "file2.txt"));
     std::ofstream(newRoot / "file1.txt") << "modified content1";
     FileTree oldTree(oldRoot);
     buildTree(oldTree);
@@ -120,9 +123,125 @@ TEST_F(FileTreeDiffTest, MixedChanges) {
             case ChangeType::Modified:
                 modifiedCount++;
                 break;
+            case ChangeType::Renamed:
+            case ChangeType::Moved:
+                ADD_FAILURE() << "diff() does not detect renames: " << change.relativePath;
+                break;
         }
     }
     EXPECT_EQ(addedCount, 3);   
     EXPECT_EQ(removedCount, 1); 
     EXPECT_EQ(modifiedCount, 1); 
-}
\ No newline at end of file
+}TEST_F(FileTreeDiffTest, StreamingOrderAndTypeChange) {
+    copy(oldRoot, newRoot, copy_options::recursive);
+    last_write_time(newRoot / "file1.txt", last_write_time(oldRoot / "file1.txt"));
+    last_write_time(newRoot / "subdir" / "file2.txt",
+                    last_write_time(oldRoot / "subdir" / "file2.txt"));
+    // "subdir" turns into a file, "file1.txt" into a directory
+    remove_all(newRoot / "subdir");
+    std::ofstream(newRoot / "subdir") << "now a file";
+    remove(newRoot / "file1.txt");
+    create_directories(newRoot / "file1.txt" / "inner");
+    std::ofstream(newRoot / "file1.txt.bak") << "sibling";
+    FileTree oldTree(oldRoot);
+    buildTree(oldTree);
+    FileTree newTree(newRoot);
+    buildTree(newTree);
+
+    std::vector<std::pair<ChangeType, std::string>> seen;
+    FileTreeDiff::diff(oldTree, newTree, [&seen](const FileChange& change) {
+        seen.emplace_back(change.type, change.relativePath);
+    });
+    std::vector<std::pair<ChangeType, std::string>> expected = {
+        {ChangeType::Removed, "file1.txt"},
+        {ChangeType::Added, "file1.txt"},
+        {ChangeType::Added, "file1.txt/inner"},
+        {ChangeType::Added, "file1.txt.bak"},
+        {ChangeType::Removed, "subdir"},
+        {ChangeType::Removed, "subdir/file2.txt"},
+        {ChangeType::Added, "subdir"},
+    };
+    EXPECT_EQ(seen, expected);
+}
+TEST(FileTreeDiffPathOrder, ParentBeforeChildrenBeforeSiblings) {
+    EXPECT_TRUE(FileTreeDiff::pathLess("a", "a/b"));
+    EXPECT_TRUE(FileTreeDiff::pathLess("a/b", "a.txt"));
+    EXPECT_TRUE(FileTreeDiff::pathLess("a/z", "b"));
+    EXPECT_FALSE(FileTreeDiff::pathLess("a", "a"));
+    EXPECT_FALSE(FileTreeDiff::pathLess("b", "a/z"));
+}
+TEST_F(FileTreeDiffTest, DetectsRenameAndMoveByInode) {
+    ScanOptions options;
+    options.identity = true;
+    FileTree before(oldRoot, options);
+    buildTree(before);
+    create_directories(oldRoot / "archive");
+    rename(oldRoot / "subdir", oldRoot / "archive" / "old");
+    std::ofstream(oldRoot / "archive" / "old" / "extra.txt") << "extra";
+    rename(oldRoot / "file1.txt", oldRoot / "file1.renamed");
+    FileTree after(oldRoot, options);
+    buildTree(after);
+
+    auto changes = FileTreeDiff::diff(before, after);
+    FileTreeDiff::detectRenames(changes);
+    std::vector<std::tuple<ChangeType, std::string, std::string>> seen;
+    for (const auto& change : changes) {
+        seen.emplace_back(change.type, change.relativePath, change.oldRelativePath);
+    }
+    std::vector<std::tuple<ChangeType, std::string, std::string>> expected = {
+        {ChangeType::Added, "archive", ""},
+        {ChangeType::Moved, "archive/old", "subdir"},
+        {ChangeType::Added, "archive/old/extra.txt", ""},
+        {ChangeType::Renamed, "file1.renamed", "file1.txt"},
+    };
+    EXPECT_EQ(seen, expected);
+}
+TEST_F(FileTreeDiffTest, DetectsCopiedFileByFingerprint) {
+    copy(oldRoot, newRoot, copy_options::recursive);
+    last_write_time(newRoot / "subdir" / "file2.txt",
+                    last_write_time(oldRoot / "subdir" / "file2.txt"));
+    // moved across "filesystems": new inode, same size, mtime and content
+    rename(newRoot / "file1.txt", newRoot / "subdir" / "file1.txt");
+    last_write_time(newRoot / "subdir" / "file1.txt", last_write_time(oldRoot / "file1.txt"));
+    // same size and mtime, different content: must stay Added
+    std::ofstream(newRoot / "lookalike.txt") << "content9";
+    last_write_time(newRoot / "lookalike.txt", last_write_time(oldRoot / "file1.txt"));
+    FileTree oldTree(oldRoot);
+    buildTree(oldTree);
+    FileTree newTree(newRoot);
+    buildTree(newTree);
+
+    auto changes = FileTreeDiff::diff(oldTree, newTree);
+    RenameOptions options;
+    options.oldContentRoot = oldRoot;
+    options.newContentRoot = newRoot;
+    FileTreeDiff::detectRenames(changes, options);
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0].type, ChangeType::Added);
+    EXPECT_EQ(changes[0].relativePath, "lookalike.txt");
+    EXPECT_EQ(changes[1].type, ChangeType::Moved);
+    EXPECT_EQ(changes[1].relativePath, "subdir/file1.txt");
+    EXPECT_EQ(changes[1].oldRelativePath, "file1.txt");
+    EXPECT_NE(changes[1].newNode->getHash(), 0u);
+}
+TEST_F(FileTreeDiffTest, SkipsSubtreesWithEqualHashes) {
+    copy(oldRoot, newRoot, copy_options::recursive);
+    last_write_time(newRoot / "file1.txt", last_write_time(oldRoot / "file1.txt"));
+    std::ofstream(newRoot / "subdir" / "file2.txt") << "changed";
+    FileTree oldTree(oldRoot);
+    buildTree(oldTree);
+    FileTree newTree(newRoot);
+    buildTree(newTree);
+    ASSERT_EQ(FileTreeDiff::diff(oldTree, newTree).size(), 1u);
+
+    // a matching hash is trusted without looking inside
+    for (const auto& child : newTree.getRoot()->getChildren()) {
+        if (child->getName() == "subdir") {
+            child->setHash(oldTree.getRoot()->getChildren()[1]->getHash());
+        }
+    }
+    newTree.getRoot()->setHash(0);
+    EXPECT_TRUE(FileTreeDiff::diff(oldTree, newTree).empty());
+    newTree.getRoot()->setHash(oldTree.getRoot()->getHash());
+    EXPECT_TRUE(FileTreeDiff::diff(oldTree, newTree).empty());
+}
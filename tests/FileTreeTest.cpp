@@ -3,6 +3,8 @@
 #include <fstream>
 #include <algorithm>
 #include "filesystem/FileTree.h"
+#include "filesystem/PathFilter.h"
+#include "filesystem/TreeWalker.h"
 using namespace backup::filesystem;
 using namespace std::filesystem;
 class FileTreeTest : public ::testing::Test {
@@ -60,4 +62,143 @@ TEST(FileTreeEmptyDirTest, EmptyDirectory) {
     EXPECT_TRUE(root->isDirectory());
     EXPECT_EQ(root->getChildren().size(), 0);
     remove_all(emptyDir);
-}
\ No newline at end of file
+}
+TEST_F(FileTreeTest, ParallelBuildMatchesSerial) {
+    for (int d = 0; d < 8; ++d) {
+        auto dir = testRoot / ("dir" + std::to_string(d));
+        create_directories(dir / "nested");
+        for (int f = 0; f < 10; ++f) {
+            std::ofstream(dir / ("f" + std::to_string(f) + ".txt")) << f;
+            std::ofstream(dir / "nested" / ("g" + std::to_string(f))) << d;
+        }
+    }
+    auto collect = [](const FileTree& tree) {
+        std::vector<std::string> paths;
+        tree.traverseDFS([&paths](const FileNode& node) {
+            paths.push_back(node.getRelativePath());
+        });
+        return paths;
+    };
+
+    FileTree serial(testRoot);
+    serial.build();
+    ScanOptions options;
+    options.threads = 4;
+    FileTree parallel(testRoot, options);
+    parallel.build();
+
+    auto expected = collect(serial);
+    EXPECT_EQ(expected.size(), 5u + 8u * 22u);
+    EXPECT_EQ(collect(parallel), expected);
+}
+
+TEST_F(FileTreeTest, ChildrenSortedByName) {
+    FileTree fileTree(testRoot);
+    fileTree.build();
+    const auto& children = fileTree.getRoot()->getChildren();
+    ASSERT_EQ(children.size(), 3);
+    EXPECT_EQ(children[0]->getName(), "file1.txt");
+    EXPECT_EQ(children[1]->getName(), "file2.txt");
+    EXPECT_EQ(children[2]->getName(), "subdir");
+}
+
+TEST_F(FileTreeTest, RawBackendMatchesPortable) {
+    create_directories(testRoot / "subdir" / "deeper");
+    std::ofstream(testRoot / "subdir" / "deeper" / "big.bin") << std::string(5000, 'b');
+    create_directory_symlink(testRoot / "subdir", testRoot / "link_to_subdir");
+
+    struct Seen {
+        std::string path;
+        bool isDir;
+        uintmax_t size;
+        FileNode::FileTime mtime;
+        bool operator==(const Seen& o) const {
+            return path == o.path && isDir == o.isDir && size == o.size && mtime == o.mtime;
+        }
+    };
+    auto collect = [](const FileTree& tree) {
+        std::vector<Seen> seen;
+        tree.traverseDFS([&seen](const FileNode& node) {
+            seen.push_back({node.getRelativePath(), node.isDirectory(),
+                            node.isFile() ? node.getSize() : 0, node.getMTime()});
+        });
+        return seen;
+    };
+
+    FileTree portable(testRoot);
+    portable.build();
+    ScanOptions options;
+    options.backend = ScanBackend::LinuxRaw;
+    FileTree raw(testRoot, options);
+    raw.build();
+
+    auto expected = collect(portable);
+    EXPECT_EQ(expected.size(), 11u);
+    EXPECT_TRUE(collect(raw) == expected);
+}
+TEST_F(FileTreeTest, SubtreeHashesTrackChanges) {
+    create_directories(testRoot / "other");
+    std::ofstream(testRoot / "other" / "file4.txt") << "content4";
+    FileTree before(testRoot);
+    before.build();
+    auto hashOf = [](const FileTree& tree, const std::string& name) {
+        for (const auto& child : tree.getRoot()->getChildren()) {
+            if (child->getName() == name) return child->getHash();
+        }
+        return uint64_t{0};
+    };
+    EXPECT_NE(before.getRoot()->getHash(), 0u);
+
+    FileTree same(testRoot);
+    same.build();
+    EXPECT_EQ(same.getRoot()->getHash(), before.getRoot()->getHash());
+
+    std::ofstream(testRoot / "subdir" / "file3.txt") << "content3, edited";
+    FileTree after(testRoot);
+    after.build();
+    EXPECT_NE(after.getRoot()->getHash(), before.getRoot()->getHash());
+    EXPECT_NE(hashOf(after, "subdir"), hashOf(before, "subdir"));
+    EXPECT_EQ(hashOf(after, "other"), hashOf(before, "other"));
+}
+TEST_F(FileTreeTest, FilterPrunesExcludedDirectories) {
+    create_directories(testRoot / "node_modules" / "pkg");
+    std::ofstream(testRoot / "node_modules" / "pkg" / "index.js") << "js";
+    std::ofstream(testRoot / "subdir" / "scratch.tmp") << "tmp";
+    PathFilter filter({}, {"node_modules/", "*.tmp"});
+    ScanOptions options;
+    options.filter = &filter;
+    for (unsigned threads : {1u, 4u}) {
+        options.threads = threads;
+        FileTree tree(testRoot, options);
+        tree.build();
+        std::vector<std::string> paths;
+        tree.traverseDFS([&paths](const FileNode& node) {
+            paths.push_back(node.getRelativePath());
+        });
+        std::vector<std::string> expected = {
+            ".", "file1.txt", "file2.txt", "subdir", "subdir/file3.txt"};
+        EXPECT_EQ(paths, expected);
+    }
+}
+TEST_F(FileTreeTest, TreeWalkerMatchesTraverseDFS) {
+    create_directories(testRoot / "subdir" / "deeper");
+    std::ofstream(testRoot / "subdir" / "deeper" / "file4.txt") << "content4";
+    std::ofstream(testRoot / "subdir.txt") << "sibling";
+    FileTree tree(testRoot);
+    tree.build();
+    std::vector<std::string> expected;
+    tree.traverseDFS([&expected](const FileNode& node) {
+        if (node.getRelativePath() != ".") {
+            expected.push_back(node.getRelativePath());
+        }
+    });
+    std::vector<std::string> walked;
+    TreeWalker walker(testRoot);
+    for (const auto& entry : walker) {
+        walked.push_back(entry.relativePath);
+    }
+    EXPECT_EQ(walked, expected);
+    TreeWalker notADirectory(testRoot / "file1.txt");
+    WalkEntry entry;
+    EXPECT_THROW(notADirectory.next(entry), std::runtime_error);
+}
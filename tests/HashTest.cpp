@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "util/Hash.h"
+
+using namespace backup::util;
+namespace fs = std::filesystem;
+
+TEST(HashTest, MatchesReferenceVectors)
+{
+    EXPECT_EQ(xxhash64("", 0), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(xxhash64("abc", 3), 0x44BC2CF5AD770999ULL);
+}
+
+TEST(HashTest, StreamingMatchesOneShot)
+{
+    std::string data(1000, '\0');
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>(i * 7);
+
+    XxHash64 hasher;
+    for (size_t i = 0; i < data.size(); i += 13)
+        hasher.update(data.data() + i, std::min<size_t>(13, data.size() - i));
+    EXPECT_EQ(hasher.digest(), xxhash64(data.data(), data.size()));
+}
+
+TEST(HashTest, FingerprintFile)
+{
+    const fs::path file = fs::temp_directory_path() / "hash_test.bin";
+    std::ofstream(file, std::ios::binary) << "abc";
+    EXPECT_EQ(fingerprintFile(file), 0x44BC2CF5AD770999ULL);
+    XxHash64 hasher;
+    hasher.update("abc", 3);
+    EXPECT_EQ(fingerprintOf(hasher), fingerprintFile(file));
+    fs::remove(file);
+    EXPECT_THROW(fingerprintFile(file), std::runtime_error);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "util/IoUring.h"
+
+using namespace backup::util;
+namespace fs = std::filesystem;
+
+class IoUringTest : public ::testing::Test
+{
+protected:
+    fs::path root;
+
+    void SetUp() override
+    {
+        if (!ioUringAvailable())
+            GTEST_SKIP() << "io_uring is not available";
+        root = fs::temp_directory_path() / "io_uring_test";
+        fs::create_directories(root / "src");
+        fs::create_directories(root / "dst");
+    }
+
+    void TearDown() override
+    {
+        if (!root.empty())
+            fs::remove_all(root);
+    }
+
+    static std::string readFile(const fs::path &p)
+    {
+        std::ifstream in(p, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(IoUringTest, CopiesManyFilesWithModeAndMtime)
+{
+    std::vector<CopyJob> jobs;
+    for (int i = 0; i < 100; ++i)
+    {
+        // 最后一个文件跨越多个缓冲区
+        const std::string content = i == 99 ? std::string(700000, 'z') : std::string(i, static_cast<char>('a' + i % 26));
+        const fs::path source = root / "src" / ("f" + std::to_string(i));
+        std::ofstream(source, std::ios::binary) << content;
+        jobs.push_back({source, root / "dst" / ("f" + std::to_string(i))});
+    }
+    fs::permissions(jobs[3].source, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+    const auto mtime = fs::last_write_time(jobs[3].source) - std::chrono::hours(5);
+    fs::last_write_time(jobs[3].source, mtime);
+    std::ofstream(jobs[7].target) << "stale content that is longer than the new one";
+
+    ASSERT_TRUE(copyFilesWithIoUring(jobs, 8));
+    for (const auto &job : jobs)
+    {
+        EXPECT_EQ(job.error, 0) << job.source;
+        EXPECT_EQ(readFile(job.target), readFile(job.source)) << job.source;
+    }
+    EXPECT_EQ(fs::status(jobs[3].target).permissions(), fs::status(jobs[3].source).permissions());
+    EXPECT_EQ(fs::last_write_time(jobs[3].target), mtime);
+}
+
+TEST_F(IoUringTest, ReportsPerFileErrors)
+{
+    std::ofstream(root / "src" / "ok") << "ok";
+    std::vector<CopyJob> jobs = {
+        {root / "src" / "missing", root / "dst" / "missing"},
+        {root / "src" / "ok", root / "dst" / "no-such-dir" / "ok"},
+        {root / "src" / "ok", root / "dst" / "ok"},
+    };
+    ASSERT_TRUE(copyFilesWithIoUring(jobs));
+    EXPECT_EQ(jobs[0].error, ENOENT);
+    EXPECT_EQ(jobs[1].error, ENOENT);
+    EXPECT_EQ(jobs[2].error, 0);
+    EXPECT_EQ(readFile(root / "dst" / "ok"), "ok");
+}
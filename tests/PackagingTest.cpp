@@ -0,0 +1,136 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "packaging/Packaging.h"
+
+using namespace backup::core;
+using packaging::PackStore;
+namespace fs = std::filesystem;
+
+class PackagingTest : public ::testing::Test
+{
+protected:
+    fs::path root;
+    fs::path packs;
+    fs::path index;
+
+    void SetUp() override
+    {
+        root = fs::temp_directory_path() / "packaging_test";
+        packs = root / PackStore::kDirectory;
+        index = root / PackStore::kIndexFile;
+        fs::create_directories(root / "src");
+    }
+
+    void TearDown() override
+    {
+        fs::remove_all(root);
+    }
+
+    fs::path writeSource(const std::string &name, const std::string &content)
+    {
+        const fs::path path = root / "src" / name;
+        std::ofstream(path, std::ios::binary) << content;
+        return path;
+    }
+
+    static std::string readFile(const fs::path &p)
+    {
+        std::ifstream in(p, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+};
+
+TEST_F(PackagingTest, StoredFilesRoundTripThroughIndex)
+{
+    PackStore::Options options;
+    options.compress = true;
+    options.compressionType = compression::CompressionType::Huffman;
+    options.encrypt = true;
+    options.encryptionKey = "pack-key";
+
+    const fs::path a = writeSource("a.txt", "hello packs");
+    fs::permissions(a, fs::perms::owner_read | fs::perms::owner_write);
+    const auto mtime = fs::last_write_time(a) - std::chrono::hours(1);
+    fs::last_write_time(a, mtime);
+    writeSource("b.txt", std::string(3000, 'b'));
+    {
+        PackStore store(packs, index, options);
+        store.storeFile(root / "src/a.txt", "dir/a.txt");
+        store.storeFile(root / "src/b.txt", "b.txt");
+        store.commit(index);
+        EXPECT_EQ(store.stats().files, 2u);
+    }
+
+    PackStore store(packs, index, options);
+    EXPECT_TRUE(store.contains("dir/a.txt"));
+    EXPECT_FALSE(store.loadFile("missing.txt", root / "out/missing.txt"));
+    fs::create_directories(root / "out");
+    ASSERT_TRUE(store.loadFile("dir/a.txt", root / "out/a.txt"));
+    ASSERT_TRUE(store.loadFile("b.txt", root / "out/b.txt"));
+    EXPECT_EQ(readFile(root / "out/a.txt"), "hello packs");
+    EXPECT_EQ(readFile(root / "out/b.txt"), std::string(3000, 'b'));
+    EXPECT_EQ(fs::last_write_time(root / "out/a.txt"), mtime);
+    EXPECT_EQ(fs::status(root / "out/a.txt").permissions(), fs::perms::owner_read | fs::perms::owner_write);
+    EXPECT_EQ(std::distance(fs::directory_iterator(packs), fs::directory_iterator()), 1);
+}
+
+TEST_F(PackagingTest, EraseAndRenameApplyToWholeDirectories)
+{
+    writeSource("x", "x");
+    PackStore store(packs, index, {});
+    for (const char *path : {"d/one", "d/sub/two", "d2/three", "e"})
+    {
+        store.storeFile(root / "src/x", path);
+    }
+
+    store.rename("d", "moved", false);
+    EXPECT_FALSE(store.contains("d/one"));
+    EXPECT_TRUE(store.contains("moved/one"));
+    EXPECT_TRUE(store.contains("moved/sub/two"));
+    EXPECT_TRUE(store.contains("d2/three"));
+
+    store.rename("e", "copy", true);
+    EXPECT_TRUE(store.contains("e"));
+    EXPECT_TRUE(store.contains("copy"));
+
+    store.erase("moved");
+    EXPECT_FALSE(store.contains("moved/one"));
+    EXPECT_FALSE(store.contains("moved/sub/two"));
+    EXPECT_TRUE(store.contains("d2/three"));
+}
+
+// 有效内容不足一半的包被搬空删除，记录仍可读取
+TEST_F(PackagingTest, CompactRewritesSparsePacks)
+{
+    PackStore::Options options;
+    options.maxPackSize = 4096;
+    writeSource("big", std::string(1500, 'z'));
+    writeSource("keep", "keep me");
+    {
+        PackStore store(packs, index, options);
+        store.storeFile(root / "src/keep", "keep");
+        store.storeFile(root / "src/big", "big1");
+        store.storeFile(root / "src/big", "big2");
+        store.storeFile(root / "src/big", "big3"); // 超过 4096，之后写入新的包
+        store.commit(index);
+    }
+    ASSERT_TRUE(fs::exists(packs / "pack-1"));
+
+    PackStore store(packs, index, options);
+    store.erase("big1");
+    store.erase("big2");
+    store.erase("big3");
+    store.storeFile(root / "src/big", "fresh");
+    store.compact();
+    store.commit(index);
+    EXPECT_FALSE(fs::exists(packs / "pack-1"));
+    EXPECT_EQ(store.stats().removedPacks, 1u);
+
+    PackStore reopened(packs, index, options);
+    ASSERT_TRUE(reopened.loadFile("keep", root / "keep.out"));
+    EXPECT_EQ(readFile(root / "keep.out"), "keep me");
+    ASSERT_TRUE(reopened.loadFile("fresh", root / "fresh.out"));
+    EXPECT_EQ(readFile(root / "fresh.out"), std::string(1500, 'z'));
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include "util/Parallel.h"
+#include "util/Pipeline.h"
+
+using namespace backup::util;
+
+TEST(ParallelTest, VisitsEveryIndexOnce)
+{
+    for (unsigned threads : {1u, 3u, 16u})
+    {
+        std::vector<std::atomic<int>> hits(1000);
+        parallelFor(hits.size(), threads, [&hits](size_t i)
+                    { hits[i].fetch_add(1); });
+        for (const auto &hit : hits)
+            EXPECT_EQ(hit.load(), 1);
+    }
+    parallelFor(0, 4, [](size_t)
+                { FAIL(); });
+}
+
+TEST(ParallelTest, RethrowsFirstException)
+{
+    std::atomic<int> calls{0};
+    EXPECT_THROW(parallelFor(100, 4, [&calls](size_t i)
+                             {
+                                 ++calls;
+                                 if (i == 10)
+                                     throw std::runtime_error("boom"); }),
+                 std::runtime_error);
+    EXPECT_LE(calls.load(), 100);
+}
+
+TEST(ParallelTest, OrderedPipelineKeepsInputOrder)
+{
+    std::vector<int> seen;
+    std::atomic<int> inFlight{0};
+    std::atomic<int> maxInFlight{0};
+    runOrderedPipeline<int, int>(
+        4, 6,
+        [&](const std::function<void(int)> &emit)
+        {
+            for (int i = 0; i < 200; ++i)
+            {
+                int now = ++inFlight;
+                int seenMax = maxInFlight.load();
+                while (now > seenMax && !maxInFlight.compare_exchange_weak(seenMax, now))
+                {
+                }
+                emit(i);
+            }
+        },
+        [](int &value)
+        { return value * 2; },
+        [&](int &value)
+        {
+            --inFlight;
+            seen.push_back(value);
+        });
+    ASSERT_EQ(seen.size(), 200u);
+    for (int i = 0; i < 200; ++i)
+        EXPECT_EQ(seen[i], i * 2);
+    // 反压：已读取未消费的项不超过 window（再加上正在 emit 的一项）
+    EXPECT_LE(maxInFlight.load(), 7);
+}
+
+TEST(ParallelTest, OrderedPipelineStopsOnError)
+{
+    std::atomic<int> emitted{0};
+    EXPECT_THROW((runOrderedPipeline<int, int>(
+                     3, 4,
+                     [&](const std::function<void(int)> &emit)
+                     {
+                         for (int i = 0; i < 100000; ++i)
+                         {
+                             emit(i);
+                             ++emitted;
+                         }
+                     },
+                     [](int &value)
+                     {
+                         if (value == 5)
+                             throw std::runtime_error("bad block");
+                         return value;
+                     },
+                     [](int &) {})),
+                 std::runtime_error);
+    EXPECT_LT(emitted.load(), 100000);
+}
@@ -0,0 +1,78 @@
+#include <gtest/gtest.h>
+#include "filesystem/PathFilter.h"
+using namespace backup::filesystem;
+
+namespace {
+bool keeps(const PathFilter& filter, const std::string& relPath, bool isDirectory = false) {
+    auto slash = relPath.rfind('/');
+    return filter.accepts(relPath,
+                          slash == std::string::npos ? relPath : relPath.substr(slash + 1),
+                          isDirectory);
+}
+} // namespace
+
+TEST(PathFilterTest, EmptyFilterKeepsEverything) {
+    PathFilter filter;
+    EXPECT_TRUE(filter.empty());
+    EXPECT_TRUE(keeps(filter, "a/b.tmp"));
+}
+TEST(PathFilterTest, NamesAndSuffixesMatchAtAnyDepth) {
+    PathFilter filter({}, {"node_modules", "*.tmp", "*.o"});
+    EXPECT_FALSE(keeps(filter, "node_modules", true));
+    EXPECT_FALSE(keeps(filter, "web/app/node_modules", true));
+    EXPECT_FALSE(keeps(filter, "x.tmp"));
+    EXPECT_FALSE(keeps(filter, "deep/dir/y.o"));
+    EXPECT_TRUE(keeps(filter, "x.tmpl"));
+    EXPECT_FALSE(keeps(filter, ".o"));
+    EXPECT_TRUE(keeps(filter, "node_modules2", true));
+}
+TEST(PathFilterTest, GlobsAndClasses) {
+    PathFilter filter({}, {"cache-??", "log[0-9].txt", "[!a]*.bak", "*\\*"});
+    EXPECT_FALSE(keeps(filter, "cache-01", true));
+    EXPECT_TRUE(keeps(filter, "cache-001", true));
+    EXPECT_FALSE(keeps(filter, "var/log7.txt"));
+    EXPECT_TRUE(keeps(filter, "var/logx.txt"));
+    EXPECT_FALSE(keeps(filter, "b.bak"));
+    EXPECT_TRUE(keeps(filter, "a.bak"));
+    EXPECT_FALSE(keeps(filter, "star*"));
+    EXPECT_TRUE(keeps(filter, "star"));
+}
+TEST(PathFilterTest, AnchoredPathsAndDoubleStar) {
+    PathFilter filter({}, {"build/out", "/top", "docs/**", "src/**/gen"});
+    EXPECT_FALSE(keeps(filter, "build/out", true));
+    EXPECT_TRUE(keeps(filter, "x/build/out", true));
+    EXPECT_FALSE(keeps(filter, "top"));
+    EXPECT_TRUE(keeps(filter, "sub/top"));
+    EXPECT_TRUE(keeps(filter, "docs", true));
+    EXPECT_FALSE(keeps(filter, "docs/a/b.md"));
+    EXPECT_FALSE(keeps(filter, "src/gen", true));
+    EXPECT_FALSE(keeps(filter, "src/a/b/gen", true));
+    EXPECT_TRUE(keeps(filter, "src/a/b/gen2", true));
+}
+TEST(PathFilterTest, ManyDoubleStarsStayLinear) {
+    std::string pattern = "a";
+    for (int i = 0; i < 16; ++i) pattern += "/**/x";
+    pattern += "/**/z";
+    PathFilter filter({}, {pattern});
+    std::string deep = "a";
+    for (int i = 0; i < 64; ++i) deep += "/x";
+    EXPECT_TRUE(keeps(filter, deep + "/y"));
+    EXPECT_FALSE(keeps(filter, deep + "/z"));
+    EXPECT_TRUE(keeps(filter, "a/x/x/x/z"));
+}
+TEST(PathFilterTest, DirectoryOnlyRules) {
+    PathFilter filter({}, {"tmp/", "*.d/"});
+    EXPECT_FALSE(keeps(filter, "a/tmp", true));
+    EXPECT_TRUE(keeps(filter, "a/tmp", false));
+    EXPECT_FALSE(keeps(filter, "conf.d", true));
+    EXPECT_TRUE(keeps(filter, "conf.d", false));
+}
+TEST(PathFilterTest, IncludesApplyToFilesOnly) {
+    PathFilter filter({"*.cpp", "docs/*.md"}, {"third_party"});
+    EXPECT_TRUE(keeps(filter, "src", true));
+    EXPECT_TRUE(keeps(filter, "src/main.cpp"));
+    EXPECT_FALSE(keeps(filter, "src/main.h"));
+    EXPECT_TRUE(keeps(filter, "docs/readme.md"));
+    EXPECT_FALSE(keeps(filter, "readme.md"));
+    EXPECT_FALSE(keeps(filter, "third_party", true));
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "filesystem/FileTree.h"
+#include "filesystem/ScanCache.h"
+using namespace backup::filesystem;
+using namespace std::filesystem;
+class ScanCacheTest : public ::testing::Test {
+protected:
+    path root;
+    path cacheFile;
+    void SetUp() override {
+        root = temp_directory_path() / "scancache_src";
+        cacheFile = temp_directory_path() / "scancache_test.cache";
+        create_directories(root / "sub");
+        std::ofstream(root / "a.txt") << "a";
+        std::ofstream(root / "sub" / "b.txt") << "b";
+        ageDirectories();
+    }
+    void TearDown() override {
+        remove_all(root);
+        remove(cacheFile);
+    }
+    // push directory mtimes out of the racy window so they get cached
+    void ageDirectories() {
+        auto old = file_time_type::clock::now() - std::chrono::hours(1);
+        last_write_time(root / "sub", old);
+        last_write_time(root, old);
+    }
+    std::vector<std::string> scan(ScanCache& cache) {
+        ScanOptions options;
+        options.cache = &cache;
+        FileTree tree(root, options);
+        tree.build();
+        std::vector<std::string> paths;
+        tree.traverseDFS([&paths](const FileNode& node) {
+            paths.push_back(node.getRelativePath() + ":" +
+                            (node.isFile() ? std::to_string(node.getSize()) : "d"));
+        });
+        return paths;
+    }
+};
+TEST_F(ScanCacheTest, RoundTripAndHits) {
+    ScanCache first(root);
+    EXPECT_FALSE(first.load(cacheFile));
+    auto expected = scan(first);
+    EXPECT_EQ(first.hits(), 0u);
+    first.save(cacheFile);
+
+    ScanCache second(root);
+    ASSERT_TRUE(second.load(cacheFile));
+    EXPECT_EQ(scan(second), expected);
+    EXPECT_EQ(second.hits(), 2u);
+}
+TEST_F(ScanCacheTest, HitRestatsFiles) {
+    ScanCache first(root);
+    scan(first);
+    first.save(cacheFile);
+
+    // rewriting a file leaves its directory's identity alone, so the listing
+    // comes from the cache but the size is read again
+    std::ofstream(root / "sub" / "b.txt") << "bigger";
+
+    ScanCache second(root);
+    ASSERT_TRUE(second.load(cacheFile));
+    auto paths = scan(second);
+    EXPECT_EQ(second.hits(), 2u);
+    EXPECT_EQ(std::count(paths.begin(), paths.end(), "sub/b.txt:6"), 1);
+}
+TEST_F(ScanCacheTest, ForgedMtimeStillDetectedByCtime) {
+    ScanCache first(root);
+    scan(first);
+    first.save(cacheFile);
+
+    auto mtime = last_write_time(root / "sub");
+    std::ofstream(root / "sub" / "late.txt") << "l";
+    last_write_time(root / "sub", mtime);
+
+    ScanCache second(root);
+    ASSERT_TRUE(second.load(cacheFile));
+    auto paths = scan(second);
+    EXPECT_EQ(std::count(paths.begin(), paths.end(), "sub/late.txt:1"), 1);
+}
+TEST_F(ScanCacheTest, ChangedDirectoryIsReread) {
+    ScanCache first(root);
+    scan(first);
+    first.save(cacheFile);
+
+    std::ofstream(root / "sub" / "new.txt") << "n";
+
+    ScanCache second(root);
+    ASSERT_TRUE(second.load(cacheFile));
+    auto paths = scan(second);
+    EXPECT_EQ(std::count(paths.begin(), paths.end(), "sub/new.txt:1"), 1);
+    EXPECT_EQ(second.hits(), 1u);
+}
+TEST_F(ScanCacheTest, ForeignRootIsIgnored) {
+    ScanCache first(root);
+    scan(first);
+    first.save(cacheFile);
+
+    ScanCache other(temp_directory_path() / "somewhere_else");
+    EXPECT_FALSE(other.load(cacheFile));
+}